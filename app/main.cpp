@@ -137,11 +137,11 @@ void userInputHandler(Logger& logger) {
                 if (msg.first == "exit") isRunning = false;
                 else if (msg.first == "chlevel"){ 
                     logger.setLevel(msg.second);
-                    std::cout << "Minimum level changed to " + logger.levelToString(msg.second) << std::endl;
+                    std::cout << "Minimum level changed to " << logger.levelToString(msg.second) << std::endl;
                 }
                 else if (msg.first == "chdefault"){ 
                     logger.setDefaultLevel(msg.second);
-                    std::cout << "Default level changed to " + logger.levelToString(msg.second) << std::endl;
+                    std::cout << "Default level changed to " << logger.levelToString(msg.second) << std::endl;
                 }
                 else { logger.log(msg.first, msg.second);  }
                 
@@ -164,6 +164,7 @@ int main(int argc, char* argv[]) {
     std::string level = "info";
     std::string host = "127.0.0.1";
     int port = 9999;
+    LoggerOptions options;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -177,12 +178,57 @@ int main(int argc, char* argv[]) {
         else if (arg == "--level" && i + 1 < argc) {
             level = argv[++i];
         }
+        else if (arg == "--async") {
+            options.async.enabled = true;
+        }
+        else if (arg == "--per-thread") {
+            options.async.enabled = true;
+            options.async.perThread = true;
+        }
+        else if (arg == "--wire" && i + 1 < argc) {
+            std::string wire = trim(toLower(argv[++i]));
+            if (wire == "binary") options.socket.wire = WireFormat::Binary;
+            else if (wire != "text") throw std::invalid_argument("Only text or binary wire formats");
+        }
+        else if (arg == "--rotate-size" && i + 1 < argc) {
+            options.rotation.maxBytes = std::stoul(argv[++i]) * 1024 * 1024;
+        }
+        else if (arg == "--rotate" && i + 1 < argc) {
+            std::string every = trim(toLower(argv[++i]));
+            if (every == "hourly") options.rotation.every = RotateEvery::Hour;
+            else if (every == "daily") options.rotation.every = RotateEvery::Day;
+            else throw std::invalid_argument("Only hourly or daily rotation");
+        }
+        else if (arg == "--keep" && i + 1 < argc) {
+            options.rotation.keep = std::stoul(argv[++i]);
+        }
+        else if (arg == "--compress") {
+            options.rotation.compress = true;
+        }
+        else if (arg == "--json") {
+            options.fileFormat = FileFormat::JsonLines;
+        }
+        else if (arg == "--spool" && i + 1 < argc) {
+            options.socket.spoolPath = argv[++i];
+        }
+        else if (arg == "--queue-size" && i + 1 < argc) {
+            options.socket.queueBytes = std::stoul(argv[++i]) * 1024 * 1024;
+        }
+        else if (arg == "--nodelay") {
+            options.socket.noDelay = true;
+        }
+        else if (arg == "--ring" && i + 1 < argc) {
+            options.ring.path = argv[++i];
+        }
+        else if (arg == "--ring-size" && i + 1 < argc) {
+            options.ring.bytes = std::stoul(argv[++i]) * 1024;
+        }
         else {
             std::cerr << "Неизвестный параметр: " << arg << "\n";
         }
     }
     
-    Logger logger(filePath, StringToLevel(trim(toLower(level))), StringToOutput(trim(toLower(mode))), host, port);
+    Logger logger(filePath, StringToLevel(trim(toLower(level))), StringToOutput(trim(toLower(mode))), host, port, options);
 
     std::thread input(userInputHandler, std::ref(logger));
 
@@ -0,0 +1,236 @@
+// Logger library benchmarks with machine-readable output: Logger::log
+// throughput and latency per output mode and thread count, timestamp cost,
+// the log_stats ingest path, and app -> server -> stats over loopback.
+// Prints one JSON document to stdout (progress goes to stderr), so runs of
+// different releases can be diffed or compared by a script.
+
+#include "histogram.hpp"
+#include "log_bench.hpp"
+#include "log_server.hpp"
+#include "logger.hpp"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const char* kLogFile = "log_bench.txt";
+static const char* kMessage = "benchmark record with a payload of a typical size, id 1234567";
+
+static double seconds(Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+static int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct LoggerResult {
+    const char* mode;
+    bool async;
+    bool perThread;
+    int threads;
+    double recordsPerSecond;
+    uint64_t p50Ns;
+    uint64_t p99Ns;
+    uint64_t dropped;
+};
+
+// Every call is timed on its own; throughput includes the final flush, so
+// async modes are charged for the writes they deferred
+static LoggerResult runLogger(LogOutput output, const char* name, bool async, bool perThread, int threads, int records,
+                              int port) {
+    LoggerOptions options;
+    options.async.enabled = async;
+    options.async.perThread = perThread;
+    options.async.capacity = 65536;
+    std::vector<LogHistogram> latency(threads);
+    double elapsed;
+    uint64_t dropped;
+    {
+        Logger logger(kLogFile, LogLevel::Info, output, "127.0.0.1", port, options);
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t) {
+            producers.emplace_back([&, t]() {
+                ready.fetch_add(1);
+                while (!go.load()) std::this_thread::yield();
+                for (int i = 0; i < records; ++i) {
+                    auto before = Clock::now();
+                    logger.log(kMessage, LogLevel::Info);
+                    latency[t].record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - before).count()));
+                }
+            });
+        }
+        while (ready.load() < threads) std::this_thread::yield();
+        auto start = Clock::now();
+        go.store(true);
+        for (auto& producer : producers) producer.join();
+        logger.flush();
+        elapsed = seconds(Clock::now() - start);
+        dropped = logger.droppedCount() + logger.socketCounters().dropped;
+    }
+    std::remove(kLogFile);
+
+    LogHistogram merged;
+    for (const LogHistogram& h : latency) merged.merge(h);
+    return { name, async, perThread, threads, double(threads) * records / elapsed, merged.quantile(0.5),
+             merged.quantile(0.99), dropped };
+}
+
+// Nanoseconds per call
+template <typename F>
+static double costOf(F f, int iterations) {
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) f();
+    return seconds(Clock::now() - start) * 1e9 / iterations;
+}
+
+struct EndToEnd {
+    uint64_t sent;
+    uint64_t received;
+    double recordsPerSecond;
+};
+
+// A Logger in Socket mode, the relay and a subscriber that parses and
+// counts like log_stats
+static EndToEnd runEndToEnd(int port, int records) {
+    int subscriber = connectTo(port);
+    if (subscriber < 0) return { 0, 0, 0 };
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));  // let the relay register it
+
+    uint64_t received = 0;
+    auto start = Clock::now();
+    Clock::time_point finished;
+    std::thread consumer([&]() {
+        received = consumeStats(subscriber, uint64_t(records), std::chrono::milliseconds(2000));
+        finished = Clock::now();
+    });
+    {
+        Logger logger(kLogFile, LogLevel::Info, LogOutput::Socket, "127.0.0.1", port);
+        for (int i = 0; i < records; ++i) logger.log(kMessage, LogLevel::Info);
+    }
+    consumer.join();
+    close(subscriber);
+    std::remove(kLogFile);
+    return { uint64_t(records), received, received / seconds(finished - start) };
+}
+
+int main(int argc, char* argv[]) {
+    int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    int records = 20000;
+    int port = 19980;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) maxThreads = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--records" && i + 1 < argc) records = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--port" && i + 1 < argc) port = std::stoi(argv[++i]);
+        else {
+            std::cerr << "Unknown parameter: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    ServerOptions serverOptions;
+    serverOptions.port = port;
+    serverOptions.threads = 1;
+    serverOptions.quiet = true;
+    LogServer server(serverOptions);
+    if (!server.start()) return 1;
+
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    const std::pair<LogOutput, const char*> outputs[] = {
+        { LogOutput::File, "File" }, { LogOutput::Socket, "Socket" }, { LogOutput::Both, "Both" } };
+    std::vector<LoggerResult> results;
+    for (const auto& [output, name] : outputs) {
+        // sync, async through the shared queue, async through per-thread buffers
+        for (auto [async, perThread] : { std::pair(false, false), std::pair(true, false), std::pair(true, true) }) {
+            for (int threads : threadCounts) {
+                std::cerr << "log " << name << (async ? " async" : " sync") << (perThread ? " per-thread" : "")
+                          << ", " << threads << " thread(s)\n";
+                results.push_back(runLogger(output, name, async, perThread, threads, records, port));
+            }
+        }
+    }
+
+    std::cerr << "timestamps\n";
+    char stamp[kMaxTimestampLength];
+    volatile size_t sink = 0;
+    TimestampOptions secondsOnly, micro;
+    micro.precision = TimestampPrecision::Microseconds;
+    double clockNs = costOf([&]() { sink = sink + size_t(std::chrono::system_clock::now().time_since_epoch().count()); },
+                            1000000);
+    double secondsNs = costOf([&]() { sink = sink + formatTimestamp(std::chrono::system_clock::now(), secondsOnly, stamp); },
+                              1000000);
+    double microNs = costOf([&]() { sink = sink + formatTimestamp(std::chrono::system_clock::now(), micro, stamp); },
+                            1000000);
+
+    // A record dropped by the limits, before any formatting
+    std::cerr << "limits\n";
+    double sampledNs, rateLimitedNs;
+    {
+        LoggerOptions limited;
+        limited.limits.perSecond = 10;
+        limited.limits.sampleEvery = { 1000000, 1, 1, 1 };
+        Logger logger(kLogFile, LogLevel::Debug, LogOutput::File, "", 0, limited);
+        sampledNs = costOf([&]() { LOG_DEBUG(logger, "sampled {}", 1); }, 1000000);
+        rateLimitedNs = costOf([&]() { LOG_INFO(logger, "rate limited {}", 1); }, 1000000);
+    }
+    std::remove(kLogFile);
+
+    std::cerr << "stats ingest\n";
+    double statsRate = statsLinesPerSecond(records * 10);
+
+    std::cerr << "end to end\n";
+    EndToEnd endToEnd = runEndToEnd(port, records * 5);
+    server.stop();
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"benchmark\": \"log_bench\",\n"
+         << "  \"cpus\": " << std::thread::hardware_concurrency() << ",\n"
+         << "  \"records_per_thread\": " << records << ",\n"
+         << "  \"logger\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const LoggerResult& r = results[i];
+        json << "    {\"mode\": \"" << r.mode << "\", \"async\": " << (r.async ? "true" : "false")
+             << ", \"per_thread\": " << (r.perThread ? "true" : "false") << ", \"threads\": " << r.threads << ", \"records_per_sec\": " << uint64_t(r.recordsPerSecond)
+             << ", \"p50_ns\": " << r.p50Ns << ", \"p99_ns\": " << r.p99Ns << ", \"dropped\": " << r.dropped << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ],\n"
+         << "  \"timestamp_ns\": {\"clock_now\": " << clockNs << ", \"format_seconds\": " << secondsNs
+         << ", \"format_microseconds\": " << microNs << "},\n"
+         << "  \"suppressed_ns\": {\"sampled\": " << sampledNs << ", \"rate_limited\": " << rateLimitedNs << "},\n"
+         << "  \"stats_lines_per_sec\": " << uint64_t(statsRate) << ",\n"
+         << "  \"end_to_end\": {\"sent\": " << endToEnd.sent << ", \"received\": " << endToEnd.received
+         << ", \"records_per_sec\": " << uint64_t(endToEnd.recordsPerSecond) << "}\n"
+         << "}\n";
+    std::cout << json.str();
+    return endToEnd.received == endToEnd.sent ? 0 : 1;
+}
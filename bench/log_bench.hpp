@@ -0,0 +1,15 @@
+#pragma once
+
+// Stats-side pieces of log_bench, built in their own translation unit:
+// stats/ and logger/ each define their own LogLevel.
+
+#include <chrono>
+#include <cstdint>
+
+// What log_stats does per line (parse, counters, templates), lines/s
+double statsLinesPerSecond(int lines);
+
+// Reads records from a connected socket and feeds them through the same
+// path until expected lines were parsed or nothing arrived for idle;
+// returns the number parsed
+uint64_t consumeStats(int fd, uint64_t expected, std::chrono::milliseconds idle);
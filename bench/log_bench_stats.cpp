@@ -0,0 +1,67 @@
+#include "log_bench.hpp"
+
+#include "log_parser.hpp"
+#include "stats_core.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const char* const kLevels[] = {"Debug", "Info", "Warning", "Error"};
+
+static bool ingest(std::string_view line, StatsShard& shard) {
+    ParsedLine parsed;
+    if (!parseLogLine(line, parsed)) return false;
+    shard.record(parsed.level, parsed.message.size(), parsed.epochSeconds, 0);
+    shard.recordTemplate(parsed.level, parsed.message);
+    return true;
+}
+
+double statsLinesPerSecond(int count) {
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    char buffer[128];
+    for (int i = 0; i < count; ++i) {
+        int second = i / 50;
+        std::snprintf(buffer, sizeof(buffer), "2025-08-%02d %02d:%02d:%02d.%03d [%s] request %d handled in %d ms",
+                      1 + second / 86400 % 28, second / 3600 % 24, second / 60 % 60, second % 60, i % 1000,
+                      kLevels[i % 4], i, i % 97);
+        lines.emplace_back(buffer);
+    }
+
+    StatsAggregator stats;
+    auto start = Clock::now();
+    for (const std::string& line : lines) ingest(line, stats.shard(0));
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return stats.snapshot().total / seconds;
+}
+
+uint64_t consumeStats(int fd, uint64_t expected, std::chrono::milliseconds idle) {
+    StatsAggregator stats;
+    std::vector<char> buffer(64 * 1024);
+    size_t used = 0;
+    uint64_t parsed = 0;
+    while (parsed < expected) {
+        pollfd pfd{ fd, POLLIN, 0 };
+        if (poll(&pfd, 1, int(idle.count())) <= 0) break;
+        ssize_t n = recv(fd, buffer.data() + used, buffer.size() - used, 0);
+        if (n <= 0) break;
+        used += size_t(n);
+
+        size_t pos = 0;
+        while (const char* end = static_cast<const char*>(std::memchr(buffer.data() + pos, '\n', used - pos))) {
+            size_t lineEnd = end - buffer.data();
+            parsed += ingest(std::string_view(buffer.data() + pos, lineEnd - pos), stats.shard(0));
+            pos = lineEnd + 1;
+        }
+        std::memmove(buffer.data(), buffer.data() + pos, used - pos);
+        used -= pos;
+        if (used == buffer.size()) buffer.resize(buffer.size() * 2);
+    }
+    return parsed;
+}
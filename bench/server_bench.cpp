@@ -0,0 +1,243 @@
+// Compares the epoll relay (LogServer) with the previous thread-per-client
+// relay: connections/sec and relayed lines/sec over loopback.
+
+#include "log_server.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// The relay as it was before the event loop: a blocking thread per client
+// and one global client list (minus the stdout echo)
+class LegacyServer {
+public:
+    bool start(int port) {
+        m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int opt = 1;
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+        if (bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(m_listenFd, 10) < 0) {
+            perror("legacy bind/listen");
+            return false;
+        }
+        m_acceptThread = std::thread([this]() { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        shutdown(m_listenFd, SHUT_RDWR);
+        m_acceptThread.join();
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            for (int fd : m_clients) shutdown(fd, SHUT_RDWR);
+        }
+        while (m_active.load() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        close(m_listenFd);
+    }
+
+private:
+    void acceptLoop() {
+        for (;;) {
+            int fd = accept(m_listenFd, nullptr, nullptr);
+            if (fd < 0) return;
+            {
+                std::lock_guard<std::mutex> lock(m_clientsMutex);
+                m_clients.push_back(fd);
+            }
+            m_active.fetch_add(1);
+            std::thread([this, fd]() { handleClient(fd); }).detach();
+        }
+    }
+
+    void handleClient(int fd) {
+        char buffer[1024];
+        for (;;) {
+            ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+            if (n <= 0) break;
+            buffer[n] = '\0';
+            std::string message(buffer);
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            for (int other : m_clients) {
+                if (other != fd) send(other, message.c_str(), message.size(), MSG_NOSIGNAL);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMutex);
+            m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), fd), m_clients.end());
+        }
+        close(fd);
+        m_active.fetch_sub(1);
+    }
+
+    int m_listenFd = -1;
+    std::thread m_acceptThread;
+    std::mutex m_clientsMutex;
+    std::vector<int> m_clients;
+    std::atomic<int> m_active{0};
+};
+
+static int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static double seconds(Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+static double connectionsPerSecond(int port, int threads, int perThread) {
+    std::atomic<int> failed{0};
+    auto start = Clock::now();
+    std::vector<std::thread> clients;
+    for (int t = 0; t < threads; ++t) {
+        clients.emplace_back([&]() {
+            for (int i = 0; i < perThread; ++i) {
+                int fd = connectTo(port);
+                if (fd < 0) { failed.fetch_add(1); continue; }
+                close(fd);
+            }
+        });
+    }
+    for (auto& c : clients) c.join();
+    double elapsed = seconds(Clock::now() - start);
+    if (failed.load() > 0) std::cerr << "  " << failed.load() << " connects failed\n";
+    return (threads * perThread - failed.load()) / elapsed;
+}
+
+// One subscriber, several producers that also drain what is relayed to them
+static double linesPerSecond(int port, int producers, int lines) {
+    const std::string line = "2025-08-08 14:33:21 [Info] benchmark payload line of moderate size\n";
+
+    int subscriber = connectTo(port);
+    std::vector<int> producerFds;
+    for (int p = 0; p < producers; ++p) producerFds.push_back(connectTo(port));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> drains;
+    for (int fd : producerFds) {
+        drains.emplace_back([fd, &done]() {
+            char buffer[65536];
+            while (!done.load() && recv(fd, buffer, sizeof(buffer), 0) > 0) {}
+        });
+    }
+
+    const long long expected = (long long)producers * lines;
+    auto start = Clock::now();
+
+    std::vector<std::thread> senders;
+    for (int fd : producerFds) {
+        senders.emplace_back([fd, &line, lines]() {
+            std::string batch;
+            for (int i = 0; i < 32; ++i) batch += line;
+            for (int sent = 0; sent < lines; sent += 32) {
+                size_t count = std::min(32, lines - sent);
+                const char* p = batch.data();
+                size_t left = count * line.size();
+                while (left > 0) {
+                    ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+                    if (n <= 0) return;
+                    p += n;
+                    left -= n;
+                }
+            }
+        });
+    }
+
+    long long received = 0;
+    char buffer[65536];
+    auto deadline = start + std::chrono::seconds(60);
+    timeval timeout{1, 0};
+    setsockopt(subscriber, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while (received < expected && Clock::now() < deadline) {
+        ssize_t n = recv(subscriber, buffer, sizeof(buffer), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+        if (n <= 0) break;
+        received += std::count(buffer, buffer + n, '\n');
+    }
+    double elapsed = seconds(Clock::now() - start);
+
+    for (auto& s : senders) s.join();
+    done.store(true);
+    for (int fd : producerFds) shutdown(fd, SHUT_RDWR);
+    for (auto& d : drains) d.join();
+    for (int fd : producerFds) close(fd);
+    close(subscriber);
+
+    if (received < expected) {
+        std::cerr << "  subscriber got " << received << " of " << expected << " lines\n";
+    }
+    return received / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    int port = 19990;
+    int loops = 0;
+    int producers = 8;
+    int lines = 100000;
+    int connectThreads = 4;
+    int connectsPerThread = 2000;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) port = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) loops = std::stoi(argv[++i]);
+        else if (arg == "--producers" && i + 1 < argc) producers = std::stoi(argv[++i]);
+        else if (arg == "--lines" && i + 1 < argc) lines = std::stoi(argv[++i]);
+        else if (arg == "--connections" && i + 1 < argc) connectsPerThread = std::stoi(argv[++i]);
+        else {
+            std::cerr << "Unknown parameter: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "producers: " << producers << ", lines per producer: " << lines << "\n\n";
+
+    {
+        LegacyServer legacy;
+        if (!legacy.start(port)) return 1;
+        double cps = connectionsPerSecond(port, connectThreads, connectsPerThread);
+        double lps = linesPerSecond(port, producers, lines);
+        legacy.stop();
+        std::cout << "thread-per-client  connections/s: " << (long long)cps
+                  << "  lines/s: " << (long long)lps << "\n";
+    }
+
+    {
+        ServerOptions options;
+        options.port = port + 1;
+        options.threads = loops;
+        options.quiet = true;
+        LogServer server(options);
+        if (!server.start()) return 1;
+        double cps = connectionsPerSecond(options.port, connectThreads, connectsPerThread);
+        double lps = linesPerSecond(options.port, producers, lines);
+        server.stop();
+        std::cout << "epoll (" << server.options().threads << " loops)    connections/s: " << (long long)cps
+                  << "  lines/s: " << (long long)lps << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Compares the log_stats line parser (parseLogLine) with the previous
+// regex + std::get_time + mktime path: parsed lines/sec on synthetic lines.
+
+#include "log_parser.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const char* const kLevels[] = {"Debug", "Info", "Warning", "Error"};
+
+// The parser as it was before log_parser.hpp, except for tm_isdst: the old
+// code left it 0, which put summer timestamps an hour off under DST zones
+static bool legacyParse(const std::string& line, ParsedLine& out) {
+    std::regex pattern(R"((\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2})(?:\.\d+)? \[(Debug|Info|Warning|Error)\])");
+    std::smatch match;
+    size_t pos = line.find(']') + 2;
+
+    if (!std::regex_search(line, match, pattern)) return false;
+    std::string datetimeStr = match[1].str();
+    std::string level = match[2].str();
+
+    std::tm tm = {};
+    std::istringstream ss(datetimeStr);
+    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    tm.tm_isdst = -1;
+    out.epochSeconds = std::mktime(&tm);
+
+    if (level == "Debug") out.level = LogLevel::Debug;
+    else if (level == "Info") out.level = LogLevel::Info;
+    else if (level == "Warning") out.level = LogLevel::Warning;
+    else out.level = LogLevel::Error;
+    out.message = std::string_view(line).substr(pos);
+    return true;
+}
+
+static std::vector<std::string> makeLines(int count) {
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    char buffer[128];
+    for (int i = 0; i < count; ++i) {
+        int second = i / 50;  // ~50 records per second of log time
+        std::snprintf(buffer, sizeof(buffer), "2025-08-%02d %02d:%02d:%02d.%03d [%s] request %d handled in %d ms",
+                      1 + second / 86400 % 28, second / 3600 % 24, second / 60 % 60, second % 60, i % 1000,
+                      kLevels[i % 4], i, i % 97);
+        lines.emplace_back(buffer);
+    }
+    return lines;
+}
+
+template <typename Parse>
+static double linesPerSecond(const std::vector<std::string>& lines, Parse parse, int64_t& checksum) {
+    checksum = 0;
+    ParsedLine parsed;
+    auto start = Clock::now();
+    for (const std::string& line : lines) {
+        if (parse(line, parsed)) {
+            checksum += parsed.epochSeconds + int(parsed.level) + int64_t(parsed.message.size());
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return lines.size() / seconds;
+}
+
+int main(int argc, char* argv[]) {
+    int count = 20000;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--lines" && i + 1 < argc) count = std::stoi(argv[++i]);
+        else {
+            std::cerr << "Unknown parameter: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<std::string> lines = makeLines(count);
+
+    // Both parsers must agree before their speed means anything
+    int mismatches = 0;
+    for (const std::string& line : lines) {
+        ParsedLine expected, actual;
+        bool a = legacyParse(line, expected);
+        bool b = parseLogLine(line, actual);
+        if (a != b || expected.epochSeconds != actual.epochSeconds || expected.level != actual.level ||
+            expected.message != actual.message) {
+            if (mismatches++ == 0) std::cerr << "mismatch: " << line << "\n";
+        }
+    }
+
+    int64_t legacySum, fastSum;
+    double legacy = linesPerSecond(lines, legacyParse, legacySum);
+    double fast = linesPerSecond(lines, [](const std::string& line, ParsedLine& out) {
+        return parseLogLine(line, out);
+    }, fastSum);
+
+    std::cout << "lines: " << count << ", mismatches: " << mismatches << "\n\n";
+    std::cout << "regex + get_time + mktime  lines/s: " << (long long)legacy << "\n";
+    std::cout << "parseLogLine               lines/s: " << (long long)fast
+              << "  (x" << std::fixed << std::setprecision(1) << fast / legacy << ")\n";
+    return mismatches == 0 && legacySum == fastSum ? 0 : 1;
+}
@@ -0,0 +1,322 @@
+#include "file_sink.hpp"
+#include "logger.hpp"
+#include "log_fields.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef LOGGER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static int openLogFile(const std::string& path) {
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+// Start of the next local hour or day after now
+static std::chrono::system_clock::time_point nextBoundary(std::chrono::system_clock::time_point now,
+                                                          RotateEvery every) {
+    if (every == RotateEvery::Never) return std::chrono::system_clock::time_point::max();
+    std::time_t t = std::chrono::system_clock::to_time_t(now);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    tm.tm_sec = 0;
+    tm.tm_min = 0;
+    if (every == RotateEvery::Hour) {
+        tm.tm_hour += 1;
+    } else {
+        tm.tm_hour = 0;
+        tm.tm_mday += 1;
+    }
+    tm.tm_isdst = -1;
+    return std::chrono::system_clock::from_time_t(std::mktime(&tm));
+}
+
+static bool exists(const std::string& path) {
+    return ::access(path.c_str(), F_OK) == 0;
+}
+
+// "<path>.<YYYYmmdd-HHMMSS>", with "-N" appended for later segments of the
+// same second. N only grows: a number freed by retention is never reused,
+// or a newer segment would sort as older.
+std::string FileSink::segmentName() {
+    std::time_t t = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+    std::string base = m_path + "." + stamp;
+    int n = base == m_lastSegmentBase ? m_lastSegmentIndex + 1 : 0;
+    std::string name = n == 0 ? base : base + "-" + std::to_string(n);
+    while (exists(name) || exists(name + ".gz")) {
+        name = base + "-" + std::to_string(++n);
+    }
+    m_lastSegmentBase = base;
+    m_lastSegmentIndex = n;
+    return name;
+}
+
+#ifdef LOGGER_HAVE_ZLIB
+// segment -> segment.gz; the .gz appears only once complete
+static void compressSegment(const std::string& segment) {
+    std::string target = segment + ".gz";
+    std::string temporary = target + ".tmp";
+
+    int in = ::open(segment.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1) return;
+    gzFile out = gzopen(temporary.c_str(), "wb6");
+    if (out == nullptr) {
+        ::close(in);
+        return;
+    }
+
+    static constexpr size_t kChunk = 256 * 1024;
+    std::vector<char> buffer(kChunk);
+    bool ok = true;
+    for (;;) {
+        ssize_t n = ::read(in, buffer.data(), kChunk);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) ok = false;
+        if (n <= 0) break;
+        if (gzwrite(out, buffer.data(), unsigned(n)) != int(n)) {
+            ok = false;
+            break;
+        }
+    }
+    ::close(in);
+    ok = gzclose(out) == Z_OK && ok;
+
+    if (ok && ::rename(temporary.c_str(), target.c_str()) == 0) {
+        ::unlink(segment.c_str());
+    } else {
+        perror("log segment compression failed");
+        ::unlink(temporary.c_str());
+    }
+}
+#endif
+
+FileSink::FileSink(const std::string& filename, const FlushPolicy& policy, const RotationPolicy& rotation)
+    : m_path(filename), m_policy(policy), m_rotation(rotation)
+{
+    if (m_policy.bufferSize == 0) m_policy.bufferSize = 1;
+    m_fd = openLogFile(m_path);
+    m_buffer = new char[m_policy.bufferSize];
+
+    m_rotates = m_fd != -1 && (m_rotation.maxBytes > 0 || m_rotation.every != RotateEvery::Never);
+    if (m_rotates) {
+        struct stat st;
+        if (::fstat(m_fd, &st) == 0) m_fileBytes = size_t(st.st_size);
+        m_nextBoundary = nextBoundary(std::chrono::system_clock::now(), m_rotation.every);
+#ifndef LOGGER_HAVE_ZLIB
+        if (m_rotation.compress) {
+            fprintf(stderr, "logger: built without zlib, rotated segments stay uncompressed\n");
+        }
+#endif
+        m_maintenance = std::thread(&FileSink::maintenanceLoop, this);
+    }
+}
+
+FileSink::~FileSink() {
+    flush();
+    if (m_fd != -1) {
+        ::close(m_fd);
+    }
+    delete[] m_buffer;
+
+    if (m_maintenance.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+            m_stopMaintenance = true;
+        }
+        m_maintenanceWake.notify_one();
+        m_maintenance.join();  // finishes queued compressions
+    }
+}
+
+void FileSink::setFormat(FileFormat format) {
+    if (format == FileFormat::JsonLines) {
+        setFormatter(appendJsonLine);
+    } else {
+        setFormatter(nullptr);
+    }
+}
+
+void FileSink::append(std::string_view record, LogLevel level) {
+    if (m_fd == -1) return;
+    if (m_rotates && rotationDue(record.size())) {
+        rotate();
+    }
+
+    if (m_used + record.size() > m_policy.bufferSize) {
+        // Group commit: buffered records and this one in a single writev
+        writeAll(m_buffer, m_used, record.data(), record.size());
+        m_used = 0;
+        m_pendingError = false;
+    } else {
+        if (m_used == 0) m_oldest = std::chrono::steady_clock::now();
+        std::memcpy(m_buffer + m_used, record.data(), record.size());
+        m_used += record.size();
+    }
+
+    if (level == LogLevel::Error) {
+        m_pendingError = true;
+    }
+}
+
+void FileSink::commit() {
+    if (m_used == 0) return;
+    if (m_used >= m_policy.everyBytes || (m_policy.onError && m_pendingError)) {
+        flush();
+    }
+}
+
+void FileSink::flush() {
+    if (m_fd == -1) return;
+    if (m_used > 0) {
+        writeAll(m_buffer, m_used, nullptr, 0);
+        m_used = 0;
+    }
+    m_pendingError = false;
+    if (m_policy.durability == Durability::Fsync) {
+        ::fdatasync(m_fd);
+    }
+}
+
+void FileSink::flushIfDue(std::chrono::steady_clock::time_point now) {
+    if (m_used == 0 || m_policy.interval.count() <= 0) return;
+    if (now - m_oldest >= m_policy.interval) {
+        flush();
+    }
+}
+
+bool FileSink::rotationDue(size_t recordSize) const {
+    size_t size = m_fileBytes + m_used;
+    if (m_rotation.maxBytes > 0 && size > 0 && size + recordSize > m_rotation.maxBytes) {
+        return true;
+    }
+    return m_rotation.every != RotateEvery::Never && std::chrono::system_clock::now() >= m_nextBoundary;
+}
+
+// Buffered records go to the old file, which is then renamed in one step:
+// readers see either the whole segment or none of it
+void FileSink::rotate() {
+    flush();
+    m_nextBoundary = nextBoundary(std::chrono::system_clock::now(), m_rotation.every);
+
+    std::string segment = segmentName();
+    if (::rename(m_path.c_str(), segment.c_str()) != 0) {
+        perror("log rotation failed");
+        m_fileBytes = 0;  // keep appending; retry after another maxBytes
+        return;
+    }
+    int fd = openLogFile(m_path);
+    if (fd == -1) {
+        perror("log rotation: cannot open a new file");
+        m_fileBytes = 0;  // the old descriptor still works (now the segment)
+        return;
+    }
+    ::close(m_fd);
+    m_fd = fd;
+    m_fileBytes = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+        m_segments.push_back(std::move(segment));
+    }
+    m_maintenanceWake.notify_one();
+}
+
+void FileSink::maintenanceLoop() {
+    for (;;) {
+        std::string segment;
+        {
+            std::unique_lock<std::mutex> lock(m_maintenanceMutex);
+            m_maintenanceWake.wait(lock, [&]() { return m_stopMaintenance || !m_segments.empty(); });
+            if (m_segments.empty()) return;
+            segment = std::move(m_segments.front());
+            m_segments.pop_front();
+        }
+#ifdef LOGGER_HAVE_ZLIB
+        if (m_rotation.compress) compressSegment(segment);
+#endif
+        if (m_rotation.keep > 0) enforceRetention();
+    }
+}
+
+// Removes the oldest segments of this file beyond RotationPolicy::keep.
+void FileSink::enforceRetention() {
+    size_t slash = m_path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : m_path.substr(0, slash + 1);
+    std::string prefix = (slash == std::string::npos ? m_path : m_path.substr(slash + 1)) + ".";
+
+    DIR* handle = ::opendir(dir.c_str());
+    if (handle == nullptr) return;
+    std::vector<std::string> segments;
+    while (dirent* entry = ::readdir(handle)) {
+        std::string_view name(entry->d_name);
+        if (name.size() < prefix.size() + 15 || name.compare(0, prefix.size(), prefix) != 0) continue;
+        std::string_view stamp = name.substr(prefix.size());
+        if (stamp.size() >= 4 && stamp.substr(stamp.size() - 4) == ".tmp") continue;  // being compressed
+        if (stamp.size() >= 3 && stamp.substr(stamp.size() - 3) == ".gz") stamp.remove_suffix(3);
+        if (stamp[8] != '-' || !std::all_of(stamp.begin(), stamp.begin() + 8, [](char c) { return c >= '0' && c <= '9'; })) continue;
+        segments.emplace_back(stamp);
+    }
+    ::closedir(handle);
+
+    // By timestamp, then by the "-N" suffix of same-second segments as a number
+    auto suffix = [](const std::string& stamp) {
+        return stamp.size() > 16 ? std::strtoul(stamp.c_str() + 16, nullptr, 10) : 0ul;
+    };
+    std::sort(segments.begin(), segments.end(), [&](const std::string& a, const std::string& b) {
+        int order = a.compare(0, 15, b, 0, 15);
+        return order != 0 ? order < 0 : suffix(a) < suffix(b);
+    });
+    segments.erase(std::unique(segments.begin(), segments.end()), segments.end());
+    if (segments.size() <= m_rotation.keep) return;
+
+    std::string base = slash == std::string::npos ? m_path + "." : dir + prefix;
+    for (size_t i = 0; i + m_rotation.keep < segments.size(); ++i) {
+        ::unlink((base + segments[i]).c_str());
+        ::unlink((base + segments[i] + ".gz").c_str());
+    }
+}
+
+void FileSink::writeAll(const char* first, size_t firstSize, const char* second, size_t secondSize) {
+    iovec iov[2] = {
+        { const_cast<char*>(first), firstSize },
+        { const_cast<char*>(second), secondSize }
+    };
+    int count = secondSize > 0 ? 2 : 1;
+    iovec* current = iov;
+
+    while (count > 0) {
+        ssize_t written = ::writev(m_fd, current, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            perror("log file write failed");
+            return;
+        }
+        m_fileBytes += size_t(written);
+        // Skip what the kernel took, resume on a partial write
+        while (count > 0 && (size_t)written >= current->iov_len) {
+            written -= current->iov_len;
+            ++current;
+            --count;
+        }
+        if (count > 0) {
+            current->iov_base = static_cast<char*>(current->iov_base) + written;
+            current->iov_len -= written;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "sink.hpp"
+
+enum class Durability {
+    None,   // leave write-back to the kernel
+    Fsync   // fdatasync after every flush (opt-in, slow)
+};
+
+// When buffered records are handed to the kernel. Records are always
+// written when the buffer is full; the fields below add earlier triggers.
+struct FlushPolicy {
+    size_t bufferSize = 64 * 1024;
+    size_t everyBytes = 0;                   // flush once this much is buffered, 0 = after every commit
+    std::chrono::milliseconds interval{0};   // flush data older than this, 0 = off
+    bool onError = true;                     // flush right after an Error record
+    Durability durability = Durability::None;
+};
+
+enum class RotateEvery {
+    Never,
+    Hour,   // local wall-clock boundaries
+    Day
+};
+
+// When the active file is renamed to a segment "<file>.<YYYYmmdd-HHMMSS>"
+// and a new file is started. Rotation happens on the first record past a
+// limit, so no empty segments are created.
+struct RotationPolicy {
+    size_t maxBytes = 0;                     // rotate before the file would grow past this, 0 = off
+    RotateEvery every = RotateEvery::Never;
+    size_t keep = 0;                         // segments kept (oldest removed first), 0 = all
+    bool compress = false;                   // gzip segments on a background thread (needs zlib)
+};
+
+enum class FileFormat {
+    Text,       // the record line as formatted by Logger
+    JsonLines   // one JSON object per record, fields as members
+};
+
+// Append-only file with its own write buffer. Records are coalesced and
+// written with one writev per group commit. Not thread-safe: Logger
+// serializes access (its mutex in sync mode, the writer thread in async).
+class FileSink : public Sink {
+public:
+    FileSink(const std::string& filename, const FlushPolicy& policy,
+             const RotationPolicy& rotation = RotationPolicy());
+    ~FileSink();
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    bool isOpen() const { return m_fd != -1; }
+
+    // Shorthand for setFormatter with the built-in formats
+    void setFormat(FileFormat format);
+
+    void write(const LogRecord& record) override { append(render(record), record.level); }
+
+    // Buffers one record; nothing reaches the file until commit/flush
+    // unless the buffer is full
+    void append(std::string_view record, LogLevel level);
+
+    // End of a record or batch: flushes if the policy says so
+    void commit() override;
+
+    // Writes everything buffered (and syncs under Durability::Fsync)
+    void flush() override;
+
+    // Time-based trigger, called periodically by Logger
+    void flushIfDue(std::chrono::steady_clock::time_point now);
+
+    void poll(std::chrono::steady_clock::time_point now) override { flushIfDue(now); }
+    bool needsPoll() const override { return m_policy.interval.count() > 0; }
+
+private:
+    void writeAll(const char* first, size_t firstSize, const char* second, size_t secondSize);
+
+    bool rotationDue(size_t recordSize) const;
+    void rotate();
+    std::string segmentName();
+    void maintenanceLoop();
+    void enforceRetention();
+
+    int m_fd = -1;
+    std::string m_path;
+    FlushPolicy m_policy;
+    RotationPolicy m_rotation;
+    bool m_rotates = false;
+    size_t m_fileBytes = 0;  // size of the active file as written so far
+    std::chrono::system_clock::time_point m_nextBoundary = std::chrono::system_clock::time_point::max();
+    std::string m_lastSegmentBase;
+    int m_lastSegmentIndex = 0;
+
+    // Compression and retention of segments run here, off the logging path
+    std::thread m_maintenance;
+    std::mutex m_maintenanceMutex;
+    std::condition_variable m_maintenanceWake;
+    std::deque<std::string> m_segments;
+    bool m_stopMaintenance = false;
+
+    char* m_buffer = nullptr;
+    size_t m_used = 0;
+    bool m_pendingError = false;
+    std::chrono::steady_clock::time_point m_oldest;
+};
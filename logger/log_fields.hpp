@@ -0,0 +1,178 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "sink.hpp"
+
+// Typed key/value fields attached to a record:
+//   logger.log("request done", LogLevel::Info, {{"service", "auth"}, {"latency_ms", 12.5}});
+// Logger encodes them once into a compact blob (LogRecord::fields) and
+// appends them to the text line as " key=value" pairs; sinks that want
+// another representation (JSON lines) render it straight from the blob.
+
+struct LogField {
+    enum class Type : uint8_t { Int = 'i', Double = 'd', Bool = 'b', String = 's' };
+
+    std::string_view key;
+    Type type = Type::Int;
+    int64_t i = 0;
+    double d = 0;
+    std::string_view s;
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    LogField(std::string_view key, T value) : key(key), type(Type::Int), i(int64_t(value)) {}
+    template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+    LogField(std::string_view key, T value) : key(key), type(Type::Double), d(double(value)) {}
+    LogField(std::string_view key, bool value) : key(key), type(Type::Bool), i(value) {}
+    LogField(std::string_view key, std::string_view value) : key(key), type(Type::String), s(value) {}
+    LogField(std::string_view key, const char* value) : LogField(key, std::string_view(value ? value : "")) {}
+    LogField(std::string_view key, const std::string& value) : LogField(key, std::string_view(value)) {}
+};
+
+namespace fields {
+
+// Blob layout per field: type byte, key length byte, key, then the value:
+// 8 bytes (Int, Double, host order), 1 byte (Bool) or a 4-byte length and
+// the bytes (String). It never leaves the process.
+inline void encode(std::string& out, const LogField& field) {
+    size_t keySize = field.key.size() < 255 ? field.key.size() : 255;
+    out.push_back(char(field.type));
+    out.push_back(char(keySize));
+    out.append(field.key.data(), keySize);
+    switch (field.type) {
+    case LogField::Type::Int: out.append(reinterpret_cast<const char*>(&field.i), 8); break;
+    case LogField::Type::Double: out.append(reinterpret_cast<const char*>(&field.d), 8); break;
+    case LogField::Type::Bool: out.push_back(field.i != 0 ? 1 : 0); break;
+    case LogField::Type::String: {
+        uint32_t size = uint32_t(field.s.size());
+        out.append(reinterpret_cast<const char*>(&size), 4);
+        out.append(field.s.data(), field.s.size());
+        break;
+    }
+    }
+}
+
+// Calls f(const LogField&) for every field of a blob written by encode
+template <typename F>
+void forEach(std::string_view blob, F&& f) {
+    const char* p = blob.data();
+    const char* end = p + blob.size();
+    while (end - p >= 2) {
+        LogField field("", int64_t(0));
+        field.type = LogField::Type(uint8_t(p[0]));
+        size_t keySize = uint8_t(p[1]);
+        p += 2;
+        field.key = std::string_view(p, keySize);
+        p += keySize;
+        switch (field.type) {
+        case LogField::Type::Int: std::memcpy(&field.i, p, 8); p += 8; break;
+        case LogField::Type::Double: std::memcpy(&field.d, p, 8); p += 8; break;
+        case LogField::Type::Bool: field.i = *p++; break;
+        case LogField::Type::String: {
+            uint32_t size;
+            std::memcpy(&size, p, 4);
+            field.s = std::string_view(p + 4, size);
+            p += 4 + size;
+            break;
+        }
+        }
+        f(field);
+    }
+}
+
+inline void appendNumber(std::string& out, const LogField& field) {
+    char buffer[32];
+    auto result = field.type == LogField::Type::Double
+        ? std::to_chars(buffer, buffer + sizeof(buffer), field.d)
+        : std::to_chars(buffer, buffer + sizeof(buffer), field.i);
+    out.append(buffer, result.ptr - buffer);
+}
+
+// " key=value" pairs (logfmt); strings are quoted when they have to be
+inline void appendText(std::string& out, std::string_view blob) {
+    forEach(blob, [&](const LogField& field) {
+        out.push_back(' ');
+        out.append(field.key);
+        out.push_back('=');
+        switch (field.type) {
+        case LogField::Type::Bool: out.append(field.i ? "true" : "false"); break;
+        case LogField::Type::String: {
+            bool quote = field.s.empty() || field.s.find_first_of(" \"=\\\n\t") != std::string_view::npos;
+            if (!quote) {
+                out.append(field.s);
+                break;
+            }
+            out.push_back('"');
+            for (char c : field.s) {
+                if (c == '"' || c == '\\') out.push_back('\\');
+                if (c == '\n') { out.append("\\n"); continue; }
+                out.push_back(c);
+            }
+            out.push_back('"');
+            break;
+        }
+        default: appendNumber(out, field); break;
+        }
+    });
+}
+
+inline void appendJsonString(std::string& out, std::string_view text) {
+    static const char kHex[] = "0123456789abcdef";
+    out.push_back('"');
+    for (char c : text) {
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                out.append("\\u00");
+                out.push_back(kHex[(unsigned char)c >> 4]);
+                out.push_back(kHex[c & 15]);
+            } else {
+                out.push_back(c);
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+}
+
+// {"time":"...","level":"Info","message":"...",<fields>}\n
+inline void appendJsonLine(std::string& out, const LogRecord& record) {
+    std::string_view name = levelName(record.level);
+    out.append("{\"time\":");
+    // The line starts with "<timestamp> [<Level>] "
+    fields::appendJsonString(out, record.line.substr(0, record.messageOffset - name.size() - 4));
+    out.append(",\"level\":\"");
+    out.append(name);
+    out.append("\",\"message\":");
+    fields::appendJsonString(out, record.message());
+    fields::forEach(record.fields, [&](const LogField& field) {
+        out.push_back(',');
+        fields::appendJsonString(out, field.key);
+        out.push_back(':');
+        switch (field.type) {
+        case LogField::Type::Bool: out.append(field.i ? "true" : "false"); break;
+        case LogField::Type::String: fields::appendJsonString(out, field.s); break;
+        case LogField::Type::Double:
+            if (!std::isfinite(field.d)) {
+                out.append("null");
+                break;
+            }
+            fields::appendNumber(out, field);
+            break;
+        default: fields::appendNumber(out, field); break;
+        }
+    });
+    out.append("}\n");
+}
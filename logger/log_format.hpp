@@ -0,0 +1,70 @@
+#pragma once
+
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Minimal "{}" formatter used by Logger::logf and the LOG_* macros.
+// Each "{}" takes the next argument; "{{" and "}}" are literal braces.
+// Supported arguments: strings, bool, char, integers, floating point.
+
+namespace logfmt {
+
+inline void appendArg(std::string& out, std::string_view value) { out.append(value); }
+inline void appendArg(std::string& out, const char* value) { out.append(value ? value : "(null)"); }
+inline void appendArg(std::string& out, const std::string& value) { out.append(value); }
+inline void appendArg(std::string& out, bool value) { out.append(value ? "true" : "false"); }
+inline void appendArg(std::string& out, char value) { out.push_back(value); }
+
+template <typename T>
+std::enable_if_t<std::is_arithmetic_v<T>> appendArg(std::string& out, T value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr - buffer);
+}
+
+template <typename T>
+std::enable_if_t<std::is_enum_v<T>> appendArg(std::string& out, T value) {
+    appendArg(out, static_cast<std::underlying_type_t<T>>(value));
+}
+
+// Appends fmt up to the next "{}" and returns the position after it,
+// or npos once fmt is exhausted
+inline size_t appendLiteral(std::string& out, std::string_view fmt) {
+    size_t i = 0;
+    while (i < fmt.size()) {
+        char c = fmt[i];
+        if (c == '{' && i + 1 < fmt.size()) {
+            if (fmt[i + 1] == '}') return i + 2;
+            if (fmt[i + 1] == '{') { out.push_back('{'); i += 2; continue; }
+        }
+        if (c == '}' && i + 1 < fmt.size() && fmt[i + 1] == '}') {
+            out.push_back('}');
+            i += 2;
+            continue;
+        }
+        out.push_back(c);
+        ++i;
+    }
+    return std::string_view::npos;
+}
+
+inline void formatTo(std::string& out, std::string_view fmt) {
+    // Placeholders without arguments are kept as-is
+    size_t pos;
+    while ((pos = appendLiteral(out, fmt)) != std::string_view::npos) {
+        out.append("{}");
+        fmt.remove_prefix(pos);
+    }
+}
+
+template <typename T, typename... Rest>
+void formatTo(std::string& out, std::string_view fmt, const T& first, const Rest&... rest) {
+    size_t pos = appendLiteral(out, fmt);
+    if (pos == std::string_view::npos) return;  // extra arguments are ignored
+    appendArg(out, first);
+    formatTo(out, fmt.substr(pos), rest...);
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Rate limiting and sampling, applied before a record is formatted.
+// Dropped records are counted and reported as "N records suppressed ..."
+// records at the same level, at most once per summaryInterval.
+struct LimitOptions {
+    double perSecond = 0;        // token bucket per call site (LOG_* macros), 0 = off
+    double burst = 1;            // records a site may log at once after being quiet
+    std::array<uint32_t, 4> sampleEvery{ { 1, 1, 1, 1 } };  // keep ~1 in N, per level Debug..Error
+    std::chrono::milliseconds summaryInterval{ 10000 };
+};
+
+// Limiter state of one call site for one Logger. Logger keeps one per level
+// for log()/logf() without a site, and one per LOG_* call site it logs from
+// (see LogCallSite). Updated with single atomic operations only, on its own
+// cache line.
+struct alignas(64) LogSite {
+    constexpr LogSite(const char* file = nullptr, int line = 0) : file(file), line(line) {}
+
+    const char* file;
+    int line;
+    int level = 0;                          // of the call site's records, for the last summary
+    std::atomic<int64_t> readyNs{ 0 };     // token bucket as GCRA: when the bucket is full again
+    std::atomic<uint64_t> suppressed{ 0 };  // since the last summary
+    std::atomic<int64_t> reportedNs{ 0 };  // time of the last summary
+    std::atomic<bool> used{ false };        // on its Logger's list of sites
+};
+
+// The LOG_* macros keep a static one per call site: a LogSite for each of
+// the first kLogSiteSlots Loggers with limits alive at once, so Loggers
+// running the same code keep apart buckets and counts. Further Loggers keep
+// theirs in a map of their own.
+inline constexpr int kLogSiteSlots = 4;
+
+struct LogCallSite {
+    constexpr LogCallSite(const char* file, int line) : file(file), line(line) {}
+
+    const char* file;
+    int line;
+    LogSite slots[kLogSiteSlots];
+};
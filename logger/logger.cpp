@@ -1,4 +1,7 @@
 #include "logger.hpp"
+#include "bounded_queue.hpp"
+#include "spsc_ring.hpp"
+#include "log_fields.hpp"
 
 #include <chrono>
 #include <iomanip>
@@ -7,111 +10,672 @@
 
 #include <stdexcept>
 #include <unistd.h>
-#include <arpa/inet.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <limits>
 
 
+// The file and/or server of the filename/host/port constructor
+static std::vector<std::shared_ptr<Sink>> outputSinks(const std::string& filename, LogOutput outputMode,
+                                                      const std::string& host, int port,
+                                                      const LoggerOptions& options) {
+    SinkMode mode = options.async.enabled ? SinkMode::Async : SinkMode::Inline;
+    std::vector<std::shared_ptr<Sink>> sinks;
+    if (outputMode == LogOutput::File || outputMode == LogOutput::Both) {
+        auto file = std::make_shared<FileSink>(filename, options.flush, options.rotation);
+        if (!file->isOpen()) {
+            std::cout << "File does not exist" << std::endl;
+        }
+        file->setFormat(options.fileFormat);
+        sinks.push_back(std::move(file));
+    }
+    if (outputMode == LogOutput::Socket || outputMode == LogOutput::Both) {
+        sinks.push_back(std::make_shared<SocketSink>(host, port, options.socket));
+    }
+    for (auto& sink : sinks) sink->setMode(mode);
+    if (!options.ring.path.empty()) {
+        // Always Inline: the point is to hold the last records before a crash
+        sinks.push_back(std::make_shared<RingSink>(options.ring.path, options.ring.bytes));
+    }
+    return sinks;
+}
+
+// A producer thread's buffer for AsyncOptions::perThread. `pending` is the
+// order stamp (steady_clock) of the record its owner is logging right now:
+// kClaiming while the clock is being read, kIdle between records (see
+// mergeBatch)
+struct Logger::ThreadBuffer {
+    static constexpr int64_t kIdle = std::numeric_limits<int64_t>::max();
+    static constexpr int64_t kClaiming = std::numeric_limits<int64_t>::min();
+
+    explicit ThreadBuffer(size_t capacity) : ring(capacity) {}
+
+    SpscRing<AsyncRecord> ring;
+    alignas(64) std::atomic<int64_t> pending{kIdle};
+    std::atomic<bool> exited{false};    // the owner thread is gone, drain and drop
+    std::atomic<bool> orphaned{false};  // the Logger is gone
+};
+
+static std::atomic<uint64_t> s_nextLoggerId{1};
+
+// Bit i: LogCallSite::slots[i] belongs to a live Logger
+static std::atomic<uint32_t> s_siteSlots{0};
+
+static int claimSiteSlot() {
+    uint32_t taken = s_siteSlots.load();
+    for (;;) {
+        int slot = 0;
+        while (slot < kLogSiteSlots && (taken & (1u << slot))) ++slot;
+        if (slot == kLogSiteSlots) return -1;
+        if (s_siteSlots.compare_exchange_weak(taken, taken | (1u << slot))) return slot;
+    }
+}
+
 Logger::Logger(const std::string& filename, LogLevel level,
     LogOutput outputMode,
     const std::string& host,
-    int port)
-    : defaultLevel(level), m_outputMode(outputMode)
+    int port,
+    const LoggerOptions& options)
+    : Logger(outputSinks(filename, outputMode, host, port, options), level, options)
 {
-    m_output.open(filename, std::ios::app);
-    if (!m_output.is_open()) {
-        std::cout << "File does not exist" << std::endl;
+}
+
+Logger::Logger(std::vector<std::shared_ptr<Sink>> sinks, LogLevel level, const LoggerOptions& options)
+    : defaultLevel(level), m_timestamp(options.timestamp), m_limits(options.limits),
+      m_async(options.async), m_id(s_nextLoggerId.fetch_add(1)), m_flushInterval(options.flush.interval)
+{
+    if (m_limits.perSecond > 0) {
+        m_tokenNs = std::max<int64_t>(1, int64_t(1e9 / m_limits.perSecond));
+        m_burstNs = int64_t(m_tokenNs * (std::max(m_limits.burst, 1.0) - 1));
     }
-    if (m_outputMode == LogOutput::Socket || m_outputMode == LogOutput::Both) {
-        m_socket = socket(AF_INET, SOCK_STREAM, 0);
-        if (m_socket == -1) {
-            throw std::runtime_error("Failed to create socket");
+    m_limited = m_tokenNs > 0 ||
+                std::any_of(m_limits.sampleEvery.begin(), m_limits.sampleEvery.end(), [](uint32_t n) { return n > 1; });
+    if (m_limited) m_siteSlot = claimSiteSlot();
+
+    bool poll = false;
+    for (auto& sink : sinks) {
+        if (auto* socket = dynamic_cast<SocketSink*>(sink.get())) m_sockets.push_back(socket);
+        if (sink->mode() == SinkMode::Async) {
+            m_asyncSinks.push_back(std::move(sink));
+        } else {
+            poll |= sink->needsPoll();
+            m_inlineSinks.push_back(std::move(sink));
         }
+    }
+
+    if (!m_asyncSinks.empty()) {
+        if (!m_async.perThread) m_queue.reset(new BoundedQueue<AsyncRecord>(m_async.capacity));
+        m_writer = std::thread(&Logger::writerLoop, this);
+    }
+    if (poll) {
+        m_flusher = std::thread(&Logger::flusherLoop, this);
+    }
+}
+
+Logger::~Logger() {
+    // What the limits dropped since the last summary. The call sites' slots
+    // are left clean for the next Logger that claims this one.
+    for (int i = 0; i < 4; ++i) {
+        uint64_t count = m_levelSites[i].suppressed.exchange(0);
+        if (count > 0) emitSuppressed(m_levelSites[i], LogLevel(i), count);
+    }
+    for (LogSite* site : m_sites) {
+        uint64_t count = site->suppressed.exchange(0);
+        if (count > 0) emitSuppressed(*site, LogLevel(site->level), count);
+        site->readyNs.store(0);
+        site->reportedNs.store(0);
+        site->used.store(false);
+    }
+    if (m_siteSlot >= 0) s_siteSlots.fetch_and(~(1u << m_siteSlot));
+
+    m_stopping.store(true);
+    wakeWriter();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    if (m_flusher.joinable()) {
+        m_flusher.join();
+    }
+    {
+        // Threads still holding a buffer let go of it on their next new Logger
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        for (auto& buffer : m_buffers) buffer->orphaned.store(true);
+    }
+    for (auto& sink : m_inlineSinks) sink->flush();
+    for (auto& sink : m_asyncSinks) sink->flush();
+}
+
+bool Logger::anyAccepts(const std::vector<std::shared_ptr<Sink>>& sinks, LogLevel level) {
+    for (const auto& sink : sinks) {
+        if (sink->accepts(level)) return true;
+    }
+    return false;
+}
+
+void Logger::log(std::string_view message, LogLevel level) {
+    log(message, level, {});
+}
 
-        m_serverAddr.sin_family = AF_INET;
-        m_serverAddr.sin_port = htons(port);
-        if (inet_pton(AF_INET, host.c_str(), &m_serverAddr.sin_addr) <= 0) {
-            throw std::invalid_argument("Invalid IP address: '" + host + "'");
+void Logger::log(std::string_view message, LogLevel level, std::initializer_list<LogField> fields) {
+    if (!isEnabled(level) || !admitLevel(level)) return;
+    emit(message, level, fields);
+}
+
+static int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sampling first (a per-thread generator, no shared state), then the site's
+// token bucket, kept as GCRA in one atomic: a record passes while the
+// bucket's "full again" time is at most m_burstNs ahead of now
+bool Logger::admitSlow(LogSite& site, LogLevel level, bool rateLimit) {
+    bool keep = true;
+    uint32_t every = m_limits.sampleEvery[std::min(int(level), 3)];
+    if (every > 1) {
+        thread_local uint64_t t_random = 0;  // constant-initialized: no TLS guard on the way
+        if (t_random == 0) t_random = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+        t_random ^= t_random << 13;
+        t_random ^= t_random >> 7;
+        t_random ^= t_random << 17;
+        keep = t_random % every == 0;
+    }
+
+    int64_t nowNs = 0;
+    if (keep && rateLimit && m_tokenNs > 0) {
+        nowNs = steadyNs();
+        int64_t ready = site.readyNs.load(std::memory_order_relaxed);
+        for (;;) {
+            int64_t start = std::max(ready, nowNs);
+            if (start - nowNs > m_burstNs) {
+                keep = false;
+                break;
+            }
+            if (site.readyNs.compare_exchange_weak(ready, start + m_tokenNs, std::memory_order_relaxed)) break;
         }
+    }
+
+    // Whether a summary is due needs the clock: a sampled-out record reads it
+    // only every 64th time, when the bucket has not read it already
+    uint64_t suppressed = keep ? site.suppressed.load(std::memory_order_relaxed)
+                               : site.suppressed.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (suppressed > 0 && (keep || nowNs != 0 || suppressed % 64 == 0)) {
+        reportSuppressed(site, level, nowNs != 0 ? nowNs : steadyNs());
+    }
+    return keep;
+}
 
-        if (connect(m_socket, (sockaddr*)&m_serverAddr, sizeof(m_serverAddr)) < 0) { 
-            perror("connect failed");
-            throw std::runtime_error("Failed to connect to server");
+// This Logger's state of a LOG_* call site. A slot's first use puts it on
+// m_sites; Loggers without a slot look theirs up under the mutex.
+LogSite& Logger::siteFor(LogCallSite& call, LogLevel level) {
+    if (m_siteSlot >= 0) {
+        LogSite& site = call.slots[m_siteSlot];
+        if (site.used.load(std::memory_order_acquire)) return site;
+        std::lock_guard<std::mutex> lock(m_sitesMutex);
+        if (!site.used.load(std::memory_order_relaxed)) {
+            site.file = call.file;
+            site.line = call.line;
+            site.level = int(level);
+            m_sites.push_back(&site);
+            site.used.store(true, std::memory_order_release);
         }
+        return site;
+    }
+    std::lock_guard<std::mutex> lock(m_sitesMutex);
+    std::unique_ptr<LogSite>& site = m_overflowSites[&call];
+    if (!site) {
+        site.reset(new LogSite(call.file, call.line));
+        site->level = int(level);
+        m_sites.push_back(site.get());
     }
+    return *site;
 }
 
-Logger::~Logger() {
-    if (m_output.is_open()) {
-        m_output.close();
+// At most one summary per site and summaryInterval; the first suppression
+// only starts the interval, so a burst does not open with "1 records"
+void Logger::reportSuppressed(LogSite& site, LogLevel level, int64_t nowNs) {
+    int64_t reported = site.reportedNs.load(std::memory_order_relaxed);
+    if (reported != 0 && nowNs - reported < int64_t(m_limits.summaryInterval.count()) * 1000000) return;
+    if (!site.reportedNs.compare_exchange_strong(reported, nowNs, std::memory_order_relaxed)) return;
+    if (reported == 0) return;
+    uint64_t count = site.suppressed.exchange(0, std::memory_order_relaxed);
+    if (count > 0) emitSuppressed(site, level, count);
+}
+
+void Logger::emitSuppressed(const LogSite& site, LogLevel level, uint64_t count) {
+    std::string message = std::to_string(count) + " records suppressed";
+    if (site.file != nullptr) {
+        message += " at ";
+        message += site.file;
+        message += ":" + std::to_string(site.line);
+    } else {
+        message += " by sampling";
+    }
+    emit(message, level, {});
+}
+
+void Logger::emit(std::string_view message, LogLevel level, std::initializer_list<LogField> fields) {
+    // Sinks filter before formatting: an Error-only sink costs nothing for Debug
+    bool toInline = anyAccepts(m_inlineSinks, level);
+    bool toAsync = anyAccepts(m_asyncSinks, level);
+    if (!toInline && !toAsync) return;
+
+    // Announced before the clock is read, so the writer holds back newer
+    // records of other threads until this one is in the buffer. The merge
+    // runs on steady_clock: the wall clock may step back or run ahead.
+    ThreadBuffer* buffer = nullptr;
+    int64_t orderNs = 0;
+    if (toAsync && m_async.perThread) {
+        buffer = &threadBuffer();
+        buffer->pending.store(ThreadBuffer::kClaiming, std::memory_order_seq_cst);
+        orderNs = steadyNs();
+        buffer->pending.store(orderNs, std::memory_order_release);
+    }
+
+    // Reused per thread: once their capacity covers the longest record,
+    // formatting does not allocate
+    thread_local std::string t_line;
+    thread_local std::string t_fields;
+    t_fields.clear();
+    for (const LogField& field : fields) fields::encode(t_fields, field);
+
+    auto now = std::chrono::system_clock::now();
+    LogRecord record;
+    record.level = level;
+    record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    record.messageOffset = formatRecord(t_line, now, message, level, t_fields, record.fieldsOffset);
+    record.line = t_line;
+    record.fields = t_fields;
+
+    if (buffer) {
+        enqueueLocal(*buffer, record, orderNs);
+    } else if (toAsync) {
+        enqueue(record);
+    }
+    if (toInline) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& sink : m_inlineSinks) {
+            if (!sink->accepts(level)) continue;
+            sink->write(record);
+            sink->commit();
+        }
+    }
+}
+
+void Logger::flush() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& sink : m_inlineSinks) sink->flush();
+    }
+    if (m_asyncSinks.empty()) return;
+
+    uint64_t ticket = m_flushRequested.fetch_add(1) + 1;
+    wakeWriter();
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_flushed.wait(lock, [&]() { return m_flushCompleted.load() >= ticket; });
+}
+
+// "<timestamp> [<Level>] <message>[ key=value...]\n", returns where the
+// message starts
+size_t Logger::formatRecord(std::string& out, std::chrono::system_clock::time_point now,
+                            std::string_view message, LogLevel level, std::string_view fields,
+                            size_t& fieldsOffset) const {
+    std::string_view name = levelToString(level);
+    out.resize(kMaxTimestampLength + name.size() + message.size() + 4);
+
+    char* p = &out[0];
+    p += formatTimestamp(now, m_timestamp, p);
+    *p++ = ' ';
+    *p++ = '[';
+    std::memcpy(p, name.data(), name.size());
+    p += name.size();
+    *p++ = ']';
+    *p++ = ' ';
+    size_t messageOffset = p - out.data();
+    std::memcpy(p, message.data(), message.size());
+    p += message.size();
+    fieldsOffset = p - out.data();
+    if (!fields.empty()) {
+        out.resize(fieldsOffset);
+        fields::appendText(out, fields);
+        out.push_back('\n');
+        return messageOffset;
+    }
+    *p++ = '\n';
+    out.resize(p - out.data());
+    return messageOffset;
+}
+
+template <typename Slot>
+static void fillSlot(Slot& queued, const LogRecord& record) {
+    queued.level = record.level;
+    queued.timestampNs = record.timestampNs;
+    queued.messageOffset = uint32_t(record.messageOffset);
+    queued.fieldsOffset = uint32_t(record.fieldsOffset);
+    // Both reuse the slot's capacity
+    queued.line.assign(record.line.data(), record.line.size());
+    queued.fields.assign(record.fields.data(), record.fields.size());
+}
+
+void Logger::enqueue(const LogRecord& record) {
+    auto fill = [&](AsyncRecord& queued) { fillSlot(queued, record); };
+
+    while (!m_queue->tryPush(fill)) {
+        switch (m_async.overflow) {
+        case OverflowPolicy::DropNewest:
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        case OverflowPolicy::DropOldest:
+            if (m_queue->tryPop([](AsyncRecord&) {})) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            break;
+        case OverflowPolicy::Block:
+            wakeWriter();
+            std::this_thread::yield();
+            break;
+        }
     }
-    if (m_socket != -1) {
-        close(m_socket);
+
+    // Pairs with the fence in writerLoop: either the writer sees the record
+    // or we see that it is going to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writerSleeping.load(std::memory_order_relaxed)) {
+        wakeWriter();
     }
 }
 
-void Logger::log(const std::string& message, LogLevel level) {
-    if (level < m_level) return;
+// The calling thread's buffer for this Logger, registered on first use
+Logger::ThreadBuffer& Logger::threadBuffer() {
+    // One entry per Logger the thread logs to. At exit the thread only marks
+    // its buffers; the writer drains them before dropping them.
+    struct Cache {
+        std::vector<std::pair<uint64_t, std::shared_ptr<ThreadBuffer>>> entries;
+        ~Cache() {
+            for (auto& entry : entries) entry.second->exited.store(true, std::memory_order_release);
+        }
+    };
+    thread_local Cache t_cache;
+    for (auto& entry : t_cache.entries) {
+        if (entry.first == m_id) return *entry.second;
+    }
 
-    std::string timestamped = getCurrentTimestamp() + " [" + levelToString(level) + "] " + message + "\n";
+    auto& entries = t_cache.entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const auto& entry) { return entry.second->orphaned.load(); }),
+                  entries.end());
+    auto buffer = std::make_shared<ThreadBuffer>(m_async.capacity);
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.push_back(buffer);
+        m_buffersVersion.fetch_add(1, std::memory_order_release);
+    }
+    entries.emplace_back(m_id, buffer);
+    return *buffer;
+}
 
-    std::lock_guard<std::mutex> lock(m_mutex);
+// Only this thread writes the buffer's lines; the writer reads them. Other
+// producers are never touched unless the buffer overflows.
+void Logger::enqueueLocal(ThreadBuffer& buffer, const LogRecord& record, int64_t orderNs) {
+    auto fill = [&](AsyncRecord& queued) {
+        fillSlot(queued, record);
+        queued.orderNs = orderNs;
+    };
+    while (!buffer.ring.tryPush(fill)) {
+        if (m_async.overflow != OverflowPolicy::Block) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        wakeWriter();
+        std::this_thread::yield();
+    }
+    buffer.pending.store(ThreadBuffer::kIdle, std::memory_order_release);
 
-    if (m_outputMode == LogOutput::File || m_outputMode == LogOutput::Both) {
-        m_output << timestamped;
-        m_output.flush();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writerSleeping.load(std::memory_order_relaxed)) {
+        wakeWriter();
     }
+}
 
-    if (m_outputMode == LogOutput::Socket || m_outputMode == LogOutput::Both) {
-        if (m_socket != -1) {
-            send(m_socket, timestamped.c_str(), timestamped.size(), 0);
+void Logger::wakeWriter() {
+    { std::lock_guard<std::mutex> lock(m_wakeMutex); }
+    m_wake.notify_one();
+}
+
+void Logger::writeAsync(const AsyncRecord& queued) {
+    LogRecord record{ queued.level, queued.timestampNs, queued.line, queued.messageOffset,
+                      queued.fieldsOffset, queued.fields };
+    for (auto& sink : m_asyncSinks) {
+        if (sink->accepts(record.level)) sink->write(record);
+    }
+}
+
+size_t Logger::drainBatch() {
+    auto consume = [&](AsyncRecord& queued) { writeAsync(queued); };
+
+    size_t count = 0;
+    while (count < m_async.batchSize && m_queue->tryPop(consume)) {
+        ++count;
+    }
+    if (count > 0) {
+        for (auto& sink : m_asyncSinks) sink->commit();  // one group commit per batch
+    }
+    return count;
+}
+
+void Logger::refreshBuffers() {
+    uint64_t version = m_buffersVersion.load(std::memory_order_acquire);
+    if (version == m_writerVersion) return;
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    m_writerBuffers = m_buffers;
+    m_writerVersion = m_buffersVersion.load(std::memory_order_relaxed);
+}
+
+// k-way merge of the thread buffers by order stamp. A record goes out only
+// when no thread can still add an older one: `bound` is the oldest record
+// being logged right now (a thread still reading the clock holds back
+// everything), and a thread seen idle reads the clock after we did, so its
+// next record is newer than `horizon`. waiting is set when records older
+// than horizon wait for another thread's record.
+size_t Logger::mergeBatch(bool& waiting) {
+    refreshBuffers();
+    int64_t horizon = steadyNs();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bound = horizon;
+    for (auto& buffer : m_writerBuffers) {
+        bound = std::min(bound, buffer->pending.load(std::memory_order_seq_cst));
+    }
+
+    auto later = std::greater<std::pair<int64_t, size_t>>();
+    m_mergeHeap.clear();
+    for (size_t i = 0; i < m_writerBuffers.size(); ++i) {
+        if (AsyncRecord* head = m_writerBuffers[i]->ring.front()) m_mergeHeap.emplace_back(head->orderNs, i);
+    }
+    std::make_heap(m_mergeHeap.begin(), m_mergeHeap.end(), later);
+
+    size_t count = 0;
+    while (!m_mergeHeap.empty() && count < m_async.batchSize) {
+        auto [orderNs, i] = m_mergeHeap.front();
+        if (orderNs > bound) {
+            waiting = orderNs <= horizon;
+            break;
         }
+        std::pop_heap(m_mergeHeap.begin(), m_mergeHeap.end(), later);
+        m_mergeHeap.pop_back();
+
+        SpscRing<AsyncRecord>& ring = m_writerBuffers[i]->ring;
+        writeAsync(*ring.front());
+        ring.pop();
+        ++count;
+        if (AsyncRecord* next = ring.front()) {
+            m_mergeHeap.emplace_back(next->orderNs, i);
+            std::push_heap(m_mergeHeap.begin(), m_mergeHeap.end(), later);
+        }
+    }
+    if (count > 0) {
+        for (auto& sink : m_asyncSinks) sink->commit();
+    }
+
+    // Buffers of exited threads are dropped once written out
+    auto finished = [](const std::shared_ptr<ThreadBuffer>& buffer) {
+        return buffer->exited.load(std::memory_order_acquire) && buffer->ring.empty();
+    };
+    if (std::any_of(m_writerBuffers.begin(), m_writerBuffers.end(), finished)) {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), finished), m_buffers.end());
+        m_writerBuffers = m_buffers;
+        m_writerVersion = m_buffersVersion.fetch_add(1) + 1;
     }
+    return count;
+}
+
+size_t Logger::drain(bool& waiting) {
+    waiting = false;
+    return m_queue ? drainBatch() : mergeBatch(waiting);
+}
+
+// A thread is between announcing a record and having it in its buffer
+bool Logger::producersLogging() const {
+    for (auto& buffer : m_writerBuffers) {
+        if (buffer->pending.load(std::memory_order_seq_cst) != ThreadBuffer::kIdle) return true;
+    }
+    return false;
+}
+
+// Sleeps while the merge waits for another thread's record: enqueueLocal
+// wakes the writer once the record is in, as it does for an empty queue.
+// A flush request newer than flushServed ends the wait too.
+void Logger::awaitProducers(uint64_t flushServed) {
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_writerSleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producersLogging() && !m_stopping.load() && m_flushRequested.load() == flushServed) {
+        m_wake.wait_for(lock, idlePeriod());
+    }
+    m_writerSleeping.store(false, std::memory_order_relaxed);
+}
+
+bool Logger::queuesEmpty() {
+    if (m_queue) return m_queue->empty();
+    refreshBuffers();
+    for (auto& buffer : m_writerBuffers) {
+        if (!buffer->ring.empty()) return false;
+    }
+    return true;
+}
+
+void Logger::writerLoop() {
+    for (;;) {
+        uint64_t flushRequested = m_flushRequested.load();
+        bool waiting;
+        if (flushRequested != m_flushCompleted.load()) {
+            while (drain(waiting) > 0 || waiting) {
+                if (waiting) awaitProducers(flushRequested);
+            }
+            for (auto& sink : m_asyncSinks) sink->flush();
+            {
+                std::lock_guard<std::mutex> lock(m_wakeMutex);
+                m_flushCompleted.store(flushRequested);
+            }
+            m_flushed.notify_all();
+        }
+
+        if (drain(waiting) > 0) continue;
+        if (waiting) {
+            awaitProducers(m_flushCompleted.load());
+            continue;
+        }
+        auto now = std::chrono::steady_clock::now();
+        for (auto& sink : m_asyncSinks) sink->poll(now);
+
+        if (m_stopping.load()) {
+            // Producers are gone; exit once everything queued is written
+            if (queuesEmpty()) break;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_writerSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queuesEmpty() && !m_stopping.load() &&
+            m_flushRequested.load() == m_flushCompleted.load()) {
+            m_wake.wait_for(lock, idlePeriod());
+        }
+        m_writerSleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+void Logger::flusherLoop() {
+    while (!m_stopping.load()) {
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            if (m_stopping.load()) break;
+            m_wake.wait_for(lock, idlePeriod());
+        }
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& sink : m_inlineSinks) {
+            if (sink->needsPoll()) sink->poll(now);
+        }
+    }
+}
+
+// How long background threads sleep between checks of FlushPolicy::interval
+std::chrono::milliseconds Logger::idlePeriod() const {
+    std::chrono::milliseconds period(50);
+    if (m_flushInterval.count() > 0) {
+        period = std::min(period, std::max(m_flushInterval / 2, std::chrono::milliseconds(1)));
+    }
+    return period;
+}
+
+bool Logger::usesBinaryWire() const {
+    for (const SocketSink* socket : m_sockets) {
+        if (socket->binary()) return true;
+    }
+    return false;
+}
+
+SocketCounters Logger::socketCounters() const {
+    SocketCounters out;
+    out.connected = !m_sockets.empty();
+    for (const SocketSink* socket : m_sockets) {
+        SocketCounters counters = socket->counters();
+        out.connected &= counters.connected;
+        out.queued += counters.queued;
+        out.spoolBytes += counters.spoolBytes;
+        out.sent += counters.sent;
+        out.dropped += counters.dropped;
+        out.reconnects += counters.reconnects;
+    }
+    return out;
+}
+
+uint64_t Logger::droppedCount() const {
+    return m_dropped.load(std::memory_order_relaxed);
 }
 
 void Logger::setLevel(LogLevel level) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_level = level;
+    m_level.store(level, std::memory_order_relaxed);
 }
 void Logger::setDefaultLevel(LogLevel level) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    defaultLevel = level;
+    defaultLevel.store(level, std::memory_order_relaxed);
 }
 
 LogLevel Logger::getDefaultLevel() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return defaultLevel;
+    return defaultLevel.load(std::memory_order_relaxed);
 }
 
 LogLevel Logger::getLevel() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_level;
+    return m_level.load(std::memory_order_relaxed);
 }
 
-std::string Logger::levelToString(LogLevel level) const {
-    switch (level) {
-    case LogLevel::Debug:   return "Debug";
-    case LogLevel::Info:    return "Info";
-    case LogLevel::Warning: return "Warning";
-    case LogLevel::Error:   return "Error";
-    default:                return "Unknown";
-    }
+std::string& Logger::formatBuffer() {
+    thread_local std::string t_message;
+    return t_message;
 }
 
-std::string Logger::getCurrentTimestamp() const {
-    auto now = std::chrono::system_clock::now();
-    auto t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm{};
-#ifdef _WIN32
-    localtime_s(&tm, &t);  // Windows
-#else
-    localtime_r(&t, &tm);  // POSIX
-#endif
-    char buffer[20];
-    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
-    return buffer;
-}
 
 
 void log_hello() {
@@ -1,57 +1,264 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
-#include <fstream>
+#include <string_view>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <unordered_map>
+#include <condition_variable>
+#include <cstdint>
 #include <stdexcept>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
+#include <vector>
+#include "timestamp.hpp"
+#include "sink.hpp"
+#include "file_sink.hpp"
+#include "log_format.hpp"
+#include "log_fields.hpp"
+#include <initializer_list>
+#include "socket_sink.hpp"
+#include "ring_sink.hpp"
+#include "log_limits.hpp"
 
 
 void log_hello();
 
-enum class LogLevel {
-    Debug = 0,
-    Info,
-    Warning,
-    Error,
-    Default
-};
-
+// Sinks made by the filename/host/port constructor
 enum class LogOutput {
     File,
     Socket,
     Both
 };
 
+// What a producer does when the async queue is full
+enum class OverflowPolicy {
+    Block,       // wait for the writer to free a slot
+    DropNewest,  // discard the record being logged
+    DropOldest   // discard the oldest queued record
+};
+
+// Queue and writer thread shared by all SinkMode::Async sinks
+struct AsyncOptions {
+    bool enabled = false;        // file/socket of the filename/host/port constructor are Async
+    size_t capacity = 8192;      // rounded up to a power of two
+    OverflowPolicy overflow = OverflowPolicy::Block;
+    size_t batchSize = 256;      // records written per I/O batch
+    // A buffer of `capacity` records per producer thread instead of the
+    // shared queue; the writer merges them in the order they were logged
+    // (steady_clock: a step of the wall clock neither stalls nor reorders
+    // them). DropOldest acts as DropNewest here: only the writer takes from
+    // a buffer.
+    bool perThread = false;
+};
+
+// Crash-safe copy of the newest records, see RingSink
+struct RingOptions {
+    std::string path;            // empty = no ring
+    size_t bytes = 1024 * 1024;
+};
+
+struct LoggerOptions {
+    AsyncOptions async;
+    TimestampOptions timestamp;
+    FlushPolicy flush;
+    RotationPolicy rotation;
+    FileFormat fileFormat = FileFormat::Text;
+    SocketOptions socket;
+    RingOptions ring;            // added to the filename/host/port constructor's sinks
+    LimitOptions limits;
+};
+
+template <typename T> class BoundedQueue;
+
 class Logger {
 public:
+    // A file and/or a log server, as selected by outputMode
     Logger(const std::string& filename, LogLevel level = LogLevel::Info,
         LogOutput outputMode = LogOutput::File,
         const std::string& host = "",
-        int port = 0);
+        int port = 0,
+        const LoggerOptions& options = LoggerOptions());
+
+    // Any number of sinks, each with its own level, formatter and mode.
+    // A record is formatted once, and only if some sink accepts its level.
+    explicit Logger(std::vector<std::shared_ptr<Sink>> sinks, LogLevel level = LogLevel::Info,
+        const LoggerOptions& options = LoggerOptions());
     ~Logger();
 
-    void log(const std::string& message, LogLevel level = LogLevel::Info);
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Accepts std::string, string literals and views without copying
+    void log(std::string_view message, LogLevel level = LogLevel::Info);
+
+    // With typed fields: {{"service", "auth"}, {"latency_ms", 12.5}, {"ok", true}}
+    void log(std::string_view message, LogLevel level, std::initializer_list<LogField> fields);
+
+    // Formats "{}" placeholders only after the level check passes
+    template <typename... Args>
+    void logf(LogLevel level, std::string_view fmt, const Args&... args) {
+        if (!isEnabled(level) || !admitLevel(level)) return;
+        logAdmitted(level, fmt, args...);
+    }
+
+    // logf for a record admit() has already let through
+    template <typename... Args>
+    void logAdmitted(LogLevel level, std::string_view fmt, const Args&... args) {
+        std::string& message = formatBuffer();
+        message.clear();
+        logfmt::formatTo(message, fmt, args...);
+        emit(message, level, {});
+    }
+
+    // Lock-free runtime level check: the logger's level, then whether any
+    // sink takes the level, so nothing is formatted for a record none writes
+    bool isEnabled(LogLevel level) const {
+        return level >= m_level.load(std::memory_order_relaxed) &&
+               (anyAccepts(m_inlineSinks, level) || anyAccepts(m_asyncSinks, level));
+    }
+
+    // LoggerOptions::limits for a record from `site`: false when it is to be
+    // dropped. Lock-free; costs one branch when no limits are set.
+    bool admit(LogCallSite& site, LogLevel level) {
+        return !m_limited || admitSlow(siteFor(site, level), level, true);
+    }
+
+    // Writes out everything logged so far (waits for the async writer)
+    void flush();
 
     void setLevel(LogLevel level);
     LogLevel getLevel() const;
     LogLevel getDefaultLevel() const;
     void setDefaultLevel(LogLevel level);
-    std::string levelToString(LogLevel level) const;
+    static constexpr std::string_view levelToString(LogLevel level) { return levelName(level); }
+
+    // Records discarded by the async overflow policy
+    uint64_t droppedCount() const;
+
+    // True when a server accepted the binary wire format
+    bool usesBinaryWire() const;
+
+    // Delivery state of the log server connections, summed over socket
+    // sinks (all zero without one); connected means all of them are
+    SocketCounters socketCounters() const;
 
 private:
-    std::string getCurrentTimestamp() const;
+    static std::string& formatBuffer();
+    void emit(std::string_view message, LogLevel level, std::initializer_list<LogField> fields);
+
+    // Sampling only: a record without a call site
+    bool admitLevel(LogLevel level) {
+        return !m_limited || admitSlow(m_levelSites[std::min(int(level), 3)], level, false);
+    }
+    bool admitSlow(LogSite& site, LogLevel level, bool rateLimit);
+    LogSite& siteFor(LogCallSite& call, LogLevel level);
+    void reportSuppressed(LogSite& site, LogLevel level, int64_t nowNs);
+    void emitSuppressed(const LogSite& site, LogLevel level, uint64_t count);
+    static bool anyAccepts(const std::vector<std::shared_ptr<Sink>>& sinks, LogLevel level);
+
+    size_t formatRecord(std::string& out, std::chrono::system_clock::time_point now,
+                        std::string_view message, LogLevel level, std::string_view fields,
+                        size_t& fieldsOffset) const;
+    void enqueue(const LogRecord& record);
+    void wakeWriter();
+    void writerLoop();
+    size_t drainBatch();
+
+    struct ThreadBuffer;
+    ThreadBuffer& threadBuffer();
+    void enqueueLocal(ThreadBuffer& buffer, const LogRecord& record, int64_t orderNs);
+    void refreshBuffers();
+    size_t mergeBatch(bool& waiting);
+    size_t drain(bool& waiting);
+    bool queuesEmpty();
+    bool producersLogging() const;
+    void awaitProducers(uint64_t flushServed);
+    void flusherLoop();
+    std::chrono::milliseconds idlePeriod() const;
 
 private:
-    std::ofstream m_output;
-    LogLevel m_level = LogLevel::Debug;
-    LogLevel defaultLevel;
-    mutable std::mutex m_mutex;
-
-    LogOutput m_outputMode;
-    int m_socket = -1;
-    sockaddr_in m_serverAddr{};
+    std::atomic<LogLevel> m_level{LogLevel::Debug};
+    std::atomic<LogLevel> defaultLevel;
+    mutable std::mutex m_mutex;  // serializes Inline sinks
+
+    TimestampOptions m_timestamp;
+
+    LimitOptions m_limits;
+    bool m_limited = false;
+    int64_t m_tokenNs = 0;      // one token of the bucket
+    int64_t m_burstNs = 0;      // how far a site may run ahead of its rate
+    LogSite m_levelSites[4];
+    int m_siteSlot = -1;         // into LogCallSite::slots, -1 for m_overflowSites
+    std::mutex m_sitesMutex;
+    std::vector<LogSite*> m_sites;  // call sites used, reported and cleared by ~Logger
+    std::unordered_map<const LogCallSite*, std::unique_ptr<LogSite>> m_overflowSites;
+
+    std::vector<std::shared_ptr<Sink>> m_inlineSinks;
+    std::vector<std::shared_ptr<Sink>> m_asyncSinks;   // touched only by m_writer
+    std::vector<SocketSink*> m_sockets;               // for the counters
+
+    // Async sinks: producers push into m_queue (or their ThreadBuffer), m_writer
+    // does all their I/O
+    struct AsyncRecord {
+        LogLevel level = LogLevel::Info;
+        int64_t timestampNs = 0;
+        int64_t orderNs = 0;         // steady_clock, the key of the per-thread merge
+        uint32_t messageOffset = 0;  // where the message starts inside line
+        uint32_t fieldsOffset = 0;
+        std::string line;
+        std::string fields;          // encoded, see log_fields.hpp
+    };
+    void writeAsync(const AsyncRecord& queued);
+
+    AsyncOptions m_async;
+    std::unique_ptr<BoundedQueue<AsyncRecord>> m_queue;
+    std::thread m_writer;
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_writerSleeping{false};
+    std::atomic<uint64_t> m_dropped{0};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+
+    // AsyncOptions::perThread: each producer thread registers its own
+    // buffer on its first record; m_writer merges them
+    uint64_t m_id;  // tells Loggers apart in the threads' buffer caches
+    std::mutex m_buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;  // guarded by m_buffersMutex
+    std::atomic<uint64_t> m_buffersVersion{0};
+    std::vector<std::shared_ptr<ThreadBuffer>> m_writerBuffers;  // m_writer's copy of m_buffers
+    uint64_t m_writerVersion = 0;
+    std::vector<std::pair<int64_t, size_t>> m_mergeHeap;
+
+    // Logger::flush() handshake with the writer thread
+    std::atomic<uint64_t> m_flushRequested{0};
+    std::atomic<uint64_t> m_flushCompleted{0};
+    std::condition_variable m_flushed;
+
+    // Polls Inline sinks that need it (flush intervals, reconnects)
+    std::chrono::milliseconds m_flushInterval;
+    std::thread m_flusher;
 };
+
+// Levels below LOGGER_MIN_LEVEL (0 = Debug ... 3 = Error) compile away
+// entirely: neither the level check nor the arguments are evaluated.
+// Each call site has its own limiter state per Logger; records dropped by
+// the limits do not evaluate the arguments either.
+#ifndef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL 0
+#endif
+
+#define LOGGER_LOG(logger, level, ...) \
+    do { \
+        if constexpr (static_cast<int>(level) >= LOGGER_MIN_LEVEL) { \
+            static LogCallSite loggerSite_(__FILE__, __LINE__); \
+            if ((logger).isEnabled(level) && (logger).admit(loggerSite_, (level))) \
+                (logger).logAdmitted((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(logger, ...)   LOGGER_LOG(logger, LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(logger, ...)    LOGGER_LOG(logger, LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(logger, ...) LOGGER_LOG(logger, LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(logger, ...)   LOGGER_LOG(logger, LogLevel::Error, __VA_ARGS__)
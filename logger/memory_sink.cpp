@@ -0,0 +1,24 @@
+#include "memory_sink.hpp"
+
+MemorySink::MemorySink(size_t capacity) : m_ring(capacity == 0 ? 1 : capacity) {}
+
+void MemorySink::write(const LogRecord& record) {
+    std::string_view text = render(record);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ring[m_total % m_ring.size()].assign(text.data(), text.size());
+    ++m_total;
+}
+
+std::vector<std::string> MemorySink::records() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = m_total < m_ring.size() ? size_t(m_total) : m_ring.size();
+    std::vector<std::string> out;
+    out.reserve(count);
+    for (uint64_t i = m_total - count; i < m_total; ++i) out.push_back(m_ring[i % m_ring.size()]);
+    return out;
+}
+
+uint64_t MemorySink::total() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_total;
+}
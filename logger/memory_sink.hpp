@@ -0,0 +1,28 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sink.hpp"
+
+// The last `capacity` records, e.g. to attach recent context to a crash
+// report or to check output in tests. Slots keep their capacity, so a warm
+// ring does not allocate; records() can be called from any thread.
+class MemorySink : public Sink {
+public:
+    explicit MemorySink(size_t capacity);
+
+    void write(const LogRecord& record) override;
+
+    // Oldest first
+    std::vector<std::string> records() const;
+
+    // Records written since construction, including overwritten ones
+    uint64_t total() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_ring;
+    uint64_t m_total = 0;
+};
@@ -0,0 +1,202 @@
+#include "ring_sink.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File layout: one page of header, then the data area. Records are framed
+// and laid out as one stream that wraps around the data area; head and tail
+// are offsets into that stream (they only grow), so a frame may straddle
+// the end of the area.
+static constexpr char kRingMagic[8] = { 'L', 'G', 'R', 'I', 'N', 'G', '1', '\n' };
+static constexpr size_t kHeaderBytes = 4096;
+static constexpr uint16_t kFrameMarker = 0x4C52;
+
+struct RingHeader {
+    char magic[8];
+    uint64_t capacity;               // bytes of the data area
+    std::atomic<uint64_t> head;      // the oldest record kept
+    std::atomic<uint64_t> tail;      // just past the newest complete record
+    std::atomic<uint64_t> sequence;  // of the next record
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the header is read back from the file");
+
+struct RingFrame {
+    uint32_t length;  // text bytes that follow
+    uint16_t marker;
+    uint8_t level;
+    uint8_t reserved;
+    uint64_t sequence;
+    int64_t timestampNs;
+};
+
+static void copyIn(char* data, uint64_t capacity, uint64_t offset, const void* from, size_t size) {
+    size_t at = size_t(offset % capacity);
+    size_t first = std::min<size_t>(size, capacity - at);
+    std::memcpy(data + at, from, first);
+    std::memcpy(data, static_cast<const char*>(from) + first, size - first);
+}
+
+static void copyOut(const char* data, uint64_t capacity, uint64_t offset, void* to, size_t size) {
+    size_t at = size_t(offset % capacity);
+    size_t first = std::min<size_t>(size, capacity - at);
+    std::memcpy(to, data + at, first);
+    std::memcpy(static_cast<char*>(to) + first, data, size - first);
+}
+
+// Calls visit(frame, textOffset) for the frames in [head, tail); false at
+// the first one that does not check out
+template <typename Visit>
+static bool walkFrames(const char* data, uint64_t capacity, uint64_t head, uint64_t tail, Visit&& visit) {
+    uint64_t offset = head;
+    uint64_t sequence = 0;
+    while (offset != tail) {
+        RingFrame frame;
+        if (tail - offset < sizeof(frame)) return false;
+        copyOut(data, capacity, offset, &frame, sizeof(frame));
+        if (frame.marker != kFrameMarker || frame.length > tail - offset - sizeof(frame) ||
+            frame.level >= uint8_t(LogLevel::Default) || (offset != head && frame.sequence != sequence)) {
+            return false;
+        }
+        visit(frame, offset + sizeof(frame));
+        sequence = frame.sequence + 1;
+        offset += sizeof(frame) + frame.length;
+    }
+    return true;
+}
+
+static bool headerValid(const RingHeader* header, uint64_t capacity) {
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    uint64_t tail = header->tail.load(std::memory_order_acquire);
+    return std::memcmp(header->magic, kRingMagic, sizeof(kRingMagic)) == 0 && header->capacity == capacity &&
+           tail >= head && tail - head <= capacity;
+}
+
+RingSink::RingSink(const std::string& path, size_t capacityBytes) {
+    m_capacity = std::max<uint64_t>(kHeaderBytes, (capacityBytes + kHeaderBytes - 1) / kHeaderBytes * kHeaderBytes);
+    m_mapBytes = kHeaderBytes + m_capacity;
+
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd == -1) return;
+    struct stat st;
+    bool reuse = ::fstat(m_fd, &st) == 0 && uint64_t(st.st_size) == m_mapBytes;
+    // Blocks are allocated up front: a page of a sparse file that cannot be
+    // allocated later would be a SIGBUS in write()
+    if (!reuse && (::ftruncate(m_fd, 0) != 0 || ::posix_fallocate(m_fd, 0, m_mapBytes) != 0)) {
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    void* map = ::mmap(nullptr, m_mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    m_map = static_cast<char*>(map);
+    m_header = reinterpret_cast<RingHeader*>(m_map);
+    m_data = m_map + kHeaderBytes;
+
+    // A ring from an earlier run is continued only if it checks out
+    if (!reuse || !headerValid(m_header, m_capacity) ||
+        !walkFrames(m_data, m_capacity, m_header->head.load(), m_header->tail.load(),
+                    [](const RingFrame&, uint64_t) {})) {
+        reset();
+    }
+}
+
+RingSink::~RingSink() {
+    if (m_map) ::munmap(m_map, m_mapBytes);
+    if (m_fd != -1) ::close(m_fd);
+}
+
+void RingSink::reset() {
+    std::memset(m_map, 0, kHeaderBytes);
+    m_header->capacity = m_capacity;
+    m_header->head.store(0);
+    m_header->tail.store(0);
+    m_header->sequence.store(0);
+    std::memcpy(m_header->magic, kRingMagic, sizeof(kRingMagic));  // last: a torn reset is not a ring
+}
+
+void RingSink::write(const LogRecord& record) {
+    if (!m_map) return;
+    std::string_view text = render(record);
+    text = text.substr(0, m_capacity / 2 - sizeof(RingFrame));
+    uint64_t need = sizeof(RingFrame) + text.size();
+    uint64_t head = m_header->head.load(std::memory_order_relaxed);
+    uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+
+    // The oldest records go first, and head moves before their bytes are
+    // reused: [head, tail) is whole at every instant the process may die
+    if (tail + need - head > m_capacity) {
+        while (tail + need - head > m_capacity) {
+            RingFrame oldest;
+            copyOut(m_data, m_capacity, head, &oldest, sizeof(oldest));
+            head += sizeof(oldest) + oldest.length;
+        }
+        m_header->head.store(head, std::memory_order_release);
+    }
+
+    uint64_t sequence = m_header->sequence.load(std::memory_order_relaxed);
+    RingFrame frame{ uint32_t(text.size()), kFrameMarker, uint8_t(record.level), 0, sequence, record.timestampNs };
+    copyIn(m_data, m_capacity, tail, &frame, sizeof(frame));
+    copyIn(m_data, m_capacity, tail + sizeof(frame), text.data(), text.size());
+    m_header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    m_header->tail.store(tail + need, std::memory_order_release);
+}
+
+void RingSink::flush() {
+    if (m_map) ::msync(m_map, m_mapBytes, MS_SYNC);
+}
+
+bool readRingFile(const std::string& path, RingContents& out, std::string& error) {
+    out = RingContents();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        error = std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || uint64_t(st.st_size) <= kHeaderBytes) {
+        ::close(fd);
+        error = "not a ring file";
+        return false;
+    }
+    size_t size = size_t(st.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = std::strerror(errno);
+        return false;
+    }
+
+    const char* base = static_cast<const char*>(map);
+    const RingHeader* header = reinterpret_cast<const RingHeader*>(base);
+    uint64_t capacity = size - kHeaderBytes;
+    if (!headerValid(header, capacity)) {
+        ::munmap(map, size);
+        error = std::memcmp(header->magic, kRingMagic, sizeof(kRingMagic)) == 0 ? "damaged header" : "not a ring file";
+        return false;
+    }
+
+    const char* data = base + kHeaderBytes;
+    out.damaged = !walkFrames(data, capacity, header->head.load(), header->tail.load(),
+                              [&](const RingFrame& frame, uint64_t textOffset) {
+        RingRecord record;
+        record.sequence = frame.sequence;
+        record.timestampNs = frame.timestampNs;
+        record.level = LogLevel(frame.level);
+        record.text.resize(frame.length);
+        copyOut(data, capacity, textOffset, &record.text[0], frame.length);
+        out.records.push_back(std::move(record));
+    });
+    out.overwritten = out.records.empty() ? header->sequence.load() : out.records.front().sequence;
+    ::munmap(map, size);
+    return true;
+}
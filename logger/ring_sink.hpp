@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sink.hpp"
+
+struct RingHeader;
+
+// The newest records in a fixed-size memory-mapped file used as a circular
+// buffer. A write is a memcpy into the mapping plus a few 8-byte stores to
+// the header; no system calls. The pages belong to the kernel, so what was
+// written survives the process dying in any way (SIGSEGV, SIGKILL, abort);
+// log_recover reads it back. Only the machine going down can lose it, unless
+// flush() (msync) ran.
+//
+// An existing ring of the same size is continued, not cleared. Keep the sink
+// Inline: records waiting in the async queue die with the process.
+class RingSink : public Sink {
+public:
+    RingSink(const std::string& path, size_t capacityBytes);
+    ~RingSink() override;
+
+    RingSink(const RingSink&) = delete;
+    RingSink& operator=(const RingSink&) = delete;
+
+    bool isOpen() const { return m_map != nullptr; }
+
+    // Records longer than half the ring are cut
+    void write(const LogRecord& record) override;
+
+    // Writes the mapped pages to disk
+    void flush() override;
+
+private:
+    void reset();
+
+    int m_fd = -1;
+    char* m_map = nullptr;
+    size_t m_mapBytes = 0;
+    RingHeader* m_header = nullptr;
+    char* m_data = nullptr;
+    uint64_t m_capacity = 0;
+};
+
+struct RingRecord {
+    uint64_t sequence = 0;   // counts every record written to the file
+    int64_t timestampNs = 0;
+    LogLevel level = LogLevel::Info;
+    std::string text;        // as the sink rendered it, normally one line
+};
+
+struct RingContents {
+    std::vector<RingRecord> records;  // oldest first
+    uint64_t overwritten = 0;         // older records the ring no longer holds
+    bool damaged = false;             // a bad frame ended the walk early
+};
+
+// Reads a ring file, e.g. one left behind by a crashed process. Returns false
+// with a reason when the file is not a ring.
+bool readRingFile(const std::string& path, RingContents& out, std::string& error);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+enum class LogLevel {
+    Debug = 0,
+    Info,
+    Warning,
+    Error,
+    Default
+};
+
+inline constexpr std::string_view kLevelNames[] = { "Debug", "Info", "Warning", "Error" };
+
+constexpr std::string_view levelName(LogLevel level) {
+    return level < LogLevel::Default ? kLevelNames[static_cast<int>(level)] : "Unknown";
+}
+
+// A record as Logger formats it, once, for every sink
+struct LogRecord {
+    LogLevel level = LogLevel::Info;
+    int64_t timestampNs = 0;
+    std::string_view line;       // "<timestamp> [<Level>] <message>[ key=value...]\n"
+    size_t messageOffset = 0;    // where the message starts inside line
+    size_t fieldsOffset = 0;     // where the " key=value" text (or the '\n') starts
+    std::string_view fields;     // encoded fields, see log_fields.hpp
+
+    std::string_view message() const {
+        return line.substr(messageOffset, fieldsOffset - messageOffset);
+    }
+
+    // The message followed by its fields as text
+    std::string_view text() const {
+        return line.substr(messageOffset, line.size() - messageOffset - 1);
+    }
+};
+
+// Writes a record the way a sink wants it; the output must end with '\n'
+using Formatter = std::function<void(std::string& out, const LogRecord& record)>;
+
+enum class SinkMode {
+    Inline,  // written by the thread calling log()
+    Async    // written by Logger's background writer (see AsyncOptions)
+};
+
+// Destination of log records. Logger calls write() for every record at or
+// above the sink's level, then commit() once per record (Inline) or per
+// batch (Async); calls on one sink are never concurrent.
+//
+// Mode and formatter are read when the sink is handed to a Logger; the
+// level can be changed at any time.
+class Sink {
+public:
+    virtual ~Sink() = default;
+
+    void setLevel(LogLevel level) { m_level.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return m_level.load(std::memory_order_relaxed); }
+    bool accepts(LogLevel level) const { return level >= this->level(); }
+
+    void setMode(SinkMode mode) { m_mode = mode; }
+    SinkMode mode() const { return m_mode; }
+
+    // Without a formatter the shared line is written as is, without a copy
+    void setFormatter(Formatter formatter) { m_formatter = std::move(formatter); }
+
+    virtual void write(const LogRecord& record) = 0;
+
+    // End of a record or batch
+    virtual void commit() {}
+
+    // Everything written so far leaves the process
+    virtual void flush() {}
+
+    // Time-based work (flush intervals, reconnects), called periodically
+    // when needsPoll() is true
+    virtual void poll(std::chrono::steady_clock::time_point now) { (void)now; }
+    virtual bool needsPoll() const { return false; }
+
+protected:
+    // The bytes to write for a record: the shared line, or the formatter's
+    // output in a buffer reused across records
+    std::string_view render(const LogRecord& record) {
+        if (!m_formatter) return record.line;
+        m_scratch.clear();
+        m_formatter(m_scratch, record);
+        return m_scratch;
+    }
+
+private:
+    std::atomic<LogLevel> m_level{LogLevel::Debug};
+    SinkMode m_mode = SinkMode::Inline;
+    Formatter m_formatter;
+    std::string m_scratch;
+};
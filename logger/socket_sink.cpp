@@ -0,0 +1,560 @@
+#include "socket_sink.hpp"
+#include "wire_protocol.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+// First line of a spool file: replaying it only makes sense in the same format
+static std::string_view spoolHeader(bool binary) {
+    return binary ? "#LGSPOOL binary\n" : "#LGSPOOL text\n";
+}
+
+static constexpr size_t kSpoolChunk = 64 * 1024;
+static constexpr size_t kBatchBytes = 64 * 1024;
+static constexpr auto kHandshakeTimeout = std::chrono::milliseconds(500);
+static constexpr auto kPeerCheckPeriod = std::chrono::milliseconds(50);
+
+SocketSink::SocketSink(const std::string& host, int port, const SocketOptions& options)
+    : m_options(options), m_backoff(options.reconnectMin)
+{
+    m_address.sin_family = AF_INET;
+    m_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &m_address.sin_addr) <= 0) {
+        throw std::invalid_argument("Invalid IP address: '" + host + "'");
+    }
+    if (m_options.reconnectMin.count() <= 0) m_options.reconnectMin = std::chrono::milliseconds(1);
+    if (m_options.reconnectMax < m_options.reconnectMin) m_options.reconnectMax = m_options.reconnectMin;
+    m_backoff = m_options.reconnectMin;
+    m_sourceId = options.sourceId != 0 ? options.sourceId : uint32_t(getpid());
+    m_batch.reserve(kBatchBytes);
+
+    if (!start()) {
+        std::cout << "Log server unavailable, records are queued until it is reachable" << std::endl;
+    } else if (options.wire == WireFormat::Binary && !m_binary) {
+        std::cout << "Server does not support the binary wire format, sending text" << std::endl;
+    }
+}
+
+SocketSink::~SocketSink() {
+    commit();
+    // Give a live connection a moment to take the backlog; the rest is
+    // spooled, if a spool is configured
+    if (m_state == State::Connected) drain(Clock::now() + m_options.connectTimeout);
+    persistQueue();
+    if (m_fd != -1) ::close(m_fd);
+    if (m_spoolFd != -1) ::close(m_spoolFd);
+}
+
+bool SocketSink::start() {
+    auto now = Clock::now();
+    startConnect(now);
+
+    // Wait for the connection here (only this once), so the wire format is
+    // known before the first record is encoded
+    while (m_state == State::Connecting) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - Clock::now());
+        pollfd pfd{ m_fd, POLLOUT, 0 };
+        if (left.count() <= 0 || ::poll(&pfd, 1, int(left.count())) <= 0) {
+            connectionFailed(Clock::now());
+            break;
+        }
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            errno = error;
+            connectionFailed(Clock::now());
+            break;
+        }
+        onConnected(Clock::now());
+    }
+
+    if (m_state == State::Negotiating) {
+        while (m_state == State::Negotiating) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - Clock::now());
+            pollfd pfd{ m_fd, POLLIN, 0 };
+            if (left.count() <= 0 || ::poll(&pfd, 1, int(left.count())) <= 0) break;
+            if (!readHandshake()) break;
+        }
+        if (m_state == State::Negotiating) {
+            // A server without binary support: stay connected, send text
+            m_binary = false;
+            m_state = State::Connected;
+        }
+    }
+
+    m_started = true;
+    if (!m_options.spoolPath.empty()) openSpool();
+    m_connected = m_state == State::Connected;
+    return m_state == State::Connected;
+}
+
+void SocketSink::write(const LogRecord& record) {
+    if (!m_binary) {
+        m_batch.append(render(record));
+    } else {
+        wire::Record frame;
+        frame.timestampNs = record.timestampNs;
+        frame.level = uint8_t(record.level);
+        frame.sourceId = m_sourceId;
+        // Cut like a runaway text line: a longer frame is invalid to the
+        // server, which would drop the connection and the records after it
+        frame.message = record.text().substr(0, wire::kMaxMessage);
+        wire::appendFrame(m_batch, frame);
+    }
+    ++m_batchRecords;
+    // Send early rather than grow the batch buffer
+    if (m_batch.size() >= kBatchBytes) commit();
+}
+
+void SocketSink::commit() {
+    if (m_batch.empty()) return;
+    sendRecords(m_batch.data(), m_batch.size(), m_batchRecords);
+    m_batch.clear();
+    m_batchRecords = 0;
+}
+
+void SocketSink::flush() {
+    commit();
+    poll(Clock::now());
+}
+
+void SocketSink::sendRecords(const char* data, size_t size, size_t records) {
+    if (m_state == State::Connected && m_queue.empty() && m_spoolWrite == m_spoolRead) {
+        size_t sent = sendSome(data, size);
+        if (sent == size) {
+            m_sent.fetch_add(records, std::memory_order_relaxed);
+            return;
+        }
+        enqueue(data, size, records, sent);
+        return;
+    }
+
+    enqueue(data, size, records, 0);
+    if (m_state != State::Connected) {
+        poll(Clock::now());
+    } else {
+        sendQueued();
+    }
+}
+
+void SocketSink::poll(Clock::time_point now) {
+    switch (m_state) {
+    case State::Disconnected:
+        if (now >= m_retryAt) startConnect(now);
+        break;
+
+    case State::Connecting: {
+        pollfd pfd{ m_fd, POLLOUT, 0 };
+        if (::poll(&pfd, 1, 0) > 0) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error == 0) {
+                onConnected(now);
+            } else {
+                connectionFailed(now);
+            }
+        } else if (now >= m_deadline) {
+            connectionFailed(now);
+        }
+        break;
+    }
+
+    case State::Negotiating:
+        if (!readHandshake() || (m_state == State::Negotiating && now >= m_deadline)) {
+            // This connection cannot carry the format already in use
+            connectionFailed(now);
+        } else if (m_state == State::Connected) {
+            sendQueued();
+        }
+        break;
+
+    case State::Connected:
+        if (now >= m_nextPeerCheck) {
+            m_nextPeerCheck = now + kPeerCheckPeriod;
+            if (peerClosed()) {
+                connectionFailed(now);
+                break;
+            }
+        }
+        sendQueued();
+        break;
+    }
+}
+
+void SocketSink::drain(Clock::time_point deadline) {
+    for (;;) {
+        auto now = Clock::now();
+        poll(now);
+        if (m_state == State::Connected && m_queue.empty() && m_spoolWrite == m_spoolRead) return;
+        if (now >= deadline) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+SocketCounters SocketSink::counters() const {
+    SocketCounters out;
+    out.connected = m_connected.load(std::memory_order_relaxed);
+    out.queued = m_queuedRecords.load(std::memory_order_relaxed);
+    out.spoolBytes = m_spoolBytes.load(std::memory_order_relaxed);
+    out.sent = m_sent.load(std::memory_order_relaxed);
+    out.dropped = m_dropped.load(std::memory_order_relaxed);
+    out.reconnects = m_reconnects.load(std::memory_order_relaxed);
+    return out;
+}
+
+// Bytes the kernel took; a broken connection is closed on the way
+size_t SocketSink::sendSome(const char* data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = ::send(m_fd, data + sent, size - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            sent += size_t(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        connectionFailed(Clock::now());
+        break;
+    }
+    return sent;
+}
+
+void SocketSink::enqueue(const char* data, size_t size, size_t records, size_t sent) {
+    // A record partly sent over a live connection has to stay at the head
+    bool spooling = m_spoolWrite != m_spoolRead;
+    if (sent == 0 && (spooling || m_queuedBytes + size > m_options.queueBytes)) {
+        if (m_spoolFd != -1) {
+            appendSpool(data, size, records);
+        } else {
+            m_dropped.fetch_add(records, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    Pending pending;
+    pending.bytes.assign(data, size);
+    pending.records = records;
+    pending.sent = m_state == State::Connected ? sent : resumePoint(pending.bytes, sent);
+    m_queuedBytes += size;
+    m_queuedRecords.fetch_add(records, std::memory_order_relaxed);
+    m_queue.push_back(std::move(pending));
+}
+
+// Sends from the head of the queue, refilling it from the spool; returns
+// true once both are empty
+bool SocketSink::sendQueued() {
+    while (m_state == State::Connected) {
+        if (m_queue.empty() && !loadFromSpool()) return true;
+
+        Pending& head = m_queue.front();
+        head.sent += sendSome(head.bytes.data() + head.sent, head.bytes.size() - head.sent);
+        if (head.sent < head.bytes.size()) {
+            if (m_state != State::Connected) head.sent = resumePoint(head.bytes, head.sent);
+            return false;
+        }
+        m_sent.fetch_add(head.records, std::memory_order_relaxed);
+        m_queuedRecords.fetch_sub(head.records, std::memory_order_relaxed);
+        m_queuedBytes -= head.bytes.size();
+        m_queue.pop_front();
+    }
+    return false;
+}
+
+void SocketSink::startConnect(Clock::time_point now) {
+    m_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd == -1) {
+        connectionFailed(now);
+        return;
+    }
+    int one = 1;
+    if (m_options.noDelay) setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (m_options.sendBufferBytes > 0) {
+        setsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &m_options.sendBufferBytes, sizeof(m_options.sendBufferBytes));
+    }
+
+    if (::connect(m_fd, (sockaddr*)&m_address, sizeof(m_address)) == 0) {
+        onConnected(now);
+    } else if (errno == EINPROGRESS) {
+        m_state = State::Connecting;
+        m_deadline = now + m_options.connectTimeout;
+    } else {
+        connectionFailed(now);
+    }
+}
+
+void SocketSink::connectionFailed(Clock::time_point now) {
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    if (m_state == State::Connected && !m_queue.empty()) {
+        Pending& head = m_queue.front();
+        head.sent = resumePoint(head.bytes, head.sent);
+    }
+    m_state = State::Disconnected;
+    m_connected = false;
+    m_retryAt = now + m_backoff;
+    m_backoff = std::min(m_backoff * 2, m_options.reconnectMax);
+}
+
+void SocketSink::onConnected(Clock::time_point now) {
+    if (m_everConnected) m_reconnects.fetch_add(1, std::memory_order_relaxed);
+    m_everConnected = true;
+    m_nextPeerCheck = now + kPeerCheckPeriod;
+
+    // The first connection asks for the configured format; later ones must
+    // get the format queued records were encoded in
+    bool negotiate = m_started ? m_binary : m_options.wire == WireFormat::Binary;
+    if (!negotiate) {
+        m_state = State::Connected;
+        m_connected = true;
+        m_backoff = m_options.reconnectMin;
+        return;
+    }
+
+    m_state = State::Connected;  // lets sendSome report a broken connection
+    size_t sent = sendSome(wire::kHelloBinary.data(), wire::kHelloBinary.size());
+    if (m_state != State::Connected) return;
+    if (sent != wire::kHelloBinary.size()) {
+        connectionFailed(now);
+        return;
+    }
+    m_state = State::Negotiating;
+    m_deadline = now + kHandshakeTimeout;
+    m_handshake.clear();
+}
+
+// Reads what the server sent so far, looking for the accept line; records
+// relayed from other producers may come first and are skipped. Returns
+// false when the connection closed.
+bool SocketSink::readHandshake() {
+    char buffer[512];
+    for (;;) {
+        ssize_t n = ::recv(m_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buffer[i] != '\n') {
+                if (m_handshake.size() < 256) m_handshake.push_back(buffer[i]);
+                continue;
+            }
+            m_handshake.push_back('\n');
+            if (m_handshake == wire::kHelloAccept) {
+                // Anything after the accept line is relayed traffic we do not read
+                m_binary = true;
+                m_state = State::Connected;
+                m_connected = true;
+                m_backoff = m_options.reconnectMin;
+                return true;
+            }
+            m_handshake.clear();
+        }
+    }
+}
+
+// Discards whatever the server relays to us and reports whether it hung up;
+// without this a restart is only noticed after a send fails, and whatever
+// was sent in between is lost
+bool SocketSink::peerClosed() {
+    char buffer[4096];
+    for (int i = 0; i < 64; ++i) {
+        ssize_t n = ::recv(m_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n > 0) continue;
+        if (n == 0) return true;
+        if (errno == EINTR) continue;
+        return errno != EAGAIN && errno != EWOULDBLOCK;
+    }
+    return false;
+}
+
+// Where to resend from after a connection broke in the middle of a unit:
+// the start of the first record not handed to the kernel in full
+size_t SocketSink::resumePoint(const std::string& bytes, size_t sent) const {
+    if (sent == 0) return 0;
+    if (!m_binary) {
+        const void* newline = memrchr(bytes.data(), '\n', sent);
+        return newline == nullptr ? 0 : static_cast<const char*>(newline) - bytes.data() + 1;
+    }
+    size_t offset = 0;
+    for (;;) {
+        size_t frame = wire::completeFrame(bytes.data() + offset, sent - offset);
+        if (frame == 0 || frame == SIZE_MAX) return offset;
+        offset += frame;
+    }
+}
+
+size_t SocketSink::countRecords(const char* data, size_t size) const {
+    if (!m_binary) return size_t(std::count(data, data + size, '\n'));
+    size_t records = 0;
+    size_t offset = 0;
+    for (;;) {
+        size_t frame = wire::completeFrame(data + offset, size - offset);
+        if (frame == 0 || frame == SIZE_MAX) return records;
+        offset += frame;
+        ++records;
+    }
+}
+
+void SocketSink::openSpool() {
+    const std::string& path = m_options.spoolPath;
+    m_spoolFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_spoolFd == -1) {
+        perror("log spool open failed");
+        return;
+    }
+
+    struct stat st;
+    if (::fstat(m_spoolFd, &st) != 0 || st.st_size == 0) return;
+
+    // Records left by a previous run are replayed first
+    std::string_view header = spoolHeader(m_binary);
+    char first[32] = {};
+    ssize_t n = ::pread(m_spoolFd, first, header.size(), 0);
+    if (n == ssize_t(header.size()) && header == std::string_view(first, header.size())) {
+        m_spoolRead = header.size();
+        m_spoolWrite = uint64_t(st.st_size);
+        m_spoolBytes = m_spoolWrite - m_spoolRead;
+        return;
+    }
+
+    fprintf(stderr, "logger: %s holds records in another wire format, moved aside\n", path.c_str());
+    ::close(m_spoolFd);
+    ::rename(path.c_str(), (path + ".orphaned").c_str());
+    m_spoolFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+static bool writeAt(int fd, const char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, off_t(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= size_t(n);
+        offset += uint64_t(n);
+    }
+    return true;
+}
+
+void SocketSink::appendSpool(const char* data, size_t size, size_t records) {
+    if (m_spoolWrite == 0) {
+        std::string_view header = spoolHeader(m_binary);
+        if (!writeAt(m_spoolFd, header.data(), header.size(), 0)) {
+            perror("log spool write failed");
+            m_dropped.fetch_add(records, std::memory_order_relaxed);
+            return;
+        }
+        m_spoolRead = m_spoolWrite = header.size();
+    }
+    if (!writeAt(m_spoolFd, data, size, m_spoolWrite)) {
+        perror("log spool write failed");
+        m_dropped.fetch_add(records, std::memory_order_relaxed);
+        return;
+    }
+    m_spoolWrite += size;
+    m_spoolBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+// Moves the next whole records from the spool into the memory queue
+bool SocketSink::loadFromSpool() {
+    if (m_spoolRead == m_spoolWrite) {
+        if (m_spoolWrite != 0) {
+            // Drained: start the file over
+            if (::ftruncate(m_spoolFd, 0) != 0) perror("log spool truncate failed");
+            m_spoolRead = m_spoolWrite = 0;
+        }
+        return false;
+    }
+
+    Pending pending;
+    size_t want = kSpoolChunk;
+    for (;;) {
+        size_t size = size_t(std::min<uint64_t>(want, m_spoolWrite - m_spoolRead));
+        pending.bytes.resize(size);
+        ssize_t n = ::pread(m_spoolFd, &pending.bytes[0], size, off_t(m_spoolRead));
+        if (n != ssize_t(size)) {
+            perror("log spool read failed");
+            m_spoolRead = m_spoolWrite;  // give up on the rest
+            m_spoolBytes = 0;
+            return false;
+        }
+        size_t whole = resumePoint(pending.bytes, size);
+        if (whole == 0 && m_spoolRead + size < m_spoolWrite) {
+            want *= 2;  // a record longer than the chunk
+            continue;
+        }
+        if (whole == 0) whole = size;  // trailing partial record, send as is
+        pending.bytes.resize(whole);
+        break;
+    }
+
+    pending.records = countRecords(pending.bytes.data(), pending.bytes.size());
+    m_spoolRead += pending.bytes.size();
+    m_spoolBytes.fetch_sub(pending.bytes.size(), std::memory_order_relaxed);
+    m_queuedBytes += pending.bytes.size();
+    m_queuedRecords.fetch_add(pending.records, std::memory_order_relaxed);
+    m_queue.push_back(std::move(pending));
+    return true;
+}
+
+// At shutdown, unsent records from memory go into the spool ahead of what
+// is already there, so the next run replays everything in order
+void SocketSink::persistQueue() {
+    if (m_queue.empty()) return;
+    if (m_spoolFd == -1) {
+        m_dropped.fetch_add(m_queuedRecords.load(), std::memory_order_relaxed);
+        return;
+    }
+
+    const std::string& path = m_options.spoolPath;
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        perror("log spool rewrite failed");
+        return;
+    }
+
+    std::string_view header = spoolHeader(m_binary);
+    uint64_t offset = 0;
+    bool ok = writeAt(fd, header.data(), header.size(), offset);
+    offset += header.size();
+    for (const Pending& pending : m_queue) {
+        size_t from = resumePoint(pending.bytes, pending.sent);
+        ok = ok && writeAt(fd, pending.bytes.data() + from, pending.bytes.size() - from, offset);
+        offset += pending.bytes.size() - from;
+    }
+    std::string chunk(kSpoolChunk, '\0');
+    for (uint64_t at = m_spoolRead; ok && at < m_spoolWrite;) {
+        size_t size = size_t(std::min<uint64_t>(kSpoolChunk, m_spoolWrite - at));
+        ok = ::pread(m_spoolFd, &chunk[0], size, off_t(at)) == ssize_t(size) &&
+             writeAt(fd, chunk.data(), size, offset);
+        at += size;
+        offset += size;
+    }
+    ::close(fd);
+
+    if (ok && ::rename(temporary.c_str(), path.c_str()) == 0) {
+        m_queue.clear();
+    } else {
+        perror("log spool rewrite failed");
+        ::unlink(temporary.c_str());
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <netinet/in.h>
+
+#include "sink.hpp"
+
+// Encoding of records sent to the socket (see wire_protocol.hpp)
+enum class WireFormat {
+    Text,
+    Binary   // negotiated on the first connection, falls back to Text
+};
+
+struct SocketOptions {
+    WireFormat wire = WireFormat::Text;
+    uint32_t sourceId = 0;                          // carried in binary frames, 0 = process id
+
+    size_t queueBytes = 4 * 1024 * 1024;            // unsent records kept in memory
+    std::string spoolPath;                          // overflow goes here instead of being dropped, "" = off
+    std::chrono::milliseconds connectTimeout{1000};
+    std::chrono::milliseconds reconnectMin{100};    // backoff doubles from min up to max
+    std::chrono::milliseconds reconnectMax{10000};
+    bool noDelay = false;                           // TCP_NODELAY
+    int sendBufferBytes = 0;                        // SO_SNDBUF, 0 = system default
+};
+
+struct SocketCounters {
+    bool connected = false;
+    uint64_t queued = 0;        // records waiting in memory
+    uint64_t spoolBytes = 0;    // bytes waiting in the spool file
+    uint64_t sent = 0;          // records handed to the kernel
+    uint64_t dropped = 0;       // records lost to a full queue (no spool)
+    uint64_t reconnects = 0;
+};
+
+// Connection to the log server that survives server restarts. Sends never
+// block and never raise SIGPIPE: what the kernel does not take is queued
+// (up to queueBytes, then spooled to disk or dropped) and replayed after a
+// non-blocking reconnect with exponential backoff.
+//
+// Records are encoded into a batch sent on commit(): binary frames when
+// negotiated, otherwise the text line (or the formatter's output).
+//
+// Not thread-safe: Logger serializes access (its mutex in sync mode, the
+// writer thread in async). Counters can be read from any thread.
+class SocketSink : public Sink {
+public:
+    // Makes the first connection, waiting up to connectTimeout, which fixes
+    // the wire format for the sink's lifetime; an unreachable server is not
+    // an error (records are queued until it is up). Throws
+    // std::invalid_argument for an unparsable address.
+    SocketSink(const std::string& host, int port, const SocketOptions& options);
+    ~SocketSink() override;
+
+    SocketSink(const SocketSink&) = delete;
+    SocketSink& operator=(const SocketSink&) = delete;
+
+    bool binary() const { return m_binary; }
+
+    void write(const LogRecord& record) override;
+    void commit() override;
+    void flush() override;
+
+    // Advances reconnects and replays queued records
+    void poll(std::chrono::steady_clock::time_point now) override;
+    bool needsPoll() const override { return true; }
+
+    // Keeps polling until everything queued is sent or the deadline passes
+    void drain(std::chrono::steady_clock::time_point deadline);
+
+    SocketCounters counters() const;
+
+private:
+    enum class State { Disconnected, Connecting, Negotiating, Connected };
+
+    struct Pending {
+        std::string bytes;
+        size_t records = 0;
+        size_t sent = 0;  // bytes of this unit already handed to the kernel
+    };
+
+    bool start();
+    // One or more complete records in the negotiated format
+    void sendRecords(const char* data, size_t size, size_t records);
+    size_t sendSome(const char* data, size_t size);
+    void enqueue(const char* data, size_t size, size_t records, size_t sent);
+    bool sendQueued();
+    void startConnect(std::chrono::steady_clock::time_point now);
+    void connectionFailed(std::chrono::steady_clock::time_point now);
+    void onConnected(std::chrono::steady_clock::time_point now);
+    bool readHandshake();
+    bool peerClosed();
+    size_t resumePoint(const std::string& bytes, size_t sent) const;
+    size_t countRecords(const char* data, size_t size) const;
+
+    void openSpool();
+    void appendSpool(const char* data, size_t size, size_t records);
+    bool loadFromSpool();
+    void persistQueue();
+
+    sockaddr_in m_address{};
+    SocketOptions m_options;
+    bool m_binary = false;
+    uint32_t m_sourceId = 0;
+
+    std::string m_batch;  // records encoded since the last commit
+    size_t m_batchRecords = 0;
+
+    int m_fd = -1;
+    State m_state = State::Disconnected;
+    std::chrono::steady_clock::time_point m_deadline;   // connect or handshake timeout
+    std::chrono::steady_clock::time_point m_retryAt;
+    std::chrono::milliseconds m_backoff;
+    std::chrono::steady_clock::time_point m_nextPeerCheck;
+    std::string m_handshake;
+    bool m_everConnected = false;
+    bool m_started = false;
+
+    std::deque<Pending> m_queue;
+    size_t m_queuedBytes = 0;
+
+    // Spool file: [m_spoolRead, m_spoolWrite) holds records not yet replayed;
+    // while it is non-empty every new record goes there, to keep the order
+    int m_spoolFd = -1;
+    uint64_t m_spoolRead = 0;
+    uint64_t m_spoolWrite = 0;
+
+    std::atomic<bool> m_connected{false};
+    std::atomic<uint64_t> m_queuedRecords{0};
+    std::atomic<uint64_t> m_spoolBytes{0};
+    std::atomic<uint64_t> m_sent{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_reconnects{0};
+};
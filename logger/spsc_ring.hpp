@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded single-producer single-consumer ring. Each side owns its index on
+// its own cache line and keeps a private copy of the other side's, so a push
+// or a pop reads the other line only when the ring looks full or empty.
+// Values are filled and consumed in place, as in BoundedQueue.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        m_mask = size - 1;
+        m_slots.reset(new Slot[size]);
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // Producer only: calls fill(T&) on the next free slot. Returns false when full.
+    template <typename Fill>
+    bool tryPush(Fill&& fill) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead > m_mask) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead > m_mask) return false;
+        }
+        fill(m_slots[tail & m_mask].value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only: the oldest value, or nullptr when empty
+    T* front() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail) return nullptr;
+        }
+        return &m_slots[head & m_mask].value;
+    }
+
+    // Consumer only: releases the value returned by front()
+    void pop() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_tail{0};
+    size_t m_cachedHead = 0;  // producer's copy of m_head
+    alignas(64) std::atomic<size_t> m_head{0};
+    size_t m_cachedTail = 0;  // consumer's copy of m_tail
+};
@@ -0,0 +1,27 @@
+#include "stdout_sink.hpp"
+
+#include <cerrno>
+#include <unistd.h>
+
+StdoutSink::StdoutSink(int fd) : m_fd(fd) {}
+
+StdoutSink::~StdoutSink() {
+    commit();
+}
+
+void StdoutSink::write(const LogRecord& record) {
+    m_buffer.append(render(record));
+}
+
+void StdoutSink::commit() {
+    const char* data = m_buffer.data();
+    size_t left = m_buffer.size();
+    while (left > 0) {
+        ssize_t n = ::write(m_fd, data, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;  // a closed terminal or pipe: nothing to do about it
+        data += n;
+        left -= size_t(n);
+    }
+    m_buffer.clear();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+#include "sink.hpp"
+
+// Standard output (or any already open descriptor, e.g. 2 for stderr).
+// Records are collected per commit and written with one write().
+class StdoutSink : public Sink {
+public:
+    explicit StdoutSink(int fd = 1);
+    ~StdoutSink() override;
+
+    void write(const LogRecord& record) override;
+    void commit() override;
+    void flush() override { commit(); }
+
+private:
+    int m_fd;
+    std::string m_buffer;
+};
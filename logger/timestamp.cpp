@@ -0,0 +1,68 @@
+#include "timestamp.hpp"
+
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+constexpr size_t kPrefixLength = 19;  // "YYYY-MM-DD HH:MM:SS"
+
+struct SecondCache {
+    std::time_t second = -1;
+    char prefix[kPrefixLength + 1];
+};
+
+// [0] local time, [1] UTC
+thread_local SecondCache t_cache[2];
+
+void formatSecond(std::time_t t, bool utc, char* out) {
+    std::tm tm{};
+#ifdef _WIN32
+    if (utc) gmtime_s(&tm, &t);
+    else localtime_s(&tm, &t);
+#else
+    if (utc) gmtime_r(&t, &tm);
+    else localtime_r(&t, &tm);
+#endif
+    std::strftime(out, kPrefixLength + 1, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+void writeDigits(char* out, unsigned value, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+        out[i] = char('0' + value % 10);
+        value /= 10;
+    }
+}
+
+}
+
+size_t formatTimestamp(std::chrono::system_clock::time_point tp,
+                       const TimestampOptions& options, char* out) {
+    using namespace std::chrono;
+
+    auto sinceEpoch = duration_cast<microseconds>(tp.time_since_epoch());
+    auto secs = duration_cast<seconds>(sinceEpoch);
+    if (sinceEpoch < secs) secs -= seconds(1);  // floor for pre-1970 times
+    unsigned micros = static_cast<unsigned>((sinceEpoch - secs).count());
+
+    SecondCache& cache = t_cache[options.utc ? 1 : 0];
+    std::time_t second = static_cast<std::time_t>(secs.count());
+    if (cache.second != second) {
+        formatSecond(second, options.utc, cache.prefix);
+        cache.second = second;
+    }
+    std::memcpy(out, cache.prefix, kPrefixLength);
+
+    switch (options.precision) {
+    case TimestampPrecision::Milliseconds:
+        out[kPrefixLength] = '.';
+        writeDigits(out + kPrefixLength + 1, micros / 1000, 3);
+        return kPrefixLength + 4;
+    case TimestampPrecision::Microseconds:
+        out[kPrefixLength] = '.';
+        writeDigits(out + kPrefixLength + 1, micros, 6);
+        return kPrefixLength + 7;
+    default:
+        return kPrefixLength;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+enum class TimestampPrecision {
+    Seconds,
+    Milliseconds,
+    Microseconds
+};
+
+struct TimestampOptions {
+    TimestampPrecision precision = TimestampPrecision::Seconds;
+    bool utc = false;  // local time by default
+};
+
+// Longest output of formatTimestamp: "YYYY-MM-DD HH:MM:SS.uuuuuu"
+constexpr size_t kMaxTimestampLength = 26;
+
+// Writes "YYYY-MM-DD HH:MM:SS[.mmm|.uuuuuu]" into out (no terminating NUL)
+// and returns its length. The date/time prefix is cached per thread for the
+// current second, so the calendar conversion runs once a second at most.
+size_t formatTimestamp(std::chrono::system_clock::time_point tp,
+                       const TimestampOptions& options, char* out);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Optional binary record format shared by Logger's socket output,
+// log_server and log_stats. Text lines remain the default and the fallback.
+//
+// Negotiation: right after connecting, a client that wants binary sends
+// kHelloBinary (an ordinary text line, so servers that do not know the
+// protocol just relay it and log_stats ignores it). A server that speaks
+// binary answers with kHelloAccept and from then on both directions of that
+// connection carry frames instead of lines.
+//
+// Frame layout, little-endian:
+//   u32  length of everything after this field
+//   u64  timestamp, nanoseconds since the Unix epoch
+//   u8   level (LogLevel value, or kLevelText)
+//   u32  source id
+//   ...  message bytes (no trailing newline)
+namespace wire {
+
+inline constexpr std::string_view kHelloBinary = "#LGWP/1 binary\n";
+inline constexpr std::string_view kHelloAccept = "#LGWP/1 ok\n";
+
+// Level of a frame that wraps a complete text line (timestamp and level
+// inside the message), used when relaying text producers to binary readers
+inline constexpr uint8_t kLevelText = 0xFF;
+
+inline constexpr size_t kLengthSize = 4;
+inline constexpr size_t kHeaderSize = kLengthSize + 8 + 1 + 4;
+inline constexpr size_t kMaxFrame = 1 << 20;
+// The longest message a frame can carry; senders cut or split longer ones
+inline constexpr size_t kMaxMessage = kMaxFrame - (kHeaderSize - kLengthSize);
+
+struct Record {
+    int64_t timestampNs = 0;
+    uint8_t level = 0;
+    uint32_t sourceId = 0;
+    std::string_view message;
+};
+
+inline void putU32(char* out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out[i] = char(v >> (8 * i));
+}
+
+inline void putU64(char* out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out[i] = char(v >> (8 * i));
+}
+
+inline uint32_t getU32(const char* in) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | (unsigned char)in[i];
+    return v;
+}
+
+inline uint64_t getU64(const char* in) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | (unsigned char)in[i];
+    return v;
+}
+
+inline size_t frameSize(const Record& record) {
+    return kHeaderSize + record.message.size();
+}
+
+// Appends one frame to out
+inline void appendFrame(std::string& out, const Record& record) {
+    size_t start = out.size();
+    out.resize(start + frameSize(record));
+    char* p = &out[start];
+    putU32(p, uint32_t(kHeaderSize - kLengthSize + record.message.size()));
+    putU64(p + 4, uint64_t(record.timestampNs));
+    p[12] = char(record.level);
+    putU32(p + 13, record.sourceId);
+    std::memcpy(p + kHeaderSize, record.message.data(), record.message.size());
+}
+
+// Size of the complete frame at the start of data, 0 if more bytes are
+// needed, or SIZE_MAX if the length field is invalid
+inline size_t completeFrame(const char* data, size_t size) {
+    if (size < kLengthSize) return 0;
+    uint32_t length = getU32(data);
+    if (length < kHeaderSize - kLengthSize || length > kMaxFrame) return SIZE_MAX;
+    if (size < kLengthSize + length) return 0;
+    return kLengthSize + length;
+}
+
+// Parses a frame previously validated by completeFrame
+inline Record decodeFrame(const char* data) {
+    Record record;
+    uint32_t length = getU32(data);
+    record.timestampNs = int64_t(getU64(data + 4));
+    record.level = uint8_t(data[12]);
+    record.sourceId = getU32(data + 13);
+    record.message = std::string_view(data + kHeaderSize, length - (kHeaderSize - kLengthSize));
+    return record;
+}
+
+}
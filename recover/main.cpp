@@ -0,0 +1,81 @@
+// log_recover: prints the records kept in a RingSink file, oldest first,
+// e.g. the last lines of a process that crashed.
+
+#include "ring_sink.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static LogLevel levelFrom(const std::string& name) {
+    for (int i = 0; i < int(LogLevel::Default); ++i) {
+        if (name == kLevelNames[i]) return LogLevel(i);
+    }
+    throw std::invalid_argument("Unknown level: " + name);
+}
+
+int main(int argc, char* argv[]) {
+    LogLevel level = LogLevel::Debug;
+    size_t last = 0;
+    std::string path;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+
+            if (arg == "--level" && i + 1 < argc) {
+                level = levelFrom(argv[++i]);
+            }
+            else if (arg == "--tail" && i + 1 < argc) {
+                last = std::stoul(argv[++i]);
+            }
+            else if (!arg.empty() && arg[0] == '-') {
+                throw std::invalid_argument("Unknown parameter: " + arg);
+            }
+            else if (path.empty()) {
+                path = arg;
+            }
+            else {
+                throw std::invalid_argument("One ring file at a time");
+            }
+        }
+        if (path.empty()) throw std::invalid_argument("No ring file");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        std::cerr << "Use example:\n"
+                  << argv[0] << " [--level Warning] [--tail 100] RING_FILE\n";
+        return 2;
+    }
+
+    RingContents contents;
+    std::string error;
+    if (!readRingFile(path, contents, error)) {
+        std::cerr << path << ": " << error << "\n";
+        return 2;
+    }
+
+    size_t selected = 0;
+    for (const RingRecord& record : contents.records) {
+        if (record.level >= level) ++selected;
+    }
+    size_t skip = last > 0 && selected > last ? selected - last : 0;
+    for (const RingRecord& record : contents.records) {
+        if (record.level < level) continue;
+        if (skip > 0) {
+            --skip;
+            continue;
+        }
+        std::cout << record.text;
+        if (record.text.empty() || record.text.back() != '\n') std::cout << '\n';
+    }
+
+    std::cerr << path << ": " << contents.records.size() << " records";
+    if (!contents.records.empty()) {
+        std::cerr << " (#" << contents.records.front().sequence << " to #" << contents.records.back().sequence << ")";
+    }
+    std::cerr << ", " << contents.overwritten << " older overwritten";
+    if (contents.damaged) std::cerr << "; damaged frame after the last one shown";
+    std::cerr << "\n";
+    return contents.damaged ? 1 : 0;
+}
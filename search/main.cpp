@@ -0,0 +1,217 @@
+// log_search: grep for Logger files, by substring, level and time range.
+// Each file gets a trigram index next to it (search_index.hpp), updated
+// before the query, so only blocks that can match are verified; the
+// verification runs on all cores.
+
+#include "search_index.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SearchOptions {
+    std::string pattern;
+    bool ignoreCase = false;
+    bool countOnly = false;
+    bool useIndex = true;
+    bool buildOnly = false;
+    unsigned threads = 0;
+    search::LineFilter filter;
+};
+
+// A part of a mapped log to verify
+struct Range {
+    const char* begin;
+    const char* end;
+    size_t file;
+};
+
+// "YYYY-MM-DD HH:MM:SS" in local time, as Logger writes it, or Unix seconds
+static int64_t parseTime(const std::string& text) {
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) return std::stoll(text);
+    ParsedLine parsed;
+    std::string line = text + " [Info]";
+    if (!parseLogLine(line, parsed)) throw std::invalid_argument("Bad time: " + text);
+    return parsed.epochSeconds;
+}
+
+// N[s|m|h] seconds back from now
+static int64_t parseAgo(const std::string& text) {
+    size_t used = 0;
+    long long amount = std::stoll(text, &used);
+    std::string unit = text.substr(used);
+    int seconds = unit.empty() || unit == "s" ? 1 : unit == "m" ? 60 : unit == "h" ? 3600 : 0;
+    if (seconds == 0) throw std::invalid_argument("Bad duration: " + text);
+    return int64_t(std::time(nullptr)) - amount * seconds;
+}
+
+static uint32_t levelsFrom(const std::string& name) {
+    LogLevel level;
+    if (!parser::parseLevel(name, level)) throw std::invalid_argument("Unknown level: " + name);
+    return 0x0F & ~((1u << int(level)) - 1);
+}
+
+int main(int argc, char* argv[]) {
+    SearchOptions options;
+    std::vector<std::string> files;
+
+    try {
+        std::vector<std::string> positional;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+
+            if (arg == "-i") {
+                options.ignoreCase = true;
+            }
+            else if (arg == "-c" || arg == "--count") {
+                options.countOnly = true;
+            }
+            else if (arg == "--level" && i + 1 < argc) {
+                options.filter.levels = levelsFrom(argv[++i]);
+            }
+            else if (arg == "--since" && i + 1 < argc) {
+                options.filter.since = parseTime(argv[++i]);
+            }
+            else if (arg == "--until" && i + 1 < argc) {
+                options.filter.until = parseTime(argv[++i]);
+            }
+            else if (arg == "--last" && i + 1 < argc) {
+                options.filter.since = parseAgo(argv[++i]);
+            }
+            else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = unsigned(std::stoul(argv[++i]));
+            }
+            else if (arg == "--no-index") {
+                options.useIndex = false;
+            }
+            else if (arg == "--build") {
+                options.buildOnly = true;
+            }
+            else if (!arg.empty() && arg[0] == '-' && arg != "-") {
+                throw std::invalid_argument("Unknown parameter: " + arg);
+            }
+            else {
+                positional.push_back(arg);
+            }
+        }
+
+        if (!options.buildOnly) {
+            if (positional.empty()) throw std::invalid_argument("No pattern");
+            options.pattern = positional.front();
+            positional.erase(positional.begin());
+        }
+        files = positional;
+        if (files.empty()) throw std::invalid_argument("No files");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        std::cerr << "Use example:\n"
+                  << argv[0] << " [-i] [-c] [--level Error] [--since \"2026-01-01 10:00:00\"] [--until ...]"
+                  << " [--last 30m] [--threads N] [--no-index] PATTERN FILE...\n"
+                  << "   or: " << argv[0] << " --build FILE...   (only create or update the indexes)\n";
+        return 2;
+    }
+    if (options.threads == 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<search::MappedFile> logs(files.size());
+    std::vector<search::TrigramIndex> indexes(files.size());
+    std::vector<Range> ranges;
+    size_t blocks = 0;
+    size_t skipped = 0;
+    SubstringFinder finder(options.pattern, options.ignoreCase);
+
+    for (size_t f = 0; f < files.size(); ++f) {
+        if (!logs[f].open(files[f])) {
+            std::cerr << "Cannot open " << files[f] << "\n";
+            return 2;
+        }
+        const char* data = logs[f].data();
+        uint64_t size = logs[f].size();
+
+        bool indexed = false;
+        if (options.useIndex) {
+            std::string indexPath = files[f] + std::string(search::kIndexSuffix);
+            if (!search::updateIndex(indexPath, data, size, options.threads)) {
+                std::cerr << "Cannot write " << indexPath << ", searching without it\n";
+            }
+            indexed = indexes[f].load(indexPath) && indexes[f].matches(data, size);
+        }
+        if (options.buildOnly) continue;
+
+        const search::TrigramIndex& index = indexes[f];
+        uint64_t covered = indexed ? index.covered() : 0;
+        if (indexed) {
+            std::vector<uint32_t> ids;
+            if (!index.blocksWith(finder.needle(), ids)) {
+                ids.resize(index.blockCount());
+                for (size_t id = 0; id < ids.size(); ++id) ids[id] = uint32_t(id);
+            }
+            blocks += index.blockCount();
+            skipped += index.blockCount() - ids.size();
+            for (uint32_t id : ids) {
+                const search::BlockInfo& block = index.block(id);
+                if (!options.filter.accepts(block)) {
+                    ++skipped;
+                    continue;
+                }
+                ranges.push_back({ data + block.offset, data + block.offset + block.size, f });
+            }
+        }
+
+        // The tail (or a file searched without an index) in line-aligned
+        // pieces, so it is spread over the workers as well
+        const char* p = data + covered;
+        const char* end = data + size;
+        while (p < end) {
+            const char* next = end;
+            if (size_t(end - p) > search::kBlockBytes) {
+                const char* newline = static_cast<const char*>(
+                    std::memchr(p + search::kBlockBytes - 1, '\n', end - (p + search::kBlockBytes - 1)));
+                if (newline != nullptr) next = newline + 1;
+            }
+            ranges.push_back({ p, next, f });
+            p = next;
+        }
+    }
+    if (options.buildOnly) {
+        for (size_t f = 0; f < files.size(); ++f) {
+            std::cerr << files[f] << ": " << indexes[f].blockCount() << " blocks, "
+                      << indexes[f].trigramCount() << " trigrams indexed\n";
+        }
+        return 0;
+    }
+
+    // Verify on all cores; output keeps the file order
+    std::vector<std::string> outputs(ranges.size());
+    std::vector<size_t> counts(ranges.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < options.threads; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i; (i = next.fetch_add(1)) < ranges.size();) {
+                const Range& range = ranges[i];
+                std::string prefix = files.size() > 1 ? files[range.file] + ":" : std::string();
+                counts[i] = search::searchRange(range.begin, range.end, finder, options.filter, prefix,
+                                                options.countOnly ? nullptr : &outputs[i]);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    size_t total = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        total += counts[i];
+        std::cout << outputs[i];
+    }
+    if (options.countOnly) std::cout << total << "\n";
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << total << " matching lines; " << skipped << " of " << blocks << " indexed blocks skipped; "
+              << uint64_t(ms) << " ms\n";
+    return total > 0 ? 0 : 1;
+}
@@ -0,0 +1,397 @@
+#pragma once
+
+// Trigram index of a Logger file for log_search. The file is cut into
+// blocks of about kBlockBytes on line boundaries; per block the index keeps
+// the time range and a bitmap of the levels of its records, and for every
+// trigram (of ASCII-lowercased text) the sorted ids of the blocks it occurs
+// in. A query only verifies the blocks that can hold a match.
+//
+// The index lives next to the log as "<file>.lgidx" and is memory-mapped
+// for queries. Only whole blocks are indexed; as the log grows the new
+// blocks are added without reading the old part of the log again, and the
+// unindexed tail is always searched directly.
+
+#include "log_parser.hpp"
+#include "substring_search.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace search {
+
+inline constexpr size_t kBlockBytes = 256 * 1024;
+inline constexpr std::string_view kIndexSuffix = ".lgidx";
+
+// Level bits: Debug, Info, Warning, Error, then lines that are not records
+inline constexpr uint8_t kUnparsedBit = 1u << 4;
+inline constexpr uint8_t kAllLevels = 0x1F;
+
+// File layout: IndexHeader, BlockInfo[blockCount], TrigramEntry[trigramCount]
+// sorted by trigram, then uint32_t block ids; all in host byte order
+inline constexpr char kMagic[8] = { 'L', 'G', 'I', 'D', 'X', '2', 0, 0 };
+
+struct IndexHeader {
+    char magic[8];
+    uint64_t covered;    // log bytes in indexed blocks
+    uint64_t headHash;   // of the first log bytes, to notice a replaced file
+    uint64_t blockCount;
+    uint64_t trigramCount;
+    uint64_t postingCount;
+};
+
+struct BlockInfo {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    int64_t minTime = INT64_MAX;
+    int64_t maxTime = INT64_MIN;
+    uint32_t levels = 0;
+    uint32_t records = 0;
+};
+
+struct TrigramEntry {
+    uint32_t trigram;
+    uint32_t count;
+    uint64_t first;  // into the block ids; their total passes 2^32 on large logs
+};
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { reset(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        reset();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st{};
+        bool ok = fstat(fd, &st) == 0;
+        if (ok && st.st_size > 0) {
+            void* mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = mapped != MAP_FAILED;
+            if (ok) {
+                m_data = static_cast<const char*>(mapped);
+                m_size = size_t(st.st_size);
+            }
+        }
+        close(fd);
+        return ok;
+    }
+
+    void reset() {
+        if (m_data != nullptr) munmap(const_cast<char*>(m_data), m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+inline uint64_t headHash(const char* log, uint64_t covered) {
+    uint64_t hash = 14695981039346656037ull;  // FNV-1a
+    for (uint64_t i = 0; i < std::min<uint64_t>(covered, 4096); ++i) {
+        hash = (hash ^ uint8_t(log[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint32_t trigramAt(const char* p) {
+    return uint32_t(uint8_t(foldCase(p[0]))) << 16 | uint32_t(uint8_t(foldCase(p[1]))) << 8 |
+           uint32_t(uint8_t(foldCase(p[2])));
+}
+
+inline uint32_t levelBit(std::string_view line, ParsedLine& parsed, bool& isRecord) {
+    isRecord = parseLogLine(line, parsed);
+    return isRecord ? 1u << int(parsed.level) : kUnparsedBit;
+}
+
+// Level and time conditions of a query, checked per block and per line
+struct LineFilter {
+    int64_t since = INT64_MIN;
+    int64_t until = INT64_MAX;
+    uint32_t levels = kAllLevels;
+
+    bool timed() const { return since != INT64_MIN || until != INT64_MAX; }
+
+    bool accepts(const BlockInfo& block) const {
+        return (block.levels & levels) != 0 && (!timed() || (block.minTime <= until && block.maxTime >= since));
+    }
+
+    bool accepts(std::string_view line) const {
+        if (levels == kAllLevels && !timed()) return true;
+        ParsedLine parsed;
+        bool isRecord;
+        uint32_t bit = levelBit(line, parsed, isRecord);
+        if (!isRecord) return (levels & bit) != 0 && !timed();
+        return (levels & bit) != 0 && parsed.epochSeconds >= since && parsed.epochSeconds <= until;
+    }
+};
+
+// Sorted distinct trigrams and the record stats of one block. seen is a
+// 2^24-bit scratch bitmap, all zero before and after the call.
+inline void indexBlock(const char* log, BlockInfo& block, std::vector<uint32_t>& trigrams, std::vector<uint64_t>& seen) {
+    const char* p = log + block.offset;
+    size_t size = block.size;
+    trigrams.clear();
+    for (size_t i = 0; i + 2 < size; ++i) {
+        if (p[i + 2] == '\n') {  // nothing to find across lines
+            i += 2;
+            continue;
+        }
+        uint32_t trigram = trigramAt(p + i);
+        uint64_t& word = seen[trigram >> 6];
+        uint64_t bit = 1ull << (trigram & 63);
+        if ((word & bit) == 0) {
+            word |= bit;
+            trigrams.push_back(trigram);
+        }
+    }
+    for (uint32_t trigram : trigrams) seen[trigram >> 6] = 0;
+    std::sort(trigrams.begin(), trigrams.end());
+
+    const char* end = p + size;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = newline ? newline : end;
+        ParsedLine parsed;
+        bool isRecord;
+        block.levels |= levelBit(std::string_view(p, lineEnd - p), parsed, isRecord);
+        if (isRecord) {
+            block.minTime = std::min(block.minTime, parsed.epochSeconds);
+            block.maxTime = std::max(block.maxTime, parsed.epochSeconds);
+        }
+        ++block.records;
+        p = lineEnd + 1;
+    }
+}
+
+// Whole blocks of log[from, size): each ends with the first newline at or
+// after kBlockBytes
+inline std::vector<BlockInfo> cutBlocks(const char* log, uint64_t from, uint64_t size) {
+    std::vector<BlockInfo> blocks;
+    while (size - from > kBlockBytes) {
+        const char* scan = log + from + kBlockBytes - 1;
+        const char* newline = static_cast<const char*>(std::memchr(scan, '\n', log + size - scan));
+        if (newline == nullptr) break;
+        BlockInfo block;
+        block.offset = from;
+        block.size = uint64_t(newline + 1 - (log + from));
+        blocks.push_back(block);
+        from += block.size;
+    }
+    return blocks;
+}
+
+class TrigramIndex {
+public:
+    // false if the file is missing or not an index
+    bool load(const std::string& path) {
+        m_header = nullptr;
+        if (!m_file.open(path) || m_file.size() < sizeof(IndexHeader)) return false;
+        const auto* header = reinterpret_cast<const IndexHeader*>(m_file.data());
+        if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) return false;
+        uint64_t expected = sizeof(IndexHeader) + header->blockCount * sizeof(BlockInfo) +
+                            header->trigramCount * sizeof(TrigramEntry) + header->postingCount * sizeof(uint32_t);
+        if (expected != m_file.size()) return false;
+
+        m_header = header;
+        m_blocks = reinterpret_cast<const BlockInfo*>(header + 1);
+        m_trigrams = reinterpret_cast<const TrigramEntry*>(m_blocks + header->blockCount);
+        m_postings = reinterpret_cast<const uint32_t*>(m_trigrams + header->trigramCount);
+        return true;
+    }
+
+    // The log still starts with the bytes that were indexed
+    bool matches(const char* log, uint64_t size) const {
+        return m_header != nullptr && m_header->covered <= size &&
+               (m_header->covered == 0 || headHash(log, m_header->covered) == m_header->headHash);
+    }
+
+    uint64_t covered() const { return m_header ? m_header->covered : 0; }
+    size_t blockCount() const { return m_header ? size_t(m_header->blockCount) : 0; }
+    const BlockInfo& block(size_t id) const { return m_blocks[id]; }
+    size_t trigramCount() const { return m_header ? size_t(m_header->trigramCount) : 0; }
+    const TrigramEntry& trigram(size_t i) const { return m_trigrams[i]; }
+    const uint32_t* postings() const { return m_postings; }
+
+    // Ids of the blocks holding every trigram of needle; false when the
+    // needle is too short for the index to narrow anything down
+    bool blocksWith(std::string_view needle, std::vector<uint32_t>& out) const {
+        out.clear();
+        if (needle.size() < 3 || m_header == nullptr) return false;
+
+        std::vector<const TrigramEntry*> entries;
+        for (size_t i = 0; i + 2 < needle.size(); ++i) {
+            uint32_t trigram = trigramAt(needle.data() + i);
+            const TrigramEntry* end = m_trigrams + m_header->trigramCount;
+            const TrigramEntry* it = std::lower_bound(m_trigrams, end, trigram,
+                                                      [](const TrigramEntry& e, uint32_t t) { return e.trigram < t; });
+            if (it == end || it->trigram != trigram) return true;  // no block has it
+            entries.push_back(it);
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const TrigramEntry* a, const TrigramEntry* b) { return a->count < b->count; });
+
+        out.assign(m_postings + entries[0]->first, m_postings + entries[0]->first + entries[0]->count);
+        std::vector<uint32_t> kept;
+        for (size_t i = 1; i < entries.size() && !out.empty(); ++i) {
+            const uint32_t* list = m_postings + entries[i]->first;
+            kept.clear();
+            std::set_intersection(out.begin(), out.end(), list, list + entries[i]->count, std::back_inserter(kept));
+            out.swap(kept);
+        }
+        return true;
+    }
+
+private:
+    MappedFile m_file;
+    const IndexHeader* m_header = nullptr;
+    const BlockInfo* m_blocks = nullptr;
+    const TrigramEntry* m_trigrams = nullptr;
+    const uint32_t* m_postings = nullptr;
+};
+
+// Brings the index at path up to date with log[0, size): reuses what it
+// covers if the log still starts the same, indexes the new whole blocks
+// on threads workers and replaces the file. Returns false on write errors.
+inline bool updateIndex(const std::string& path, const char* log, uint64_t size, unsigned threads) {
+    std::vector<BlockInfo> blocks;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+    uint64_t covered = 0;
+    {
+        TrigramIndex old;
+        if (old.load(path) && old.matches(log, size)) {
+            covered = old.covered();
+            if (size - covered <= kBlockBytes) return true;  // no whole block to add
+            blocks.assign(&old.block(0), &old.block(0) + old.blockCount());
+            for (size_t i = 0; i < old.trigramCount(); ++i) {
+                const TrigramEntry& entry = old.trigram(i);
+                postings[entry.trigram].assign(old.postings() + entry.first, old.postings() + entry.first + entry.count);
+            }
+        }
+    }
+
+    std::vector<BlockInfo> fresh = cutBlocks(log, covered, size);
+    if (!fresh.empty()) covered = fresh.back().offset + fresh.back().size;
+
+    // In batches, so the per-block trigram lists stay bounded
+    threads = std::max(1u, threads);
+    size_t batch = size_t(threads) * 16;
+    std::vector<std::vector<uint32_t>> trigrams(batch);
+    std::vector<std::vector<uint64_t>> seen(threads, std::vector<uint64_t>(size_t(1) << 18));
+    for (size_t start = 0; start < fresh.size(); start += batch) {
+        size_t end = std::min(fresh.size(), start + batch);
+        std::atomic<size_t> next(start);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (size_t i; (i = next.fetch_add(1)) < end;) indexBlock(log, fresh[i], trigrams[i - start], seen[t]);
+            });
+        }
+        for (auto& worker : workers) worker.join();
+
+        for (size_t i = start; i < end; ++i) {
+            if (blocks.size() > UINT32_MAX) return false;  // block ids are 32-bit
+            uint32_t id = uint32_t(blocks.size());
+            blocks.push_back(fresh[i]);
+            for (uint32_t trigram : trigrams[i - start]) postings[trigram].push_back(id);
+        }
+    }
+
+    std::vector<uint32_t> keys;
+    keys.reserve(postings.size());
+    uint64_t postingCount = 0;
+    for (const auto& entry : postings) {
+        keys.push_back(entry.first);
+        postingCount += entry.second.size();
+    }
+    std::sort(keys.begin(), keys.end());
+
+    IndexHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.covered = covered;
+    header.headHash = headHash(log, covered);
+    header.blockCount = blocks.size();
+    header.trigramCount = keys.size();
+    header.postingCount = postingCount;
+
+    // A unique temporary next to the index: concurrent runs each write their
+    // own and the last rename wins with a whole file
+    std::string temporary = path + ".XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    if (fd == -1) return false;
+    fchmod(fd, 0644);
+    FILE* out = fdopen(fd, "wb");
+    if (out == nullptr) {
+        close(fd);
+        std::remove(temporary.c_str());
+        return false;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   std::fwrite(blocks.data(), sizeof(BlockInfo), blocks.size(), out) == blocks.size();
+    uint64_t first = 0;
+    for (size_t i = 0; written && i < keys.size(); ++i) {
+        TrigramEntry entry{ keys[i], uint32_t(postings[keys[i]].size()), first };
+        written = std::fwrite(&entry, sizeof(entry), 1, out) == 1;
+        first += entry.count;
+    }
+    for (size_t i = 0; written && i < keys.size(); ++i) {
+        const std::vector<uint32_t>& ids = postings[keys[i]];
+        written = std::fwrite(ids.data(), sizeof(uint32_t), ids.size(), out) == ids.size();
+    }
+    written = std::fclose(out) == 0 && written;
+    if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Lines of [begin, end) that contain the finder's needle and pass the
+// filter, appended to out (if given) after prefix; returns their number
+inline size_t searchRange(const char* begin, const char* end, const SubstringFinder& finder, const LineFilter& filter,
+                          std::string_view prefix, std::string* out) {
+    size_t matches = 0;
+    const char* p = begin;
+    while (p < end) {
+        const char* lineStart = p;
+        if (!finder.needle().empty()) {
+            const char* hit = finder.find(p, end);
+            if (hit == nullptr) break;
+            const char* newline = static_cast<const char*>(memrchr(p, '\n', hit - p));
+            lineStart = newline ? newline + 1 : p;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(lineStart, '\n', end - lineStart));
+        const char* lineEnd = newline ? newline : end;
+        std::string_view line(lineStart, lineEnd - lineStart);
+        if (filter.accepts(line)) {
+            ++matches;
+            if (out) out->append(prefix).append(line).push_back('\n');
+        }
+        p = lineEnd + 1;
+    }
+    return matches;
+}
+
+}
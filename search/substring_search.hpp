@@ -0,0 +1,91 @@
+#pragma once
+
+// Substring search used to verify candidate blocks. With SSE2, 16 start
+// positions are tested at once against the first and the last byte of the
+// needle and only positions where both agree are compared in full
+// (W. Muła, "SIMD-friendly algorithms for substring searching"); other
+// targets fall back to memmem.
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+inline char foldCase(char c) {
+    return c >= 'A' && c <= 'Z' ? char(c + ('a' - 'A')) : c;
+}
+
+class SubstringFinder {
+public:
+    SubstringFinder(std::string_view needle, bool ignoreCase)
+        : m_needle(needle), m_ignoreCase(ignoreCase)
+    {
+        if (m_ignoreCase) {
+            for (char& c : m_needle) c = foldCase(c);
+        }
+    }
+
+    const std::string& needle() const { return m_needle; }
+
+    // First occurrence in [begin, end), or nullptr
+    const char* find(const char* begin, const char* end) const {
+        size_t n = m_needle.size();
+        if (n == 0) return begin;
+        if (size_t(end - begin) < n) return nullptr;
+        const char* last = end - n;  // the last possible start
+
+#if defined(__SSE2__)
+        char first = m_needle[0];
+        char final = m_needle[n - 1];
+        const __m128i firstLower = _mm_set1_epi8(first);
+        const __m128i finalLower = _mm_set1_epi8(final);
+        const __m128i firstUpper = _mm_set1_epi8(m_ignoreCase ? upper(first) : first);
+        const __m128i finalUpper = _mm_set1_epi8(m_ignoreCase ? upper(final) : final);
+
+        const char* p = begin;
+        for (; last - p >= 15; p += 16) {
+            __m128i heads = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i tails = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + n - 1));
+            __m128i both = _mm_and_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(heads, firstLower), _mm_cmpeq_epi8(heads, firstUpper)),
+                _mm_or_si128(_mm_cmpeq_epi8(tails, finalLower), _mm_cmpeq_epi8(tails, finalUpper)));
+            for (unsigned mask = unsigned(_mm_movemask_epi8(both)); mask != 0; mask &= mask - 1) {
+                const char* candidate = p + __builtin_ctz(mask);
+                if (matchesAt(candidate)) return candidate;
+            }
+        }
+        for (; p <= last; ++p) {
+            if (matchesAt(p)) return p;
+        }
+        return nullptr;
+#else
+        if (!m_ignoreCase) {
+            return static_cast<const char*>(memmem(begin, end - begin, m_needle.data(), n));
+        }
+        for (const char* p = begin; p <= last; ++p) {
+            if (matchesAt(p)) return p;
+        }
+        return nullptr;
+#endif
+    }
+
+private:
+    static char upper(char c) {
+        return c >= 'a' && c <= 'z' ? char(c - ('a' - 'A')) : c;
+    }
+
+    bool matchesAt(const char* p) const {
+        if (!m_ignoreCase) return std::memcmp(p, m_needle.data(), m_needle.size()) == 0;
+        for (size_t i = 0; i < m_needle.size(); ++i) {
+            if (foldCase(p[i]) != m_needle[i]) return false;
+        }
+        return true;
+    }
+
+    std::string m_needle;  // folded to lower case when ignoring case
+    bool m_ignoreCase;
+};
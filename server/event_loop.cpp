@@ -0,0 +1,704 @@
+#include "event_loop.hpp"
+#include "record_format.hpp"
+#include "wire_protocol.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static const size_t kInitialReadBuffer = 4096;
+static const size_t kMaxReadBuffer = 1 << 20;
+static const int kMaxEvents = 256;
+static const size_t kSpillChunk = 64 * 1024;
+static const int kMaxIov = 64;
+static const int kReplayBurst = 16;  // store chunks per flush before other connections get a turn
+
+EventLoop::EventLoop(LogServer& server, int index)
+    : m_server(server), m_index(index)
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wakeFd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+    int interval = m_server.options().statsInterval;
+    if (interval > 0) {
+        m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        itimerspec spec{};
+        spec.it_interval.tv_sec = interval;
+        spec.it_value.tv_sec = interval;
+        timerfd_settime(m_timerFd, 0, &spec, nullptr);
+
+        ev.events = EPOLLIN;
+        ev.data.fd = m_timerFd;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timerFd, &ev);
+    }
+}
+
+EventLoop::~EventLoop() {
+    stop();
+    for (auto& entry : m_connections) {
+        if (entry.second->spillFd != -1) close(entry.second->spillFd);
+        close(entry.first);
+    }
+    if (m_listenFd != -1) close(m_listenFd);
+    if (m_timerFd != -1) close(m_timerFd);
+    if (m_wakeFd != -1) close(m_wakeFd);
+    if (m_epoll != -1) close(m_epoll);
+}
+
+bool EventLoop::listen(int port) {
+    m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd == -1) {
+        perror("socket");
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;  // 0.0.0.0
+    addr.sin_port = htons(port);
+
+    if (bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return false;
+    }
+    if (::listen(m_listenFd, SOMAXCONN) < 0) {
+        perror("listen");
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = m_listenFd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listenFd, &ev);
+    return true;
+}
+
+void EventLoop::start() {
+    m_thread = std::thread(&EventLoop::run, this);
+}
+
+void EventLoop::stop() {
+    m_stopping.store(true);
+    uint64_t one = 1;
+    if (write(m_wakeFd, &one, sizeof(one)) < 0) {}
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void EventLoop::post(const RelayMessage& message) {
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(m_inboxMutex);
+        wasEmpty = m_inbox.empty();
+        m_inbox.push_back(message);
+    }
+    // One wakeup per batch: the loop drains the whole inbox at once
+    if (wasEmpty) {
+        uint64_t one = 1;
+        if (write(m_wakeFd, &one, sizeof(one)) < 0) {}
+    }
+}
+
+void EventLoop::run() {
+    epoll_event events[kMaxEvents];
+
+    while (!m_stopping.load()) {
+        int n = epoll_wait(m_epoll, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == m_listenFd) {
+                acceptAll();
+                continue;
+            }
+            if (fd == m_wakeFd) {
+                uint64_t counter;
+                if (read(m_wakeFd, &counter, sizeof(counter)) < 0) {}
+                drainInbox();
+                closeStalled();
+                resumeReplays();
+                continue;
+            }
+            if (fd == m_timerFd) {
+                uint64_t expirations;
+                if (read(m_timerFd, &expirations, sizeof(expirations)) < 0) {}
+                reportStats();
+                continue;
+            }
+
+            auto it = m_connections.find(fd);
+            if (it == m_connections.end()) continue;
+            Connection& conn = *it->second;
+
+            if (events[i].events & EPOLLOUT) {
+                flush(conn);
+                // flush may have closed the connection
+                if (m_connections.find(fd) == m_connections.end()) continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                readAll(conn);
+                closeStalled();
+            }
+        }
+    }
+}
+
+void EventLoop::acceptAll() {
+    for (;;) {
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
+        }
+
+        auto conn = std::make_unique<Connection>();
+        conn->fd = fd;
+        conn->id = m_server.nextConnectionId();
+        // Records stored before the client connected may still sit in this
+        // loop's inbox; they are history, reachable only by a query
+        if (LogStore* store = m_server.store()) conn->liveFrom = store->endOffset();
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+        m_connections[fd] = std::move(conn);
+        m_connectionCount.store(int(m_connections.size()), std::memory_order_relaxed);
+        m_server.textClients().fetch_add(1);
+
+        if (!m_server.options().quiet) {
+            std::cout << "New client connected!\n";
+        }
+    }
+}
+
+void EventLoop::readAll(Connection& conn) {
+    int fd = conn.fd;
+
+    for (;;) {
+        if (!conn.readBuffer) {
+            if (conn.nextCapacity == 0) conn.nextCapacity = kInitialReadBuffer;
+            conn.readBuffer.reset(new char[conn.nextCapacity]);
+            conn.readCapacity = conn.nextCapacity;
+        }
+        else if (conn.readSize == conn.readCapacity) {
+            // One record larger than the buffer: it is still ours, grow it
+            size_t capacity = conn.readCapacity * 2;
+            std::shared_ptr<char[]> bigger(new char[capacity]);
+            std::memcpy(bigger.get(), conn.readBuffer.get(), conn.readSize);
+            conn.readBuffer = std::move(bigger);
+            conn.readCapacity = capacity;
+        }
+
+        size_t space = conn.readCapacity - conn.readSize;
+        ssize_t bytesRead = recv(fd, conn.readBuffer.get() + conn.readSize, space, 0);
+        if (bytesRead > 0) {
+            // A full read means more is waiting: read bigger next time;
+            // a mostly empty one means the burst is over
+            if ((size_t)bytesRead == space && conn.nextCapacity < kMaxReadBuffer) {
+                conn.nextCapacity *= 2;
+            } else if ((size_t)bytesRead < space / 4 && conn.nextCapacity > kInitialReadBuffer) {
+                conn.nextCapacity /= 2;
+            }
+            size_t scanFrom = conn.readSize;
+            conn.readSize += bytesRead;
+            frameRecords(conn, scanFrom);
+            if (!conn.broken) continue;
+        }
+        else if (bytesRead < 0 && errno == EINTR) continue;
+        else if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        // Peer closed: relay an unterminated last line as-is (an incomplete
+        // binary frame is dropped)
+        if (conn.readSize > 0 && !conn.binary && !conn.broken) {
+            relay(conn, conn.readSize, 1);
+        }
+        closeConnection(fd);
+        return;
+    }
+}
+
+void EventLoop::frameRecords(Connection& conn, size_t scanFrom) {
+    if (!conn.helloChecked) {
+        if (!checkHello(conn)) return;
+        scanFrom = 0;
+    }
+    if (conn.binary) frameBinary(conn);
+    else frameLines(conn, scanFrom);
+}
+
+// Looks for wire::kHelloBinary at the very start of the connection.
+// Returns false while the bytes so far are still a prefix of it.
+bool EventLoop::checkHello(Connection& conn) {
+    std::string_view hello = wire::kHelloBinary;
+    std::string_view head(conn.readBuffer.get(), std::min(conn.readSize, hello.size()));
+    if (hello.compare(0, head.size(), head) != 0) {
+        conn.helloChecked = true;
+        return true;
+    }
+    if (head.size() < hello.size()) return false;
+
+    conn.helloChecked = true;
+    conn.binary = true;
+    m_server.textClients().fetch_sub(1);
+    m_server.binaryClients().fetch_add(1);
+
+    // The buffer has not been shared yet: drop the hello in place
+    conn.readSize -= hello.size();
+    std::memmove(conn.readBuffer.get(), conn.readBuffer.get() + hello.size(), conn.readSize);
+
+    RecordSlice accept;  // static bytes, nothing to own
+    accept.data = wire::kHelloAccept.data();
+    accept.size = wire::kHelloAccept.size();
+    sendDirect(conn, accept);
+    return true;
+}
+
+void EventLoop::frameLines(Connection& conn, size_t scanFrom) {
+    if (conn.readSize > 0 && conn.readBuffer[0] == '#') {
+        if (!checkQuery(conn)) return;
+        scanFrom = 0;
+    }
+    const char* base = conn.readBuffer.get();
+    const char* last = static_cast<const char*>(memrchr(base + scanFrom, '\n', conn.readSize - scanFrom));
+    if (last == nullptr) {
+        // No terminator yet; a runaway record is cut rather than buffered forever
+        if (conn.readSize >= kMaxReadBuffer) {
+            relay(conn, conn.readSize, 1);
+        }
+        return;
+    }
+
+    size_t framed = last - base + 1;
+    relay(conn, framed, std::count(base, base + framed, '\n'));
+}
+
+// A kQueryCommand line at the start of the buffer is a store query rather
+// than a record. Returns false while the bytes so far may still become one.
+bool EventLoop::checkQuery(Connection& conn) {
+    std::string_view command = kQueryCommand;
+    std::string_view head(conn.readBuffer.get(), conn.readSize);
+    size_t compared = std::min(head.size(), command.size());
+    if (head.compare(0, compared, command, 0, compared) != 0) return true;
+    if (head.size() <= command.size()) return false;
+    if (head[command.size()] != ' ' && head[command.size()] != '\n') return true;
+
+    size_t newline = head.find('\n');
+    if (newline == std::string_view::npos) return head.size() >= kMaxReadBuffer;
+    startReplay(conn, head.substr(command.size(), newline - command.size()));
+
+    // The buffer has not been shared yet: drop the query in place
+    conn.readSize -= newline + 1;
+    std::memmove(conn.readBuffer.get(), conn.readBuffer.get() + newline + 1, conn.readSize);
+    return true;
+}
+
+void EventLoop::startReplay(Connection& conn, std::string_view args) {
+    LogStore* store = m_server.store();
+    StoreQuery query;
+    std::string error = "no store on this server";
+    if (store == nullptr || !parseQuery(args, query, error)) {
+        sendDirect(conn, makeSlice("#LGERROR " + error + "\n"));
+        return;
+    }
+
+    conn.replay = std::make_unique<StoreCursor>();
+    conn.replay->query = query;
+    conn.follows = query.follow;
+    conn.liveLevels = query.levels;
+    if (!m_server.options().quiet) {
+        std::cout << "Client " << conn.id << " replays the store.\n";
+    }
+    if (conn.outQueue.empty()) {
+        flush(conn);
+    }
+}
+
+void EventLoop::frameBinary(Connection& conn) {
+    const char* base = conn.readBuffer.get();
+    size_t framed = 0;
+    size_t count = 0;
+    for (;;) {
+        size_t size = wire::completeFrame(base + framed, conn.readSize - framed);
+        if (size == 0) break;
+        if (size == SIZE_MAX) {
+            std::cerr << "Client " << conn.id << " sent an invalid frame, closing\n";
+            conn.broken = true;
+            break;
+        }
+        framed += size;
+        ++count;
+    }
+    if (framed > 0) {
+        relay(conn, framed, count);
+    }
+}
+
+// Hands the first size bytes of the read buffer to every subscriber and
+// moves the remaining tail into a fresh buffer. Subscriber queues are
+// limited by slice size, so a slice keeps the whole buffer alive only when
+// it fills a good part of it; a few records are copied out instead.
+void EventLoop::relay(Connection& conn, size_t size, size_t count) {
+    RecordSlice records;
+    bool copied = size <= conn.readCapacity / 4;
+    if (copied) {
+        std::shared_ptr<char[]> own(new char[size]);
+        std::memcpy(own.get(), conn.readBuffer.get(), size);
+        records.data = own.get();
+        records.buffer = std::move(own);
+    } else {
+        records.buffer = conn.readBuffer;
+        records.data = conn.readBuffer.get();
+    }
+    records.size = size;
+
+    size_t tail = conn.readSize - size;
+    if (copied && conn.readCapacity <= conn.nextCapacity * 2) {
+        // Not shared and not oversized: keep reading into it
+        std::memmove(conn.readBuffer.get(), conn.readBuffer.get() + size, tail);
+    } else if (tail > 0) {
+        size_t capacity = std::max(conn.nextCapacity, tail * 2);
+        std::shared_ptr<char[]> next(new char[capacity]);
+        std::memcpy(next.get(), conn.readBuffer.get() + size, tail);
+        conn.readBuffer = std::move(next);
+        conn.readCapacity = capacity;
+    } else {
+        conn.readBuffer.reset();
+    }
+    conn.readSize = tail;
+
+    bool quiet = m_server.options().quiet;
+    LogStore* store = m_server.store();
+    RelayMessage message;
+    message.senderId = conn.id;
+    message.count = count;
+    if (conn.binary) {
+        message.binary = records;
+        if (!quiet || store != nullptr || m_server.textClients().load() > 0) {
+            message.text = framesToText(records);
+        }
+    } else {
+        message.text = records;
+        if (m_server.binaryClients().load() > 0) {
+            message.binary = linesToFrames(records, uint32_t(conn.id));
+        }
+    }
+
+    if (store != nullptr) {
+        message.offset = store->append(message.text.data, message.text.size);
+    }
+    if (!quiet) {
+        echo(message.text);
+    }
+    m_server.broadcast(this, message);
+}
+
+// Write on server: one "Log: " line per record
+void EventLoop::echo(const RecordSlice& records) {
+    std::string out;
+    const char* p = records.data;
+    const char* end = records.data + records.size;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* next = newline ? newline + 1 : end;
+        out.append("Log: ").append(p, next - p);
+        p = next;
+    }
+    if (out.back() != '\n') out.push_back('\n');
+    std::cout << out;
+}
+
+void EventLoop::deliver(const RelayMessage& message) {
+    for (auto& entry : m_connections) {
+        Connection& conn = *entry.second;
+        if (conn.id == message.senderId) continue;
+        // A replay picks these up from the store
+        if (conn.replay || !conn.follows || message.offset < conn.liveFrom) continue;
+        if (conn.liveLevels != kAllLevels && !conn.binary) {
+            std::string kept;
+            LogStore::filterLines(message.text.data, message.text.size, conn.liveLevels, kept);
+            RelayMessage filtered = message;
+            filtered.count = std::count(kept.begin(), kept.end(), '\n');
+            filtered.text = makeSlice(std::move(kept));
+            enqueue(conn, filtered);
+            continue;
+        }
+        enqueue(conn, message);
+    }
+}
+
+void EventLoop::enqueue(Connection& conn, const RelayMessage& message) {
+    const ServerOptions& options = m_server.options();
+    const RecordSlice& records = conn.binary ? message.binary : message.text;
+    size_t size = records.size;
+    if (size == 0) return;
+
+    // While a spill is pending, new records go behind it to keep the order.
+    // An idle subscriber always takes the message, however large.
+    bool spilling = conn.spillRead != conn.spillWrite;
+    if (!spilling && (conn.outQueue.empty() || conn.queuedBytes + size <= options.maxQueueBytes)) {
+        sendDirect(conn, records);
+        return;
+    }
+
+    switch (options.stallPolicy) {
+    case StallPolicy::Spill:
+        if (spill(conn, records)) return;
+        break;
+    case StallPolicy::Disconnect:
+        if (std::find(m_stalled.begin(), m_stalled.end(), conn.fd) == m_stalled.end()) {
+            m_stalled.push_back(conn.fd);
+        }
+        break;
+    case StallPolicy::Drop:
+        break;
+    }
+    conn.droppedRecords += message.count;
+    conn.droppedBytes += size;
+    m_droppedRecords.fetch_add(message.count, std::memory_order_relaxed);
+    m_droppedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+// Queues a slice regardless of limits and starts sending if idle
+void EventLoop::sendDirect(Connection& conn, const RecordSlice& slice) {
+    bool wasIdle = conn.outQueue.empty();
+    conn.outQueue.push_back(slice);
+    conn.queuedBytes += slice.size;
+    if (wasIdle) {
+        flush(conn);
+    }
+}
+
+bool EventLoop::spill(Connection& conn, const RecordSlice& records) {
+    if (conn.spillFd == -1) {
+        std::string path = m_server.options().spillDir + "/log_server_spill_XXXXXX";
+        conn.spillFd = mkstemp(&path[0]);
+        if (conn.spillFd == -1) {
+            perror("spill file");
+            return false;
+        }
+        unlink(path.c_str());  // anonymous: vanishes with the descriptor
+    }
+
+    size_t done = 0;
+    while (done < records.size) {
+        ssize_t n = pwrite(conn.spillFd, records.data + done, records.size - done, conn.spillWrite + done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("spill write");
+            return false;
+        }
+        done += n;
+    }
+    conn.spillWrite += records.size;
+    conn.spilledBytes += records.size;
+    m_spilledBytes.fetch_add(records.size, std::memory_order_relaxed);
+    return true;
+}
+
+bool EventLoop::refillFromSpill(Connection& conn) {
+    if (conn.spillRead == conn.spillWrite) return false;
+
+    size_t size = std::min<uint64_t>(kSpillChunk, conn.spillWrite - conn.spillRead);
+    std::shared_ptr<char[]> chunk(new char[size]);
+    ssize_t n = pread(conn.spillFd, chunk.get(), size, conn.spillRead);
+    if (n <= 0) {
+        perror("spill read");
+        conn.spillRead = conn.spillWrite = 0;
+        return false;
+    }
+    conn.spillRead += n;
+    if (conn.spillRead == conn.spillWrite) {
+        // Fully replayed: reuse the file from the start
+        if (ftruncate(conn.spillFd, 0) < 0) {}
+        conn.spillRead = conn.spillWrite = 0;
+    }
+
+    RecordSlice slice;
+    slice.data = chunk.get();
+    slice.size = n;
+    slice.buffer = std::move(chunk);
+    conn.queuedBytes += slice.size;
+    conn.outQueue.push_back(std::move(slice));
+    return true;
+}
+
+// Next chunk of a store query; at the end of the store it switches the
+// connection to live records, or marks a one-shot query done
+bool EventLoop::refillFromReplay(Connection& conn) {
+    if (!conn.replay) return false;
+
+    std::string chunk;
+    if (!m_server.store()->read(*conn.replay, chunk, kSpillChunk)) {
+        uint64_t end = conn.replay->next;
+        conn.replay.reset();
+        chunk.append(conn.follows ? "#LGLIVE " : "#LGEND ").append(std::to_string(end)).push_back('\n');
+        if (conn.follows) conn.liveFrom = end;
+        else conn.closeWhenSent = true;
+    }
+    RecordSlice slice = makeSlice(std::move(chunk));
+    conn.queuedBytes += slice.size;
+    conn.outQueue.push_back(std::move(slice));
+    return true;
+}
+
+void EventLoop::resumeReplays() {
+    std::vector<int> resume;
+    resume.swap(m_resume);
+    for (int fd : resume) {
+        auto it = m_connections.find(fd);
+        if (it != m_connections.end()) flush(*it->second);
+    }
+}
+
+// Sends as many queued slices as the socket takes, up to kMaxIov per syscall
+void EventLoop::flush(Connection& conn) {
+    iovec iov[kMaxIov];
+    int replayed = 0;
+
+    for (;;) {
+        if (conn.outQueue.empty() && !refillFromSpill(conn)) {
+            if (conn.replay && ++replayed > kReplayBurst) {
+                // A fast reader would keep the loop here for the whole replay
+                m_resume.push_back(conn.fd);
+                uint64_t one = 1;
+                if (write(m_wakeFd, &one, sizeof(one)) < 0) {}
+                return;
+            }
+            if (!refillFromReplay(conn)) {
+                if (conn.closeWhenSent) {
+                    conn.closeWhenSent = false;
+                    shutdown(conn.fd, SHUT_WR);
+                }
+                return;
+            }
+        }
+
+        int count = 0;
+        for (auto it = conn.outQueue.begin(); it != conn.outQueue.end() && count < kMaxIov; ++it, ++count) {
+            size_t skip = count == 0 ? conn.outOffset : 0;
+            iov[count].iov_base = const_cast<char*>(it->data + skip);
+            iov[count].iov_len = it->size - skip;
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(conn.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            // Socket buffer is full: EPOLLOUT will resume the flush
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            // The peer is gone; let the read side notice and close it
+            conn.outQueue.clear();
+            conn.outOffset = 0;
+            conn.queuedBytes = 0;
+            conn.spillRead = conn.spillWrite = 0;
+            conn.replay.reset();
+            return;
+        }
+
+        conn.queuedBytes -= sent;
+        conn.sentBytes += sent;
+        size_t left = sent;
+        while (left > 0) {
+            size_t frontLeft = conn.outQueue.front().size - conn.outOffset;
+            if (left < frontLeft) {
+                conn.outOffset += left;
+                break;
+            }
+            left -= frontLeft;
+            conn.outQueue.pop_front();
+            conn.outOffset = 0;
+        }
+    }
+}
+
+void EventLoop::closeStalled() {
+    for (int fd : m_stalled) {
+        if (m_connections.find(fd) == m_connections.end()) continue;
+        if (!m_server.options().quiet) {
+            std::cout << "Client too slow, disconnecting.\n";
+        }
+        m_disconnects.fetch_add(1, std::memory_order_relaxed);
+        closeConnection(fd);
+    }
+    m_stalled.clear();
+}
+
+SubscriberCounters EventLoop::counters() const {
+    SubscriberCounters counters;
+    counters.droppedRecords = m_droppedRecords.load(std::memory_order_relaxed);
+    counters.droppedBytes = m_droppedBytes.load(std::memory_order_relaxed);
+    counters.spilledBytes = m_spilledBytes.load(std::memory_order_relaxed);
+    counters.disconnects = m_disconnects.load(std::memory_order_relaxed);
+    return counters;
+}
+
+void EventLoop::reportStats() {
+    std::ostringstream out;
+    out << "--- Subscriber queues (loop " << m_index << ") ---\n";
+    for (auto& entry : m_connections) {
+        const Connection& conn = *entry.second;
+        out << "client " << conn.id
+            << ": lag " << conn.queuedBytes << " B queued + " << (conn.spillWrite - conn.spillRead) << " B spilled"
+            << ", sent " << conn.sentBytes << " B"
+            << ", dropped " << conn.droppedRecords << " records (" << conn.droppedBytes << " B)"
+            << ", spilled total " << conn.spilledBytes << " B\n";
+    }
+    std::cout << out.str() << std::flush;
+}
+
+void EventLoop::drainInbox() {
+    {
+        std::lock_guard<std::mutex> lock(m_inboxMutex);
+        m_pending.swap(m_inbox);
+    }
+    for (const RelayMessage& message : m_pending) {
+        deliver(message);
+    }
+    m_pending.clear();
+}
+
+void EventLoop::closeConnection(int fd) {
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    auto it = m_connections.find(fd);
+    if (it != m_connections.end()) {
+        if (it->second->spillFd != -1) close(it->second->spillFd);
+        if (it->second->binary) m_server.binaryClients().fetch_sub(1);
+        else m_server.textClients().fetch_sub(1);
+    }
+    m_connections.erase(fd);
+    m_connectionCount.store(int(m_connections.size()), std::memory_order_relaxed);
+    close(fd);
+    if (!m_server.options().quiet) {
+        std::cout << "Client disconnected.\n";
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "log_server.hpp"
+#include "log_store.hpp"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Connection {
+    int fd = -1;
+    uint64_t id = 0;
+    bool binary = false;        // negotiated binary frames (both directions)
+    bool helloChecked = false;  // first bytes were checked for the hello line
+    bool broken = false;        // protocol error, close after this read
+
+    // Per-connection read buffer; complete records are handed off with it
+    // and only an unterminated tail is carried into the next buffer
+    std::shared_ptr<char[]> readBuffer;
+    size_t readCapacity = 0;
+    size_t readSize = 0;
+    size_t nextCapacity = 0;  // grows while reads keep filling the buffer, shrinks after short ones
+
+    std::deque<RecordSlice> outQueue;
+    size_t outOffset = 0;    // bytes of outQueue.front() already sent
+    size_t queuedBytes = 0;  // unsent bytes in outQueue
+
+    // Overflow file for StallPolicy::Spill; records are appended at
+    // spillWrite and replayed from spillRead once outQueue drains
+    int spillFd = -1;
+    uint64_t spillRead = 0;
+    uint64_t spillWrite = 0;
+
+    // Store query ("#LGQUERY" line): matching records are read from the
+    // store while replay is set; live records are skipped meanwhile and,
+    // once it ends, taken from liveFrom on, so nothing repeats or goes missing
+    std::unique_ptr<StoreCursor> replay;
+    bool follows = true;            // receives live records
+    uint64_t liveFrom = 0;          // store offsets below it were replayed
+    uint8_t liveLevels = kAllLevels;
+    bool closeWhenSent = false;     // one-shot query: send EOF after the replay
+
+    // Counters
+    uint64_t sentBytes = 0;
+    uint64_t droppedRecords = 0;
+    uint64_t droppedBytes = 0;
+    uint64_t spilledBytes = 0;
+};
+
+// One thread running an edge-triggered epoll loop. Owns its listening
+// socket and its connections; other threads talk to it only via post().
+class EventLoop {
+public:
+    EventLoop(LogServer& server, int index);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool listen(int port);
+    void start();
+    void stop();
+
+    // Thread-safe: queues a message for this loop's connections
+    void post(const RelayMessage& message);
+
+    // Loop thread only: relays a message to local connections
+    void deliver(const RelayMessage& message);
+
+    // Thread-safe
+    int connectionCount() const { return m_connectionCount.load(std::memory_order_relaxed); }
+    SubscriberCounters counters() const;
+
+private:
+    void run();
+    void acceptAll();
+    void readAll(Connection& conn);
+    void flush(Connection& conn);
+    void drainInbox();
+    void closeConnection(int fd);
+
+    void frameRecords(Connection& conn, size_t scanFrom);
+    bool checkHello(Connection& conn);
+    void frameLines(Connection& conn, size_t scanFrom);
+    void frameBinary(Connection& conn);
+    void sendDirect(Connection& conn, const RecordSlice& slice);
+    void relay(Connection& conn, size_t size, size_t count);
+    void echo(const RecordSlice& records);
+    void enqueue(Connection& conn, const RelayMessage& message);
+    bool spill(Connection& conn, const RecordSlice& records);
+    bool refillFromSpill(Connection& conn);
+    bool checkQuery(Connection& conn);
+    void startReplay(Connection& conn, std::string_view args);
+    bool refillFromReplay(Connection& conn);
+    void resumeReplays();
+    void closeStalled();
+    void reportStats();
+
+    LogServer& m_server;
+    int m_index;
+    int m_epoll = -1;
+    int m_listenFd = -1;
+    int m_wakeFd = -1;
+    int m_timerFd = -1;
+    std::thread m_thread;
+    std::atomic<bool> m_stopping{false};
+
+    std::unordered_map<int, std::unique_ptr<Connection>> m_connections;
+    std::atomic<int> m_connectionCount{0};  // m_connections.size() for other threads
+    // Totals of the per-connection counters, readable from other threads
+    std::atomic<uint64_t> m_droppedRecords{0};
+    std::atomic<uint64_t> m_droppedBytes{0};
+    std::atomic<uint64_t> m_spilledBytes{0};
+    std::atomic<uint64_t> m_disconnects{0};
+
+    std::vector<int> m_stalled;  // Disconnect policy: closed after delivery
+    std::vector<int> m_resume;   // replays that used up their burst, continued on wakeup
+
+    std::mutex m_inboxMutex;
+    std::vector<RelayMessage> m_inbox;
+    std::vector<RelayMessage> m_pending;  // loop-local swap buffer
+};
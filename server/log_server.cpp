@@ -0,0 +1,72 @@
+#include "log_server.hpp"
+#include "event_loop.hpp"
+#include "log_store.hpp"
+
+#include <algorithm>
+#include <thread>
+
+LogServer::LogServer(const ServerOptions& options)
+    : m_options(options)
+{
+    if (m_options.threads <= 0) {
+        m_options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+LogServer::~LogServer() {
+    stop();
+}
+
+bool LogServer::start() {
+    if (!m_options.storeDir.empty()) {
+        m_store = std::make_unique<LogStore>(m_options.storeDir, m_options.segmentBytes, m_options.keepSegments);
+        if (!m_store->open()) {
+            m_store.reset();
+            return false;
+        }
+    }
+    for (int i = 0; i < m_options.threads; ++i) {
+        auto loop = std::make_unique<EventLoop>(*this, i);
+        if (!loop->listen(m_options.port)) {
+            m_loops.clear();
+            return false;
+        }
+        m_loops.push_back(std::move(loop));
+    }
+    for (auto& loop : m_loops) {
+        loop->start();
+    }
+    return true;
+}
+
+void LogServer::stop() {
+    for (auto& loop : m_loops) {
+        loop->stop();
+    }
+    m_loops.clear();
+}
+
+std::vector<int> LogServer::connectionsPerLoop() const {
+    std::vector<int> counts;
+    for (const auto& loop : m_loops) counts.push_back(loop->connectionCount());
+    return counts;
+}
+
+SubscriberCounters LogServer::subscriberCounters() const {
+    SubscriberCounters total;
+    for (const auto& loop : m_loops) {
+        SubscriberCounters counters = loop->counters();
+        total.droppedRecords += counters.droppedRecords;
+        total.droppedBytes += counters.droppedBytes;
+        total.spilledBytes += counters.spilledBytes;
+        total.disconnects += counters.disconnects;
+    }
+    return total;
+}
+
+void LogServer::broadcast(EventLoop* from, const RelayMessage& message) {
+    for (auto& loop : m_loops) {
+        if (loop.get() == from) loop->deliver(message);
+        else loop->post(message);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class EventLoop;
+class LogStore;
+
+// What happens to a subscriber whose output queue is full
+enum class StallPolicy {
+    Drop,        // discard new records for it
+    Disconnect,  // close its connection
+    Spill        // queue the overflow in a temporary file and replay it
+};
+
+struct ServerOptions {
+    int port = 9999;
+    int threads = 0;      // event-loop threads, 0 = one per core
+    bool quiet = false;   // do not echo records and connection events
+
+    size_t maxQueueBytes = 4 << 20;   // per-subscriber in-memory output queue
+    StallPolicy stallPolicy = StallPolicy::Drop;
+    std::string spillDir = "/tmp";
+    int statsInterval = 0;            // seconds between subscriber reports, 0 = off
+
+    std::string storeDir;             // persistent record store (log_store.hpp), empty = off
+    size_t segmentBytes = 64 << 20;   // store segment file size
+    size_t keepSegments = 0;          // oldest segments are deleted beyond this, 0 = keep all
+};
+
+// Totals over all subscribers since start(), for monitoring and tests
+struct SubscriberCounters {
+    uint64_t droppedRecords = 0;
+    uint64_t droppedBytes = 0;
+    uint64_t spilledBytes = 0;
+    uint64_t disconnects = 0;  // closed by StallPolicy::Disconnect
+};
+
+// A run of complete newline-terminated records inside a reference-counted
+// buffer. Every subscriber queue holds a slice of the same buffer, so
+// records are copied at most once however many subscribers relay them.
+struct RecordSlice {
+    std::shared_ptr<const char[]> buffer;  // keeps the bytes alive
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+// Records read from one client, shared by every loop that relays them.
+// Carries the records in the sender's format and, if any connection
+// needs it, converted to the other one; an empty slice means "not needed".
+struct RelayMessage {
+    uint64_t senderId = 0;
+    RecordSlice text;
+    RecordSlice binary;
+    size_t count = 0;  // number of records
+    uint64_t offset = 0;  // store offset of the first record (with a store)
+};
+
+// Relay server: N epoll event loops, each with its own SO_REUSEPORT
+// listening socket, so the kernel spreads connections across loops.
+// Every record is relayed to all other connected clients, as text lines
+// or binary frames depending on what each client negotiated.
+class LogServer {
+public:
+    explicit LogServer(const ServerOptions& options);
+    ~LogServer();
+
+    LogServer(const LogServer&) = delete;
+    LogServer& operator=(const LogServer&) = delete;
+
+    // Binds the listening sockets and starts the loops; false on failure
+    bool start();
+    void stop();
+
+    const ServerOptions& options() const { return m_options; }
+
+    uint64_t nextConnectionId() { return m_nextId.fetch_add(1, std::memory_order_relaxed); }
+
+    // Hands a message to every loop (the caller's loop delivers it inline)
+    void broadcast(EventLoop* from, const RelayMessage& message);
+
+    // Open connections of each event loop
+    std::vector<int> connectionsPerLoop() const;
+
+    // Thread-safe sum over all loops
+    SubscriberCounters subscriberCounters() const;
+
+    // Null unless options().storeDir is set
+    LogStore* store() { return m_store.get(); }
+
+    // Connections per wire format, to skip conversions nobody needs
+    std::atomic<int>& textClients() { return m_textClients; }
+    std::atomic<int>& binaryClients() { return m_binaryClients; }
+
+private:
+    ServerOptions m_options;
+    std::unique_ptr<LogStore> m_store;
+    std::vector<std::unique_ptr<EventLoop>> m_loops;
+    std::atomic<uint64_t> m_nextId{1};
+    std::atomic<int> m_textClients{0};
+    std::atomic<int> m_binaryClients{0};
+};
@@ -0,0 +1,437 @@
+#include "log_store.hpp"
+#include "log_parser.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Index entry: first offset, position, bytes, min time, max time (8 bytes
+// each, host order), level bitmap (1), record count (4)
+static const size_t kEntrySize = 45;
+static const size_t kNameDigits = 20;
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, std::string& out, uint64_t from, uint64_t size) {
+    out.resize(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, &out[done], size - done, from + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            out.resize(done);
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+static bool timeFiltered(const StoreQuery& query) {
+    return query.since != INT64_MIN || query.until != INT64_MAX;
+}
+
+static bool lineMatches(std::string_view line, const StoreQuery& query) {
+    ParsedLine parsed;
+    if (!parseLogLine(line, parsed)) {
+        return (query.levels & kUnparsedBit) && !timeFiltered(query);
+    }
+    return (query.levels & (1u << int(parsed.level))) &&
+           parsed.epochSeconds >= query.since && parsed.epochSeconds <= query.until;
+}
+
+bool parseQuery(std::string_view args, StoreQuery& out, std::string& error) {
+    out = StoreQuery();
+    while (!args.empty()) {
+        size_t space = args.find(' ');
+        std::string_view token = args.substr(0, space);
+        args = space == std::string_view::npos ? std::string_view() : args.substr(space + 1);
+        if (token.empty()) continue;
+        if (token == "follow") {
+            out.follow = true;
+            continue;
+        }
+
+        size_t equals = token.find('=');
+        std::string_view key = token.substr(0, equals);
+        std::string value(equals == std::string_view::npos ? std::string_view() : token.substr(equals + 1));
+        char* end = nullptr;
+        errno = 0;
+        if (key == "level") {
+            LogLevel level;
+            if (!parser::parseLevel(value, level)) {
+                error = "unknown level " + value;
+                return false;
+            }
+            out.levels = uint8_t(0x0F & ~((1u << int(level)) - 1));
+            continue;
+        }
+        if (key == "from") {
+            out.from = std::strtoull(value.c_str(), &end, 10);
+        } else if (key == "since") {
+            out.since = std::strtoll(value.c_str(), &end, 10);
+        } else if (key == "until") {
+            out.until = std::strtoll(value.c_str(), &end, 10);
+        } else if (key == "last") {
+            long long amount = std::strtoll(value.c_str(), &end, 10);
+            int unit = 1;
+            if (end != value.c_str() && *end != '\0') {
+                unit = *end == 's' ? 1 : *end == 'm' ? 60 : *end == 'h' ? 3600 : 0;
+                if (unit != 0) ++end;
+            }
+            out.since = int64_t(std::time(nullptr)) - amount * unit;
+        } else {
+            error = "unknown argument " + std::string(token);
+            return false;
+        }
+        if (value.empty() || errno != 0 || *end != '\0') {
+            error = "bad value in " + std::string(token);
+            return false;
+        }
+    }
+    return true;
+}
+
+LogStore::Segment::~Segment() {
+    if (fd != -1) close(fd);
+    if (indexFd != -1) close(indexFd);
+}
+
+LogStore::LogStore(const std::string& dir, size_t segmentBytes, size_t keepSegments)
+    : m_dir(dir), m_segmentBytes(std::max<size_t>(segmentBytes, 4096)), m_keepSegments(keepSegments)
+{
+}
+
+LogStore::~LogStore() = default;
+
+std::string LogStore::pathOf(uint64_t base, const char* extension) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020llu%s", (unsigned long long)base, extension);
+    return m_dir + "/" + name;
+}
+
+bool LogStore::open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (mkdir(m_dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        perror("store directory");
+        return false;
+    }
+
+    DIR* dir = opendir(m_dir.c_str());
+    if (dir == nullptr) {
+        perror("store directory");
+        return false;
+    }
+    std::vector<uint64_t> bases;
+    while (dirent* entry = readdir(dir)) {
+        std::string_view name = entry->d_name;
+        if (name.size() != kNameDigits + 4 || name.substr(kNameDigits) != ".log") continue;
+        if (!std::all_of(name.begin(), name.begin() + kNameDigits, [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        bases.push_back(std::strtoull(std::string(name.substr(0, kNameDigits)).c_str(), nullptr, 10));
+    }
+    closedir(dir);
+    std::sort(bases.begin(), bases.end());
+
+    for (uint64_t base : bases) {
+        auto segment = openSegment(base);
+        if (!segment || !recover(*segment)) return false;
+        // Only the last segment takes appends; the others are sealed
+        if (!m_segments.empty()) writeIndex(*m_segments.back(), true);
+        m_segments.push_back(std::move(segment));
+    }
+    if (m_segments.empty()) {
+        auto segment = openSegment(0);
+        if (!segment) return false;
+        m_segments.push_back(std::move(segment));
+    }
+    return true;
+}
+
+std::shared_ptr<LogStore::Segment> LogStore::openSegment(uint64_t base) {
+    auto segment = std::make_shared<Segment>();
+    segment->base = base;
+    segment->path = pathOf(base, ".log");
+    segment->fd = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    segment->indexFd = ::open(pathOf(base, ".idx").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (segment->fd == -1 || segment->indexFd == -1) {
+        perror("store segment");
+        return nullptr;
+    }
+    return segment;
+}
+
+// Loads the index entries that agree with the data file, then rebuilds the
+// blocks after them (the open block, or everything if the index was lost)
+// by scanning the records, and cuts off a partially written last record
+bool LogStore::recover(Segment& segment) {
+    struct stat info{};
+    if (fstat(segment.fd, &info) < 0) return false;
+    uint64_t fileSize = uint64_t(info.st_size);
+
+    std::string index;
+    if (fstat(segment.indexFd, &info) == 0 && info.st_size > 0) {
+        readAll(segment.indexFd, index, 0, uint64_t(info.st_size));
+    }
+    uint64_t position = 0;
+    for (size_t at = 0; at + kEntrySize <= index.size(); at += kEntrySize) {
+        Block block;
+        const char* p = index.data() + at;
+        std::memcpy(&block.firstOffset, p, 8);
+        std::memcpy(&block.position, p + 8, 8);
+        std::memcpy(&block.bytes, p + 16, 8);
+        std::memcpy(&block.minTime, p + 24, 8);
+        std::memcpy(&block.maxTime, p + 32, 8);
+        block.levels = uint8_t(p[40]);
+        std::memcpy(&block.count, p + 41, 4);
+        if (block.firstOffset != segment.endOffset() || block.position != position || block.count == 0 ||
+            block.count > kBlockRecords || block.position + block.bytes > fileSize) {
+            break;
+        }
+        position += block.bytes;
+        segment.blocks.push_back(block);
+        segment.summary.minTime = std::min(segment.summary.minTime, block.minTime);
+        segment.summary.maxTime = std::max(segment.summary.maxTime, block.maxTime);
+        segment.summary.levels |= block.levels;
+    }
+    segment.indexedBlocks = segment.blocks.size();
+    if (ftruncate(segment.indexFd, off_t(segment.indexedBlocks * kEntrySize)) < 0) return false;
+
+    std::string rest;
+    readAll(segment.fd, rest, position, fileSize - position);
+    const char* p = rest.data();
+    const char* end = p + rest.size();
+    while (const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p))) {
+        addLine(segment, std::string_view(p, newline - p), uint64_t(newline + 1 - p));
+        p = newline + 1;
+    }
+    segment.size = position + uint64_t(p - rest.data());
+    if (segment.size != fileSize && ftruncate(segment.fd, off_t(segment.size)) < 0) return false;
+    writeIndex(segment, false);
+    return true;
+}
+
+void LogStore::addLine(Segment& segment, std::string_view line, uint64_t bytes) {
+    if (segment.blocks.empty() || segment.blocks.back().count == kBlockRecords) {
+        Block block;
+        block.firstOffset = segment.endOffset();
+        block.position = segment.blocks.empty() ? 0 : segment.blocks.back().position + segment.blocks.back().bytes;
+        segment.blocks.push_back(block);
+    }
+
+    uint8_t level = kUnparsedBit;
+    ParsedLine parsed;
+    Block& block = segment.blocks.back();
+    if (parseLogLine(line, parsed)) {
+        level = uint8_t(1u << int(parsed.level));
+        block.minTime = std::min(block.minTime, parsed.epochSeconds);
+        block.maxTime = std::max(block.maxTime, parsed.epochSeconds);
+        segment.summary.minTime = std::min(segment.summary.minTime, parsed.epochSeconds);
+        segment.summary.maxTime = std::max(segment.summary.maxTime, parsed.epochSeconds);
+    }
+    block.levels |= level;
+    block.bytes += bytes;
+    ++block.count;
+    segment.summary.levels |= level;
+}
+
+// Writes the entries of full blocks (all blocks when sealing the segment)
+void LogStore::writeIndex(Segment& segment, bool seal) {
+    std::string entries;
+    while (segment.indexedBlocks < segment.blocks.size()) {
+        const Block& block = segment.blocks[segment.indexedBlocks];
+        if (!seal && block.count < kBlockRecords) break;
+        char entry[kEntrySize];
+        std::memcpy(entry, &block.firstOffset, 8);
+        std::memcpy(entry + 8, &block.position, 8);
+        std::memcpy(entry + 16, &block.bytes, 8);
+        std::memcpy(entry + 24, &block.minTime, 8);
+        std::memcpy(entry + 32, &block.maxTime, 8);
+        entry[40] = char(block.levels);
+        std::memcpy(entry + 41, &block.count, 4);
+        entries.append(entry, kEntrySize);
+        ++segment.indexedBlocks;
+    }
+    if (!entries.empty() && !writeAll(segment.indexFd, entries.data(), entries.size())) {
+        perror("store index write");
+    }
+}
+
+void LogStore::rotate() {
+    Segment& active = *m_segments.back();
+    writeIndex(active, true);
+    auto segment = openSegment(active.endOffset());
+    if (!segment) return;  // keep appending to the full one
+    m_segments.push_back(std::move(segment));
+
+    while (m_keepSegments > 0 && m_segments.size() > m_keepSegments) {
+        unlink(m_segments.front()->path.c_str());
+        unlink(pathOf(m_segments.front()->base, ".idx").c_str());
+        m_segments.erase(m_segments.begin());
+    }
+}
+
+uint64_t LogStore::append(const char* data, size_t size) {
+    if (size == 0) return endOffset();
+    bool terminated = size > 0 && data[size - 1] == '\n';
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_segments.back()->size > 0 && m_segments.back()->size + size + 1 > m_segmentBytes) {
+        rotate();
+    }
+    Segment& segment = *m_segments.back();
+    uint64_t first = segment.endOffset();
+
+    // Records are indexed only once they are on file: a failed write (e.g.
+    // a full disk) is cut off again and leaves the store as it was
+    bool written = writeAll(segment.fd, data, size) && (terminated || writeAll(segment.fd, "\n", 1));
+    if (!written) {
+        perror("store write");
+        if (ftruncate(segment.fd, off_t(segment.size)) < 0) perror("store truncate");
+        return first;
+    }
+
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = newline ? newline : end;
+        addLine(segment, std::string_view(p, lineEnd - p), uint64_t(lineEnd - p) + 1);
+        p = lineEnd + 1;
+    }
+    segment.size += size + (terminated ? 0 : 1);
+    writeIndex(segment, false);
+    return first;
+}
+
+bool LogStore::matches(const Block& block, const StoreQuery& query) {
+    if ((block.levels & query.levels) == 0) return false;
+    return !timeFiltered(query) || (block.minTime <= query.until && block.maxTime >= query.since);
+}
+
+// Under m_mutex: the blocks after cursor.next that may match, about
+// maxBytes of them; blocks and segments that cannot match are skipped by
+// moving the cursor. Returns false when the store has nothing more.
+bool LogStore::collectBlocks(StoreCursor& cursor, size_t maxBytes, std::vector<PendingBlock>& out) const {
+    const StoreQuery& query = cursor.query;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    cursor.next = std::max({ cursor.next, query.from, m_segments.front()->base });
+    uint64_t next = cursor.next;  // past the blocks collected so far
+    size_t bytes = 0;
+
+    auto segmentIt = std::upper_bound(m_segments.begin(), m_segments.end(), next,
+                                      [](uint64_t offset, const auto& s) { return offset < s->base; });
+    if (segmentIt != m_segments.begin()) --segmentIt;
+    for (; segmentIt != m_segments.end(); ++segmentIt) {
+        const Segment& segment = **segmentIt;
+        if (segment.endOffset() <= next) continue;
+        if (!matches(segment.summary, query)) {
+            next = segment.endOffset();
+            if (out.empty()) cursor.next = next;
+            continue;
+        }
+
+        auto blockIt = std::upper_bound(segment.blocks.begin(), segment.blocks.end(), next,
+                                        [](uint64_t offset, const Block& b) { return offset < b.firstOffset; });
+        if (blockIt != segment.blocks.begin()) --blockIt;
+        for (; blockIt != segment.blocks.end(); ++blockIt) {
+            const Block& block = *blockIt;
+            uint64_t blockEnd = block.firstOffset + block.count;
+            if (blockEnd <= next) continue;
+            next = blockEnd;
+            if (!matches(block, query)) {
+                if (out.empty()) cursor.next = next;
+                continue;
+            }
+            // A copy: the open block keeps growing, the copy covers what is on file now
+            out.push_back({ *segmentIt, block });
+            bytes += block.bytes;
+            if (bytes >= maxBytes) return true;
+        }
+    }
+    return !out.empty();
+}
+
+// The index is consulted under the lock, the blocks are read without it,
+// so a slow disk does not hold up appends. A segment removed meanwhile
+// stays open until its last reader lets go of it.
+bool LogStore::read(StoreCursor& cursor, std::string& out, size_t maxBytes) {
+    const StoreQuery& query = cursor.query;
+    std::vector<PendingBlock> blocks;
+    for (;;) {
+        blocks.clear();
+        if (!collectBlocks(cursor, maxBytes - std::min(maxBytes, out.size()), blocks)) return false;
+
+        for (const PendingBlock& pending : blocks) {
+            const Block& block = pending.block;
+            uint64_t blockEnd = block.firstOffset + block.count;
+            ++cursor.blocksRead;
+            if (!readAll(pending.segment->fd, cursor.block, block.position, block.bytes)) {
+                perror("store read");
+                cursor.next = blockEnd;
+                continue;
+            }
+            const char* p = cursor.block.data();
+            const char* end = p + cursor.block.size();
+            for (uint64_t offset = block.firstOffset; offset < blockEnd && p < end; ++offset) {
+                const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                const char* next = newline ? newline + 1 : end;
+                if (offset >= cursor.next) {
+                    if (lineMatches(std::string_view(p, next - p - (newline ? 1 : 0)), query)) {
+                        out.append(p, next - p);
+                    }
+                    cursor.next = offset + 1;
+                    if (out.size() >= maxBytes) return true;
+                }
+                p = next;
+            }
+            cursor.next = blockEnd;
+        }
+    }
+}
+
+uint64_t LogStore::firstOffset() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segments.front()->base;
+}
+
+uint64_t LogStore::endOffset() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segments.back()->endOffset();
+}
+
+size_t LogStore::segmentCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segments.size();
+}
+
+void LogStore::filterLines(const char* data, size_t size, uint8_t levels, std::string& out) {
+    StoreQuery query;
+    query.levels = levels;
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* next = newline ? newline + 1 : end;
+        if (lineMatches(std::string_view(p, next - p - (newline ? 1 : 0)), query)) out.append(p, next - p);
+        p = next;
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Level bits in masks: Debug, Info, Warning, Error, then lines that are not
+// "<timestamp> [<Level>] ..." records (raw text from other producers)
+inline constexpr uint8_t kUnparsedBit = 1u << 4;
+inline constexpr uint8_t kAllLevels = 0x1F;
+
+// "#LGQUERY <args>\n" sent by a client selects stored records:
+//   from=<offset>      records at or after this store offset
+//   since=<unix time>  until=<unix time>  record timestamps, inclusive
+//   last=<N>[s|m|h]    since = now - N
+//   level=<Level>      this level and above
+//   follow             keep streaming live records after the replay
+struct StoreQuery {
+    uint64_t from = 0;
+    int64_t since = INT64_MIN;
+    int64_t until = INT64_MAX;
+    uint8_t levels = kAllLevels;
+    bool follow = false;
+};
+
+inline constexpr std::string_view kQueryCommand = "#LGQUERY";
+
+// Parses the arguments after kQueryCommand; false with a message on error
+bool parseQuery(std::string_view args, StoreQuery& out, std::string& error);
+
+// Where a replay is in the store; owned by the reading connection
+struct StoreCursor {
+    StoreQuery query;
+    uint64_t next = 0;          // next record offset to examine
+    uint64_t blocksRead = 0;    // blocks read from disk (the rest were skipped by the index)
+    std::string block;          // read buffer
+};
+
+// Append-only record store of the relay: records (as text lines) go into
+// segment files "<dir>/<first offset>.log", 20 digits so names sort by
+// offset. Every kBlockRecords records start a block; a sparse index
+// "<first offset>.idx" keeps per block its first offset, file position,
+// timestamp range and level bitmap, so a query reads only the blocks that
+// can match. Offsets count records from the first one ever stored.
+//
+// Thread-safe: event loops append and read concurrently; reads take the
+// lock only to look at the index. Nothing is fsync'ed; after a crash the
+// tail is rebuilt from the data files.
+class LogStore {
+public:
+    static constexpr uint32_t kBlockRecords = 128;
+
+    LogStore(const std::string& dir, size_t segmentBytes, size_t keepSegments);
+    ~LogStore();
+
+    LogStore(const LogStore&) = delete;
+    LogStore& operator=(const LogStore&) = delete;
+
+    // Opens the directory, recovering what is there; false on failure
+    bool open();
+
+    // Stores a run of newline-terminated lines (a missing last newline is
+    // added); returns the offset of the first
+    uint64_t append(const char* data, size_t size);
+
+    // Appends matching records (whole lines) to out until it holds about
+    // maxBytes; returns false once the cursor reached the end of the store
+    bool read(StoreCursor& cursor, std::string& out, size_t maxBytes);
+
+    uint64_t firstOffset() const;
+    uint64_t endOffset() const;
+    size_t segmentCount() const;
+
+    // Lines of a text slice that match levels, appended to out
+    static void filterLines(const char* data, size_t size, uint8_t levels, std::string& out);
+
+private:
+    struct Block {
+        uint64_t firstOffset = 0;
+        uint64_t position = 0;    // byte offset in the segment file
+        uint64_t bytes = 0;
+        int64_t minTime = INT64_MAX;
+        int64_t maxTime = INT64_MIN;
+        uint8_t levels = 0;
+        uint32_t count = 0;
+    };
+
+    struct Segment {
+        uint64_t base = 0;
+        std::string path;
+        int fd = -1;
+        int indexFd = -1;
+        uint64_t size = 0;
+        std::vector<Block> blocks;  // the last one is open while the segment is active
+        size_t indexedBlocks = 0;   // blocks already written to the index file
+        Block summary;              // over all blocks
+
+        ~Segment();
+        uint64_t endOffset() const { return blocks.empty() ? base : blocks.back().firstOffset + blocks.back().count; }
+    };
+
+    // A block to read, with the segment kept open for it
+    struct PendingBlock {
+        std::shared_ptr<const Segment> segment;
+        Block block;
+    };
+
+    std::shared_ptr<Segment> openSegment(uint64_t base);
+    bool collectBlocks(StoreCursor& cursor, size_t maxBytes, std::vector<PendingBlock>& out) const;
+    bool recover(Segment& segment);
+    static void addLine(Segment& segment, std::string_view line, uint64_t bytes);
+    void writeIndex(Segment& segment, bool seal);
+    void rotate();
+    static bool matches(const Block& block, const StoreQuery& query);
+    std::string pathOf(uint64_t base, const char* extension) const;
+
+    std::string m_dir;
+    size_t m_segmentBytes;
+    size_t m_keepSegments;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<Segment>> m_segments;  // by base offset; readers share them
+};
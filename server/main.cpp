@@ -1,108 +1,91 @@
-#include <iostream>
-#include <vector>
-#include <thread>
-#include <mutex>
-#include <algorithm>
-#include <cstring>
-#include <unistd.h>
-#include <deque>
-#include <netinet/in.h>
-#include <sys/socket.h>
-
-const int PORT = 9999;
-const int MAX_BUFFER = 1024;
+#include "log_server.hpp"
+#include "log_store.hpp"
 
-std::vector<int> client_fds;
-std::mutex clients_mutex;
-
-//Retranslation tool for stat collecting
-void broadcastToOthers(int sender_fd, const std::string& message) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    for (int fd : client_fds) {
-        if (fd != sender_fd) {
-            send(fd, message.c_str(), message.size(), 0);
-        }
-    }
+#include <csignal>
+#include <iostream>
+#include <pthread.h>
+#include <stdexcept>
+#include <string>
+
+StallPolicy StringToStallPolicy(const std::string& s) {
+    if (s == "drop") return StallPolicy::Drop;
+    if (s == "disconnect") return StallPolicy::Disconnect;
+    if (s == "spill") return StallPolicy::Spill;
+    throw std::invalid_argument("Only drop, disconnect or spill stall policies");
 }
 
-void handleClient(int client_fd) {
-    char buffer[MAX_BUFFER];
-
-    while (true) {
-        ssize_t bytesRead = read(client_fd, buffer, MAX_BUFFER - 1);
-        if (bytesRead <= 0) {
-            break;
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+
+            if (arg == "--port" && i + 1 < argc) {
+                options.port = std::stoi(argv[++i]);
+            }
+            else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = std::stoi(argv[++i]);
+            }
+            else if (arg == "--quiet") {
+                options.quiet = true;
+            }
+            else if (arg == "--max-queue-kb" && i + 1 < argc) {
+                options.maxQueueBytes = std::stoul(argv[++i]) * 1024;
+            }
+            else if (arg == "--on-stall" && i + 1 < argc) {
+                options.stallPolicy = StringToStallPolicy(argv[++i]);
+            }
+            else if (arg == "--spill-dir" && i + 1 < argc) {
+                options.spillDir = argv[++i];
+            }
+            else if (arg == "--stats-interval" && i + 1 < argc) {
+                options.statsInterval = std::stoi(argv[++i]);
+            }
+            else if (arg == "--store" && i + 1 < argc) {
+                options.storeDir = argv[++i];
+            }
+            else if (arg == "--segment-mb" && i + 1 < argc) {
+                options.segmentBytes = std::stoul(argv[++i]) << 20;
+            }
+            else if (arg == "--keep-segments" && i + 1 < argc) {
+                options.keepSegments = std::stoul(argv[++i]);
+            }
+            else {
+                throw std::invalid_argument("Unknown parameter: " + arg);
+            }
         }
-
-        buffer[bytesRead] = '\0';
-        std::string message(buffer);
-
-        // Write on server
-        std::cout << "Log: " << message;
-
-        // Broadcast to everyone else
-        broadcastToOthers(client_fd, message);
-    }
-
-    // Close and delete a client
-    {
-        std::lock_guard<std::mutex> lock(clients_mutex);
-        client_fds.erase(std::remove(client_fds.begin(), client_fds.end(), client_fd), client_fds.end());
-    }
-
-    close(client_fd);
-    std::cout << "Client disconnected.\n";
-}
-
-int main() {
-    int server_fd;
-    sockaddr_in server_addr{};
-    int opt = 1;
-
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == -1) {
-        perror("socket");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        std::cerr << "Use example:\n"
+                  << argv[0] << " --port 9999 --threads 4 [--quiet] [--max-queue-kb 4096]"
+                  << " [--on-stall drop|disconnect|spill] [--spill-dir /tmp] [--stats-interval 10]"
+                  << " [--store DIR] [--segment-mb 64] [--keep-segments 0]\n";
         return 1;
     }
 
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;  // 0.0.0.0
-    server_addr.sin_port = htons(PORT);
+    // Event loops inherit the mask, so only sigwait below sees these
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
 
-    if (bind(server_fd, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("bind");
+    LogServer server(options);
+    if (!server.start()) {
         return 1;
     }
 
-    if (listen(server_fd, 10) < 0) {
-        perror("listen");
-        return 1;
+    std::cout << "Server runs at " << options.port << " (" << server.options().threads << " event loops)\n";
+    if (LogStore* store = server.store()) {
+        std::cout << "Store " << options.storeDir << ": records " << store->firstOffset() << ".."
+                  << store->endOffset() << " in " << store->segmentCount() << " segment(s)\n";
     }
 
-    std::cout << "Server runs at " << PORT << "\n";
-
-    while (true) {
-        sockaddr_in client_addr{};
-        socklen_t client_len = sizeof(client_addr);
-
-        int client_fd = accept(server_fd, (sockaddr*)&client_addr, &client_len);
-        if (client_fd < 0) {
-            perror("accept");
-            continue;
-        }
-
-        std::cout << "New client connected!\n";
-
-        {
-            std::lock_guard<std::mutex> lock(clients_mutex);
-            client_fds.push_back(client_fd);
-        }
-
-        std::thread(handleClient, client_fd).detach();
-    }
+    int received = 0;
+    sigwait(&signals, &received);
 
-    close(server_fd);
+    server.stop();
+    std::cout << "Server stopped.\n";
     return 0;
 }
@@ -0,0 +1,67 @@
+#include "record_format.hpp"
+#include "logger.hpp"
+#include "wire_protocol.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+RecordSlice makeSlice(std::string&& bytes) {
+    auto owner = std::make_shared<std::string>(std::move(bytes));
+    RecordSlice slice;
+    slice.data = owner->data();
+    slice.size = owner->size();
+    slice.buffer = std::shared_ptr<const char[]>(owner, owner->data());
+    return slice;
+}
+
+RecordSlice framesToText(const RecordSlice& frames) {
+    std::string out;
+    out.reserve(frames.size + frames.size / 2);
+
+    size_t pos = 0;
+    while (pos < frames.size) {
+        size_t size = wire::completeFrame(frames.data + pos, frames.size - pos);
+        if (size == 0 || size == SIZE_MAX) break;
+        wire::Record record = wire::decodeFrame(frames.data + pos);
+        pos += size;
+
+        if (record.level != wire::kLevelText) {
+            char stamp[kMaxTimestampLength];
+            auto time = std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(record.timestampNs)));
+            out.append(stamp, formatTimestamp(time, TimestampOptions(), stamp));
+            out.append(" [").append(levelName(LogLevel(record.level))).append("] ");
+        }
+        out.append(record.message).push_back('\n');
+    }
+    return makeSlice(std::move(out));
+}
+
+RecordSlice linesToFrames(const RecordSlice& lines, uint32_t sourceId) {
+    std::string out;
+    out.reserve(lines.size + lines.size / 2);
+
+    const char* p = lines.data;
+    const char* end = lines.data + lines.size;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = newline ? newline : end;
+
+        // A runaway line relayed without its newline may be longer than a
+        // frame can carry: it goes out as several frames
+        wire::Record record;
+        record.level = wire::kLevelText;
+        record.sourceId = sourceId;
+        do {
+            size_t size = std::min<size_t>(lineEnd - p, wire::kMaxMessage);
+            record.message = std::string_view(p, size);
+            wire::appendFrame(out, record);
+            p += size;
+        } while (p < lineEnd);
+
+        p = newline ? newline + 1 : end;
+    }
+    return makeSlice(std::move(out));
+}
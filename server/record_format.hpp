@@ -0,0 +1,17 @@
+#pragma once
+
+#include "log_server.hpp"
+
+#include <string>
+
+// Conversions between the two relay formats (see wire_protocol.hpp).
+// Only done when a connection of the other format is present.
+
+// Takes ownership of bytes as a shareable slice
+RecordSlice makeSlice(std::string&& bytes);
+
+// Binary frames -> "<timestamp> [<Level>] <message>\n" lines
+RecordSlice framesToText(const RecordSlice& frames);
+
+// Text lines -> frames of level wire::kLevelText carrying each whole line
+RecordSlice linesToFrames(const RecordSlice& lines, uint32_t sourceId);
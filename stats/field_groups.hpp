@@ -0,0 +1,243 @@
+#pragma once
+
+// Aggregation by a field Logger appends to messages as " key=value" pairs
+// (see logger/log_fields.hpp): records are counted per distinct value of
+// one key, and optionally a numeric field is summed per group.
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Value of key in message; quoted values come without the quotes (escapes
+// are kept). The last occurrence wins, since fields follow the free text.
+// Quoted values are skipped whole, so "key=" inside one does not count.
+inline bool findField(std::string_view message, std::string_view key, std::string_view& value) {
+    if (key.empty()) return false;
+    bool found = false;
+    size_t size = message.size();
+    size_t pos = 0;
+    while (pos < size) {
+        // pos is at the start of a word
+        size_t wordEnd = std::min(message.find(' ', pos), size);
+        size_t equals = message.find('=', pos);
+        size_t next = wordEnd;
+        if (equals < wordEnd && equals > pos) {
+            size_t start = equals + 1;
+            std::string_view text;
+            if (start < size && message[start] == '"') {
+                size_t end = start + 1;
+                while (end < size && message[end] != '"') end += message[end] == '\\' ? 2 : 1;
+                end = std::min(end, size);
+                text = message.substr(start + 1, end - start - 1);
+                next = end + 1;
+            } else {
+                text = message.substr(start, wordEnd - start);
+            }
+            if (message.compare(pos, equals - pos, key) == 0) {
+                value = text;
+                found = true;
+            }
+        }
+        pos = next;
+        while (pos < size && message[pos] == ' ') ++pos;
+    }
+    return found;
+}
+
+namespace json {
+
+// Unescapes the JSON string starting at p (on the opening quote) into out;
+// returns the position after the closing quote, or nullptr
+inline const char* readString(const char* p, const char* end, std::string& out) {
+    for (++p; p < end; ++p) {
+        char c = *p;
+        if (c == '"') return p + 1;
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        if (++p == end) return nullptr;
+        switch (*p) {
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'u': {
+            // Logger escapes control characters only; anything wider is kept as '?'
+            unsigned code = 0;
+            if (end - p < 5 || std::from_chars(p + 1, p + 5, code, 16).ptr != p + 5) return nullptr;
+            out.push_back(code < 0x80 ? char(code) : '?');
+            p += 4;
+            break;
+        }
+        default: out.push_back(*p); break;  // '"', '\\', '/'
+        }
+    }
+    return nullptr;
+}
+
+inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+}
+
+// Rewrites one JSON-lines record (FileFormat::JsonLines) as the text line
+// Logger would have written for it: "<time> [<Level>] <message> key=value..."
+// so it can go through parseLogLine and findField. False when the line is
+// not a flat JSON object with "time" and "level".
+inline bool jsonLineToText(std::string_view line, std::string& out) {
+    out.clear();
+    // Reused per thread: no allocations once warm
+    thread_local std::string time, level, message, fields, key, text;
+    time.clear();
+    level.clear();
+    message.clear();
+    fields.clear();
+    const char* p = json::skipSpaces(line.data(), line.data() + line.size());
+    const char* end = line.data() + line.size();
+    if (p == end || *p++ != '{') return false;
+    for (;;) {
+        p = json::skipSpaces(p, end);
+        if (p < end && *p == '}') break;
+        key.clear();
+        if (p == end || *p != '"' || (p = json::readString(p, end, key)) == nullptr) return false;
+        p = json::skipSpaces(p, end);
+        if (p == end || *p++ != ':') return false;
+        p = json::skipSpaces(p, end);
+        if (p == end) return false;
+
+        bool quoted = *p == '"';
+        text.clear();
+        if (quoted) {
+            if ((p = json::readString(p, end, text)) == nullptr) return false;
+        } else {
+            // Numbers, true, false, null: copied as they are
+            const char* start = p;
+            while (p < end && *p != ',' && *p != '}' && *p != ' ') ++p;
+            text.assign(start, p - start);
+        }
+
+        if (key == "time") time = text;
+        else if (key == "level") level = text;
+        else if (key == "message") message = text;
+        else {
+            fields.push_back(' ');
+            fields.append(key).push_back('=');
+            // Strings are quoted when they have to be, as in the text format
+            if (quoted && (text.empty() || text.find_first_of(" \"=\\\n\t") != std::string::npos)) {
+                fields.push_back('"');
+                for (char c : text) {
+                    if (c == '"' || c == '\\') fields.push_back('\\');
+                    if (c == '\n') { fields.append("\\n"); continue; }
+                    fields.push_back(c);
+                }
+                fields.push_back('"');
+            } else {
+                fields.append(text);
+            }
+        }
+
+        p = json::skipSpaces(p, end);
+        if (p < end && *p == ',') ++p;
+        else if (p == end || *p != '}') return false;
+    }
+    if (time.empty() || level.empty()) return false;
+    out.append(time).append(" [").append(level).append("] ").append(message).append(fields);
+    return true;
+}
+
+inline bool parseNumber(std::string_view text, double& out) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, out);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+struct GroupTotals {
+    uint64_t count = 0;
+    uint64_t summed = 0;  // records in the group that had a numeric sum field
+    double sum = 0;
+
+    void merge(const GroupTotals& other) {
+        count += other.count;
+        summed += other.summed;
+        sum += other.sum;
+    }
+};
+
+// Per-shard table of groups. Distinct values beyond kMaxGroups are folded
+// into kOtherGroup, so a high-cardinality key (e.g. a request id) cannot
+// grow it without bound.
+class FieldGroups {
+public:
+    static constexpr size_t kMaxGroups = 10000;
+    static constexpr std::string_view kOtherGroup = "(other)";
+
+    void add(std::string_view group, bool hasNumber, double number) {
+        m_key.assign(group.data(), group.size());  // lookup buffer, allocation-free once warm
+        auto it = m_groups.find(m_key);
+        if (it == m_groups.end()) {
+            if (m_groups.size() >= kMaxGroups) m_key.assign(kOtherGroup.data(), kOtherGroup.size());
+            it = m_groups.emplace(m_key, Group()).first;
+        }
+        Group& entry = it->second;
+        GroupTotals& totals = entry.totals;
+        ++totals.count;
+        if (hasNumber) {
+            ++totals.summed;
+            totals.sum += number;
+        }
+        if (!entry.changed) {
+            entry.changed = true;
+            m_changed.push_back(&*it);
+        }
+    }
+
+    void mergeInto(std::unordered_map<std::string, GroupTotals>& out) const {
+        for (const auto& [group, entry] : m_groups) out[group].merge(entry.totals);
+    }
+
+    // Brings a copy that is two calls behind (or empty, for the first two
+    // calls) up to date, touching only groups changed since. Meant for
+    // double-buffered publishing: each copy is updated every other call.
+    void publishTo(std::unordered_map<std::string, GroupTotals>& copy) {
+        for (const auto* group : m_previousChanged) copy[group->first] = group->second.totals;
+        for (auto* group : m_changed) {
+            copy[group->first] = group->second.totals;
+            group->second.changed = false;
+        }
+        m_previousChanged.swap(m_changed);
+        m_changed.clear();
+    }
+
+private:
+    struct Group {
+        GroupTotals totals;
+        bool changed = false;  // listed in m_changed
+    };
+    using Entry = std::pair<const std::string, Group>;  // node addresses are stable
+
+    std::unordered_map<std::string, Group> m_groups;
+    std::string m_key;
+    std::vector<Entry*> m_changed;          // since the last publishTo()
+    std::vector<Entry*> m_previousChanged;  // by the publishTo() before it
+};
+
+// Groups ordered by count, largest first (ties by name), at most limit
+inline std::vector<std::pair<std::string, GroupTotals>> largestGroups(
+    const std::unordered_map<std::string, GroupTotals>& groups, size_t limit) {
+    std::vector<std::pair<std::string, GroupTotals>> out(groups.begin(), groups.end());
+    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
+        return a.second.count != b.second.count ? a.second.count > b.second.count : a.first < b.first;
+    });
+    if (out.size() > limit) out.resize(limit);
+    return out;
+}
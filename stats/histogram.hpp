@@ -0,0 +1,92 @@
+#pragma once
+
+// HDR-style histogram over uint64 values: exact below kSubBuckets, then every
+// power of two is split into kSubBuckets equal buckets, so a quantile is
+// within ~1/kSubBuckets of the true value. Fixed size, and merging is
+// bucket-wise addition (shards, or histograms shipped from other nodes).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class LogHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr uint64_t kSubBuckets = 1u << kSubBits;
+    static constexpr size_t kBuckets = kSubBuckets + (64 - kSubBits) * kSubBuckets;
+
+    static size_t bucketOf(uint64_t value) {
+        if (value < kSubBuckets) return size_t(value);
+        int exponent = 63 - __builtin_clzll(value);
+        uint64_t sub = (value >> (exponent - kSubBits)) & (kSubBuckets - 1);
+        return size_t(kSubBuckets + uint64_t(exponent - kSubBits) * kSubBuckets + sub);
+    }
+
+    // Smallest value that falls into the bucket
+    static uint64_t lowerBound(size_t bucket) {
+        if (bucket < kSubBuckets) return bucket;
+        uint64_t exponent = (bucket - kSubBuckets) / kSubBuckets + kSubBits;
+        uint64_t sub = (bucket - kSubBuckets) % kSubBuckets;
+        return (kSubBuckets + sub) << (exponent - kSubBits);
+    }
+
+    static uint64_t upperBound(size_t bucket) {
+        return bucket + 1 < kBuckets ? lowerBound(bucket + 1) - 1 : UINT64_MAX;
+    }
+
+    void record(uint64_t value, uint64_t count = 1) {
+        m_counts[bucketOf(value)] += count;
+        m_total += count;
+    }
+
+    void addBucket(size_t bucket, uint64_t count) {
+        m_counts[bucket] += count;
+        m_total += count;
+    }
+
+    void merge(const LogHistogram& other) {
+        for (size_t i = 0; i < kBuckets; ++i) m_counts[i] += other.m_counts[i];
+        m_total += other.m_total;
+    }
+
+    uint64_t count() const { return m_total; }
+    uint64_t bucketCount(size_t bucket) const { return m_counts[bucket]; }
+
+    // Midpoint of the bucket holding the q-th value (0 <= q <= 1); 0 when empty
+    uint64_t quantile(double q) const {
+        if (m_total == 0) return 0;
+        uint64_t rank = uint64_t(q * double(m_total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += m_counts[i];
+            if (seen >= rank) {
+                uint64_t low = lowerBound(i);
+                return low + (upperBound(i) - low) / 2;
+            }
+        }
+        return upperBound(kBuckets - 1);
+    }
+
+private:
+    uint64_t m_counts[kBuckets] = {};
+    uint64_t m_total = 0;
+};
+
+// The same buckets with a single writer and readers on other threads
+class AtomicLogHistogram {
+public:
+    void record(uint64_t value) {
+        auto& count = m_counts[LogHistogram::bucketOf(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void addTo(LogHistogram& out) const {
+        for (size_t i = 0; i < LogHistogram::kBuckets; ++i) {
+            uint64_t count = m_counts[i].load(std::memory_order_relaxed);
+            if (count != 0) out.addBucket(i, count);
+        }
+    }
+
+private:
+    std::atomic<uint64_t> m_counts[LogHistogram::kBuckets] = {};
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+// Allocation-free scanner for the line layout Logger emits:
+//   "YYYY-MM-DD HH:MM:SS[.frac] [Level] message"
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+
+enum class LogLevel {
+    Debug = 0,
+    Info,
+    Warning,
+    Error
+};
+
+struct ParsedLine {
+    int64_t epochSeconds = 0;  // the local timestamp converted to Unix time
+    LogLevel level = LogLevel::Info;
+    std::string_view message;
+};
+
+namespace parser {
+
+inline bool digits(const char* p, int count, int& value) {
+    value = 0;
+    for (int i = 0; i < count; ++i) {
+        unsigned d = (unsigned char)p[i] - '0';
+        if (d > 9) return false;
+        value = value * 10 + int(d);
+    }
+    return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's algorithm)
+inline int64_t daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Offset of local time from UTC at the given local wall-clock time.
+// mktime (and the TZ database behind it) runs once per distinct hour.
+inline int64_t localOffset(int64_t wallSeconds) {
+    thread_local int64_t cachedHour = INT64_MIN;
+    thread_local int64_t cachedOffset = 0;
+
+    int64_t hour = wallSeconds / 3600 - (wallSeconds % 3600 < 0);
+    if (hour != cachedHour) {
+        std::time_t t = std::time_t(hour * 3600);
+        std::tm tm{};
+        gmtime_r(&t, &tm);  // broken-down wall clock of that hour
+        tm.tm_isdst = -1;
+        cachedOffset = hour * 3600 - int64_t(std::mktime(&tm));
+        cachedHour = hour;
+    }
+    return cachedOffset;
+}
+
+inline bool parseLevel(std::string_view name, LogLevel& level) {
+    switch (name.size()) {
+    case 4:
+        if (name == "Info") { level = LogLevel::Info; return true; }
+        return false;
+    case 5:
+        if (name == "Debug") { level = LogLevel::Debug; return true; }
+        if (name == "Error") { level = LogLevel::Error; return true; }
+        return false;
+    case 7:
+        if (name == "Warning") { level = LogLevel::Warning; return true; }
+        return false;
+    default:
+        return false;
+    }
+}
+
+}
+
+// Returns false for lines that are not Logger records
+inline bool parseLogLine(std::string_view line, ParsedLine& out) {
+    using namespace parser;
+
+    const char* p = line.data();
+    size_t size = line.size();
+    if (size < 19 + 4) return false;  // timestamp + " [X]"
+
+    int year, month, day, hour, minute, second;
+    if (!digits(p, 4, year) || p[4] != '-' || !digits(p + 5, 2, month) || p[7] != '-' ||
+        !digits(p + 8, 2, day) || p[10] != ' ' || !digits(p + 11, 2, hour) || p[13] != ':' ||
+        !digits(p + 14, 2, minute) || p[16] != ':' || !digits(p + 17, 2, second)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    size_t pos = 19;
+    if (p[pos] == '.') {
+        ++pos;
+        while (pos < size && unsigned((unsigned char)p[pos] - '0') <= 9) ++pos;
+    }
+    if (pos + 2 > size || p[pos] != ' ' || p[pos + 1] != '[') return false;
+    pos += 2;
+
+    const char* close = static_cast<const char*>(std::memchr(p + pos, ']', size - pos));
+    if (close == nullptr) return false;
+    if (!parseLevel(std::string_view(p + pos, close - (p + pos)), out.level)) return false;
+    pos = close - p + 1;
+
+    // "] message"; a record may also end right after the level tag
+    if (pos < size && p[pos] == ' ') ++pos;
+    out.message = line.substr(pos);
+
+    int64_t wall = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    out.epochSeconds = wall - localOffset(wall);
+    return true;
+}
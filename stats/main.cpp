@@ -2,9 +2,16 @@
 
 #include <iostream>
 #include <string>
-#include <map>
-#include <regex>
+#include <iomanip>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
@@ -12,25 +19,11 @@
 #include <atomic>
 #include <mutex>
 #include <chrono>
-#include <sstream>
-#include <iomanip>
 #include <stdexcept>
-
-enum class LogLevel {
-    Debug = 0,
-    Info,
-    Warning,
-    Error
-};
-
-LogLevel StringToLevel(std::string s){ 
-    if (s == "Info") return LogLevel::Info;
-    if (s == "Error") return LogLevel::Error;
-    if (s == "Debug") return LogLevel::Debug;
-    if (s == "Warning") return LogLevel::Warning;
-    else throw std::invalid_argument("Only Debug, Info, Warning or Error strings"); 
-    //only these strings because we know the log format
-}
+#include "log_parser.hpp"
+#include "stats_core.hpp"
+#include "timestamp.hpp"
+#include "wire_protocol.hpp"
 
 std::string LevelToString(LogLevel level){ 
     switch (level)
@@ -46,88 +39,194 @@ std::string LevelToString(LogLevel level){
 }
 
 
-// Global statistics
-std::map<LogLevel, int> logStats;
-int log_total = 0;
-int min_len = -1;
-int max_len = -1;
-int total_len = 0;
-
+// Global statistics: counters are sharded per ingesting thread (one for now)
+StatsAggregator stats;
+std::atomic<uint64_t> printedTotal(0);  // stats.total at the last report
 
-bool changed = false;
-std::deque<std::chrono::system_clock::time_point> recentLogs;
-std::mutex statsMutex;
+std::mutex printMutex;
 std::atomic<bool> running(true);
-int sinceLastMessage = 0;
+thread_local int sinceLastMessage = 0;
 
 int N = 8;
 int T = 10;
+int topK = 5;  // templates reported per level, 0 turns the sketch off
+bool fileMode = false;  // --file: no echo, no arrival times, one report at the end
+std::string groupBy;    // --group-by: field key to count records by
+std::string sumField;   // --sum: numeric field key summed per group
+const size_t kGroupRows = 20;
+
+// Template counts at the previous report, for per-cycle rates
+std::unordered_map<uint64_t, uint64_t> previousTemplateCounts[kLevelCount];
+std::chrono::steady_clock::time_point previousReport = std::chrono::steady_clock::now();
+
+void printTopTemplates() {
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::max(std::chrono::duration<double>(now - previousReport).count(), 1e-3);
+    previousReport = now;
+
+    // Rates need a live feed; a file report must not depend on how fast it was read
+    if (fileMode) std::cout << "Top templates (count):\n";
+    else std::cout << "Top templates (count, per second since the last report):\n";
+    for (size_t i = 0; i < kLevelCount; ++i) {
+        std::vector<HeavyHitter> top = stats.topTemplates(LogLevel(i), topK);
+        if (top.empty()) continue;
+
+        std::unordered_map<uint64_t, uint64_t> counts;
+        std::cout << "  " << LevelToString(LogLevel(i)) << ":\n";
+        for (const HeavyHitter& hitter : top) {
+            auto previous = previousTemplateCounts[i].find(hitter.hash);
+            uint64_t before = previous == previousTemplateCounts[i].end() ? 0 : previous->second;
+            uint64_t delta = hitter.count > before ? hitter.count - before : 0;
+            std::cout << "    " << hitter.count;
+            if (hitter.error > 0) std::cout << " (+-" << hitter.error << ")";
+            if (!fileMode) {
+                std::cout << "  " << std::fixed << std::setprecision(2) << delta / seconds << std::defaultfloat << "/s";
+            }
+            std::cout << "  " << hitter.text << '\n';
+            counts[hitter.hash] = hitter.count;
+        }
+        previousTemplateCounts[i] = std::move(counts);
+    }
+}
 
-void removeOldLogs() {
-    auto oneHourAgo = std::chrono::system_clock::now() - std::chrono::hours(1);
+// Windows reported next to the totals
+const int64_t kWindows[] = {60, 5 * 60, 60 * 60};
+const char* const kWindowNames[] = {"1m", "5m", "1h"};
 
+// Quantiles reported per level
+const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+LevelHistograms histograms;  // printStats scratch, guarded by printMutex
 
-    // Remove from the front until all old entries are gone
-    while (!recentLogs.empty() && recentLogs.front()< oneHourAgo) {
-        recentLogs.pop_front();
+void printQuantiles(const char* title, const LogHistogram (&byLevel)[kLevelCount], uint64_t divisor) {
+    if (std::all_of(std::begin(byLevel), std::end(byLevel), [](const LogHistogram& h) { return h.count() == 0; })) {
+        return;  // e.g. inter-arrival times in --file mode
+    }
+    std::cout << title << " p50/p90/p99/p999:\n";
+    for (size_t i = 0; i < kLevelCount; ++i) {
+        if (byLevel[i].count() == 0) continue;
+        std::cout << "  " << LevelToString(LogLevel(i)) << ":";
+        const char* separator = " ";
+        for (double q : kQuantiles) {
+            std::cout << separator << byLevel[i].quantile(q) / divisor;
+            separator = " / ";
+        }
+        std::cout << '\n';
     }
 }
 
+// Records without the group key are counted under "(none)"; without
+// --group-by everything falls into one group
+void recordGroup(std::string_view message, StatsShard& shard) {
+    std::string_view group;
+    if (groupBy.empty()) group = "(all)";
+    else if (!findField(message, groupBy, group)) group = "(none)";
+
+    std::string_view text;
+    double number = 0;
+    bool hasNumber = !sumField.empty() && findField(message, sumField, text) && parseNumber(text, number);
+    shard.recordGroup(group, hasNumber, number);
+}
 
-void updateStats(const std::string& line) {
-    // Seeking Level label: "[Info]", "[Error]" etc
-    std::regex pattern(R"((\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2}) \[(Debug|Info|Warning|Error)\])");
-    std::smatch match;
-    size_t pos = line.find(']')+2;
-
-    if (std::regex_search(line, match, pattern)) {
-        changed = true;
-        std::cout << line << std::endl;
-        std::string datetimeStr = match[1].str();
-        std::string level = match[2].str();
-
-        std::lock_guard<std::mutex> lock(statsMutex);
-        std::tm tm = {};
-        std::istringstream ss(datetimeStr);
-        ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-        auto timestamp = std::chrono::system_clock::from_time_t(std::mktime(&tm));
-        recentLogs.push_back(timestamp);
-
-        std::string message = line.substr(pos, std::string::npos);
-        int len = message.size();
-        if (len > 0){
-            total_len += len;
-            if (min_len < 0){
-                min_len = len;
-                max_len = len;
-            }
-            else{
-                min_len = std::min(min_len, len);
-                max_len = std::max(max_len, len);
-            }
+void printGroups() {
+    std::cout << "By " << (groupBy.empty() ? "all records" : groupBy) << " (count";
+    if (!sumField.empty()) std::cout << ", sum/avg " << sumField;
+    std::cout << "):\n";
+    std::cout << std::setprecision(6);  // the rates above leave it at 2 digits
+    for (const auto& [group, totals] : largestGroups(stats.groups(), kGroupRows)) {
+        std::cout << "  " << group << ": " << totals.count;
+        if (!sumField.empty() && totals.summed > 0) {
+            std::cout << ", " << totals.sum << " / " << totals.sum / double(totals.summed);
         }
+        std::cout << '\n';
+    }
+}
 
-        logStats[StringToLevel(level)]++;
-        log_total++;
-        
-        sinceLastMessage++;
+void recordStats(std::chrono::system_clock::time_point timestamp, LogLevel level, std::string_view message,
+                 StatsShard& shard = stats.shard(0)) {
+    size_t len = message.size();
+    int64_t second = std::chrono::duration_cast<std::chrono::seconds>(timestamp.time_since_epoch()).count();
+    uint64_t arrivalNs = fileMode ? 0 : std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    shard.record(level, len, second, arrivalNs);
+    if (topK > 0) shard.recordTemplate(level, message);
+    if (!groupBy.empty() || !sumField.empty()) recordGroup(message, shard);
+    sinceLastMessage++;
+}
+
+void updateStats(std::string_view line, StatsShard& shard = stats.shard(0)) {
+    // JSON lines (FileFormat::JsonLines) are read as the text line they stand for
+    thread_local std::string converted;
+    std::string_view text = line;
+    if (!line.empty() && line[0] == '{' && jsonLineToText(line, converted)) text = converted;
+
+    ParsedLine parsed;
+    if (parseLogLine(text, parsed)) {
+        if (!fileMode) std::cout << line << '\n';
+        auto timestamp = std::chrono::system_clock::from_time_t(std::time_t(parsed.epochSeconds));
+        recordStats(timestamp, parsed.level, parsed.message, shard);
     }
 }
 
+// Binary wire format: fields arrive already parsed
+void updateStats(const wire::Record& record) {
+    if (record.level == wire::kLevelText) {
+        updateStats(record.message);  // relayed from a text producer
+        return;
+    }
+    if (record.level > static_cast<uint8_t>(LogLevel::Error)) return;
+
+    LogLevel level = static_cast<LogLevel>(record.level);
+    auto timestamp = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(record.timestampNs)));
+
+    char stamp[kMaxTimestampLength];
+    size_t stampLength = formatTimestamp(timestamp, TimestampOptions(), stamp);
+    std::cout << std::string_view(stamp, stampLength) << " [" << LevelToString(level) << "] "
+              << record.message << '\n';
+
+    recordStats(timestamp, level, record.message);
+}
+
 void printStats(){
-    std::lock_guard<std::mutex> lock(statsMutex);
-    removeOldLogs();
+    std::lock_guard<std::mutex> lock(printMutex);
+    StatsSnapshot snapshot = stats.snapshot();
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    WindowCounts windows[std::size(kWindows)];
+    for (size_t w = 0; w < std::size(kWindows); ++w) windows[w] = stats.window(now, kWindows[w]);
+
     std::cout << "\n--- Log statistics ---\n";
-    std::cout << "Total Messages: "  << log_total << std::endl;
-    for (const auto& [level, count] : logStats) {
-        std::cout << LevelToString(level) << ": " << count << std::endl;
+    std::cout << "Total Messages: "  << snapshot.total << std::endl;
+    for (size_t i = 0; i < kLevelCount; ++i) {
+        std::cout << LevelToString(LogLevel(i)) << ": " << snapshot.levels[i] << std::endl;
+    }
+    std::cout << "Recent messages: "  << windows[std::size(kWindows) - 1].total() << std::endl;
+    for (size_t w = 0; w < std::size(kWindows); ++w) {
+        std::cout << "Last " << kWindowNames[w] << ": " << windows[w].total() << " ("
+                  << std::fixed << std::setprecision(2) << double(windows[w].total()) / kWindows[w]
+                  << std::defaultfloat << "/s)";
+        for (size_t i = 0; i < kLevelCount; ++i) {
+            std::cout << ", " << LevelToString(LogLevel(i)) << " " << windows[w].levels[i];
+        }
+        std::cout << std::endl;
+    }
+    if (snapshot.minLength == UINT64_MAX) {
+        std::cout << "Largest length: -1\nSmallest length: -1" << std::endl;
+    } else {
+        std::cout << "Largest length: "  << snapshot.maxLength << std::endl;
+        std::cout << "Smallest length: "  << snapshot.minLength << std::endl;
+    }
+    if (snapshot.total > 0) {
+        std::cout << "Average length: " << snapshot.totalLength / snapshot.total << std::endl;
     }
-    std::cout << "Recent messages: "  << recentLogs.size() << std::endl;
-    std::cout << "Largest length: "  << max_len << std::endl;
-    std::cout << "Smallest length: "  << min_len << std::endl;
-    std::cout << "Average length: " << (int)(total_len/log_total) << std::endl;
-    std::cout << "------------------------\n\n";
-    changed = false;    
+    stats.histograms(histograms);
+    printQuantiles("Length", histograms.length, 1);
+    printQuantiles("Inter-arrival (us)", histograms.interArrivalNs, 1000);
+    if (topK > 0) printTopTemplates();
+    if (!groupBy.empty() || !sumField.empty()) printGroups();
+    std::cout << "------------------------\n\n" << std::flush;
+    printedTotal = snapshot.total;
 }
 
 
@@ -135,7 +234,7 @@ void printStats(){
 void printThread() {
     while (running) {
         std::this_thread::sleep_for(std::chrono::seconds(T));
-        if (not changed) continue;       
+        if (stats.snapshot().total == printedTotal) continue;
         printStats();       
     }
 }
@@ -149,6 +248,96 @@ bool isNumber(const std::string& s) {
     return true;
 }
 
+// A newline-aligned piece of a mapped log file
+struct FileChunk {
+    const char* begin;
+    const char* end;
+};
+
+// Maps every file and splits it into chunks that start and end on line
+// boundaries; the mappings stay alive until the process exits
+bool mapFiles(const std::vector<std::string>& files, size_t chunksPerFile, std::vector<FileChunk>& chunks) {
+    for (const std::string& file : files) {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Cannot open " << file << ": " << std::strerror(errno) << "\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            std::cerr << "Cannot stat " << file << ": " << std::strerror(errno) << "\n";
+            close(fd);
+            return false;
+        }
+        size_t size = size_t(st.st_size);
+        if (size == 0) {
+            close(fd);
+            continue;
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Cannot map " << file << ": " << std::strerror(errno) << "\n";
+            return false;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+
+        const char* data = static_cast<const char*>(mapped);
+        const char* fileEnd = data + size;
+        size_t step = std::max<size_t>(size / chunksPerFile, 1 << 20);
+        const char* begin = data;
+        while (begin < fileEnd) {
+            const char* end = begin + std::min<size_t>(step, fileEnd - begin);
+            if (end < fileEnd) {
+                const char* newline = static_cast<const char*>(std::memchr(end, '\n', fileEnd - end));
+                end = newline == nullptr ? fileEnd : newline + 1;
+            }
+            chunks.push_back({begin, end});
+            begin = end;
+        }
+    }
+    return true;
+}
+
+void scanChunk(const FileChunk& chunk, StatsShard& shard) {
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+        const char* lineEnd = newline == nullptr ? chunk.end : newline;
+        if (lineEnd > p) updateStats(std::string_view(p, lineEnd - p), shard);
+        p = lineEnd + 1;
+    }
+}
+
+// Offline mode: parse the files on all threads, each into its own shard,
+// then print the merged stats once
+int analyzeFiles(const std::vector<std::string>& files, unsigned threads) {
+    fileMode = true;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    stats = StatsAggregator(threads);
+
+    std::vector<FileChunk> chunks;
+    if (!mapFiles(files, size_t(threads) * 4, chunks)) return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextChunk(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            StatsShard& shard = stats.shard(t);
+            for (size_t i; (i = nextChunk.fetch_add(1)) < chunks.size();) scanChunk(chunks[i], shard);
+            shard.publish();
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printStats();
+    std::cerr << "Parsed " << stats.snapshot().total << " records on " << threads << " threads in "
+              << std::fixed << std::setprecision(2) << seconds << " s\n";
+    return 0;
+}
+
 int safeStoi(const std::string& s, int minVal, int maxVal) {
     if (!isNumber(s)) {
         throw std::invalid_argument(s + "is not a number");
@@ -165,6 +354,10 @@ int main(int argc, char* argv[]) {
     int port = 9999;
     int N = 5;
     int T = 10;
+    bool binary = false;
+    std::string replay;  // store query sent before the live stream
+    std::vector<std::string> files;
+    int threads = 0;
 
     try {
         for (int i = 1; i < argc; ++i) {
@@ -182,6 +375,27 @@ int main(int argc, char* argv[]) {
             else if (arg == "-T" && i + 1 < argc) {
                 T = safeStoi(argv[++i], 2, 3600);
             }
+            else if (arg == "--top" && i + 1 < argc) {
+                topK = safeStoi(argv[++i], 0, int(SpaceSaving::kCapacity));
+            }
+            else if (arg == "--file" && i + 1 < argc) {
+                files.push_back(argv[++i]);
+            }
+            else if (arg == "--threads" && i + 1 < argc) {
+                threads = safeStoi(argv[++i], 1, 1024);
+            }
+            else if (arg == "--group-by" && i + 1 < argc) {
+                groupBy = argv[++i];
+            }
+            else if (arg == "--sum" && i + 1 < argc) {
+                sumField = argv[++i];
+            }
+            else if (arg == "--binary") {
+                binary = true;
+            }
+            else if (arg == "--replay" && i + 1 < argc) {
+                replay = argv[++i];
+            }
             else {
                 throw std::invalid_argument("Unknown parameter: " + arg);
             }
@@ -190,25 +404,26 @@ int main(int argc, char* argv[]) {
         // Проверка итоговых значений
         if (T <= 1) throw std::invalid_argument("T must be > 1");
         if (N <= 0) throw std::invalid_argument("N must be > 0");
+        if (binary && !replay.empty()) throw std::invalid_argument("--replay works in text mode only");
 
-        std::cout << "Host: " << host << "\n";
-        std::cout << "Port: " << port << "\n";
-        std::cout << "N: " << N << "\n";
-        std::cout << "T: " << T << "\n";
+        if (files.empty()) {
+            std::cout << "Host: " << host << "\n";
+            std::cout << "Port: " << port << "\n";
+            std::cout << "N: " << N << "\n";
+            std::cout << "T: " << T << "\n";
+        }
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
         std::cerr << "Use examplre:\n"
-                  << argv[0] << " --host 127.0.0.1 --port 9999 -N 5 -T 10\n";
+                  << argv[0] << " --host 127.0.0.1 --port 9999 -N 5 -T 10 [--top 5] [--binary]"
+                  << " [--group-by KEY] [--sum KEY] [--replay \"last=10m level=Error\"]\n"
+                  << "   or: " << argv[0] << " --file app.log [--file ...] [--threads N] [--top 5]"
+                  << " [--group-by KEY] [--sum KEY]\n";
         return 1;
     }
 
-
-
-    logStats[LogLevel::Info] = 0;
-    logStats[LogLevel::Debug] = 0;
-    logStats[LogLevel::Warning] = 0;
-    logStats[LogLevel::Error] = 0;
+    if (!files.empty()) return analyzeFiles(files, threads);
 
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == -1) {
@@ -230,39 +445,84 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Connected. Start getting logs...\n\n";
 
+    // Ask for binary frames; until the server accepts, everything is text
+    // (a server without binary support never does, so we stay in text mode)
+    bool binaryMode = false;
+    if (binary) {
+        send(sock, wire::kHelloBinary.data(), wire::kHelloBinary.size(), MSG_NOSIGNAL);
+    }
+    // History from the server's store first, then live records after it
+    if (!replay.empty()) {
+        std::string query = "#LGQUERY " + replay + " follow\n";
+        send(sock, query.data(), query.size(), MSG_NOSIGNAL);
+    }
+
     // Run stat output stream
     std::thread statsThread(printThread);
 
-    // Buffer for reading
-    char buffer[4096];
-    std::string leftover;  // if the connection is broken
+    // Received bytes not yet parsed; records are scanned in place
+    std::vector<char> buffer(64 * 1024);
+    size_t used = 0;
+    size_t pos = 0;
+
+    auto afterRecord = [&]() {
+        if (sinceLastMessage >= N){
+            sinceLastMessage = 0;
+            stats.shard(0).publish();  // this thread owns the shard
+            printStats();
+        }
+    };
 
     while (running) {
-        ssize_t n = recv(sock, buffer, sizeof(buffer) - 1, 0);
+        // Move the unparsed tail to the front, then read after it
+        if (pos > 0) {
+            std::memmove(buffer.data(), buffer.data() + pos, used - pos);
+            used -= pos;
+            pos = 0;
+        }
+        if (used == buffer.size()) buffer.resize(buffer.size() * 2);  // record longer than the buffer
+        ssize_t n = recv(sock, buffer.data() + used, buffer.size() - used, 0);
         if (n <= 0) {
             std::cerr << "Connection lost\n";
             break;
         }
-
-        buffer[n] = '\0';
-        std::string data = leftover + buffer;
-
-        // Break into lines
-        size_t pos = 0;
-        std::string line;
-        while ((pos = data.find('\n')) != std::string::npos) {
-            line = data.substr(0, pos);
-            
-            if (!line.empty()) {
-                updateStats(line);
-                if (sinceLastMessage >= N){
-                    sinceLastMessage = 0;
-                    printStats();
+        used += n;
+
+        const char* base = buffer.data();
+        if (!binaryMode) {
+            // Break into lines (memchr is vectorized in libc)
+            const char* end;
+            while ((end = static_cast<const char*>(std::memchr(base + pos, '\n', used - pos))) != nullptr) {
+                std::string_view line(base + pos, end - (base + pos));
+                pos = end - base + 1;
+
+                if (binary && line.size() + 1 == wire::kHelloAccept.size() &&
+                    wire::kHelloAccept.compare(0, line.size(), line) == 0) {
+                    binaryMode = true;
+                    break;
+                }
+                if (!replay.empty() && line.rfind("#LG", 0) == 0) {
+                    std::cout << line << '\n';  // end of the replay, or why it failed
+                }
+                if (!line.empty()) {
+                    updateStats(line);
+                    afterRecord();
+                }
+            }
+        }
+        if (binaryMode) {
+            size_t size;
+            while ((size = wire::completeFrame(base + pos, used - pos)) != 0) {
+                if (size == SIZE_MAX) {
+                    std::cerr << "Invalid frame from server\n";
+                    running = false;
+                    break;
                 }
+                updateStats(wire::decodeFrame(base + pos));
+                afterRecord();
+                pos += size;
             }
-            data.erase(0, pos + 1);
         }
-        leftover = data;  // leftover with no \n
     }
 
     running = false;
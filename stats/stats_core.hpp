@@ -0,0 +1,354 @@
+#pragma once
+
+// Aggregated log statistics split into shards, one per ingesting thread or
+// connection. A shard has a single writer and is read by snapshot() without
+// locks: a per-shard sequence counter lets the reader retry on a torn read
+// instead of stopping ingestion. Template and group tables are too large for
+// that and are published to the reader as copies (DoubleBuffer).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "field_groups.hpp"
+#include "histogram.hpp"
+#include "log_parser.hpp"
+#include "top_k.hpp"
+
+inline constexpr size_t kLevelCount = size_t(LogLevel::Error) + 1;
+
+// Per-level record counts inside a time window
+struct WindowCounts {
+    uint64_t levels[kLevelCount] = {};
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (uint64_t count : levels) sum += count;
+        return sum;
+    }
+
+    void merge(const WindowCounts& other) {
+        for (size_t i = 0; i < kLevelCount; ++i) levels[i] += other.levels[i];
+    }
+};
+
+// Ring of per-second buckets keyed by record time (Unix seconds): constant
+// memory and O(1) record() whatever the traffic. Windows up to kSeconds can
+// be queried at once. Single writer; readers tolerate a bucket being reused
+// under them by skipping it.
+class RateWindow {
+public:
+    static constexpr int64_t kSeconds = 3600;
+
+    RateWindow() : m_buckets(new Bucket[kSeconds]) {}
+
+    void record(int64_t second, LogLevel level) {
+        Bucket& bucket = m_buckets[index(second)];
+        int64_t current = bucket.second.load(std::memory_order_relaxed);
+        if (current != second) {
+            if (current > second) return;  // older than the ring reaches
+            bucket.second.store(kReusing, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (auto& count : bucket.levels) count.store(0, std::memory_order_relaxed);
+            bucket.second.store(second, std::memory_order_release);
+        }
+        auto& count = bucket.levels[size_t(level)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Records stamped within (now - seconds, now]
+    WindowCounts count(int64_t now, int64_t seconds) const {
+        WindowCounts out;
+        if (seconds > kSeconds) seconds = kSeconds;
+        for (int64_t second = now - seconds + 1; second <= now; ++second) {
+            const Bucket& bucket = m_buckets[index(second)];
+            if (bucket.second.load(std::memory_order_acquire) != second) continue;
+            uint64_t levels[kLevelCount];
+            for (size_t i = 0; i < kLevelCount; ++i) levels[i] = bucket.levels[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (bucket.second.load(std::memory_order_relaxed) != second) continue;
+            for (size_t i = 0; i < kLevelCount; ++i) out.levels[i] += levels[i];
+        }
+        return out;
+    }
+
+private:
+    static constexpr int64_t kReusing = INT64_MIN;
+
+    struct Bucket {
+        std::atomic<int64_t> second{INT64_MIN + 1};
+        std::atomic<uint64_t> levels[kLevelCount] = {};
+    };
+
+    static size_t index(int64_t second) {
+        int64_t slot = second % kSeconds;
+        return size_t(slot < 0 ? slot + kSeconds : slot);
+    }
+
+    std::unique_ptr<Bucket[]> m_buckets;
+};
+
+// A value its owner thread keeps writing and another thread reads without
+// locks. There are two copies: the owner updates the one not being read and
+// then makes it current. The reader marks the copy it is on; the owner never
+// waits for it but skips that publish and tries again later. One reader at
+// a time.
+template <typename T>
+class DoubleBuffer {
+public:
+    // Owner only: update(T&) brings the stale copy up to date and makes it
+    // current. False, without calling update, while the reader holds it.
+    template <typename Update>
+    bool publish(Update&& update) {
+        int back = 1 - m_front.load(std::memory_order_relaxed);
+        if (m_reading.load() == back) return false;
+        update(m_values[back]);
+        m_front.store(back);
+        return true;
+    }
+
+    template <typename Read>
+    void read(Read&& read) const {
+        int front;
+        do {
+            front = m_front.load();
+            m_reading.store(front);
+        } while (m_front.load() != front);  // flipped in between: the owner may be writing it
+        read(m_values[front]);
+        m_reading.store(-1, std::memory_order_release);
+    }
+
+private:
+    T m_values[2];
+    std::atomic<int> m_front{0};
+    mutable std::atomic<int> m_reading{-1};  // copy the reader is on, -1 = none
+};
+
+// Distribution sketches per level, merged over shards
+struct LevelHistograms {
+    LogHistogram length[kLevelCount];
+    LogHistogram interArrivalNs[kLevelCount];  // gaps between arrivals within one shard
+};
+
+struct StatsSnapshot {
+    uint64_t levels[kLevelCount] = {};
+    uint64_t total = 0;
+    uint64_t totalLength = 0;
+    uint64_t minLength = UINT64_MAX;  // UINT64_MAX while no non-empty message was seen
+    uint64_t maxLength = 0;
+
+    void merge(const StatsSnapshot& other) {
+        for (size_t i = 0; i < kLevelCount; ++i) levels[i] += other.levels[i];
+        total += other.total;
+        totalLength += other.totalLength;
+        if (other.minLength < minLength) minLength = other.minLength;
+        if (other.maxLength > maxLength) maxLength = other.maxLength;
+    }
+};
+
+class StatsShard {
+public:
+    // Called only by the shard's owner thread; second is the record's Unix
+    // time, arrivalNs a monotonic clock reading taken when it was received
+    void record(LogLevel level, size_t length, int64_t second, uint64_t arrivalNs) {
+        uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);  // odd: update in progress
+        std::atomic_thread_fence(std::memory_order_release);
+
+        bump(m_levels[size_t(level)], 1);
+        bump(m_total, 1);
+        if (length > 0) {
+            bump(m_totalLength, length);
+            if (length < m_minLength.load(std::memory_order_relaxed))
+                m_minLength.store(length, std::memory_order_relaxed);
+            if (length > m_maxLength.load(std::memory_order_relaxed))
+                m_maxLength.store(length, std::memory_order_relaxed);
+        }
+
+        m_seq.store(seq + 2, std::memory_order_release);
+        m_window.record(second, level);
+
+        size_t index = size_t(level);
+        m_length[index].record(length);
+        if (m_lastArrivalNs[index] != 0 && arrivalNs >= m_lastArrivalNs[index]) {
+            m_interArrivalNs[index].record(arrivalNs - m_lastArrivalNs[index]);
+        }
+        m_lastArrivalNs[index] = arrivalNs;
+    }
+
+    // Safe from any thread; retries while the owner is mid-update
+    StatsSnapshot snapshot() const {
+        StatsSnapshot out;
+        for (;;) {
+            uint64_t before = m_seq.load(std::memory_order_acquire);
+            if (before & 1) continue;
+
+            for (size_t i = 0; i < kLevelCount; ++i) out.levels[i] = m_levels[i].load(std::memory_order_relaxed);
+            out.total = m_total.load(std::memory_order_relaxed);
+            out.totalLength = m_totalLength.load(std::memory_order_relaxed);
+            out.minLength = m_minLength.load(std::memory_order_relaxed);
+            out.maxLength = m_maxLength.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_seq.load(std::memory_order_relaxed) == before) return out;
+        }
+    }
+
+    // Owner thread. The summary is the owner's alone; the printer reads a
+    // copy published every kPublishEvery records, on the first record after
+    // it asked for a fresher one, or by publish().
+    void recordTemplate(LogLevel level, std::string_view message) {
+        char text[kMaxTemplateLength];
+        size_t size = normalizeTemplate(message, text);
+        m_templates.levels[size_t(level)].add(text, size);
+        if (++m_templatesPending >= kPublishEvery || m_templatesWanted.load(std::memory_order_relaxed)) {
+            publishTemplates();
+        }
+    }
+
+    // One reader at a time
+    void collectTemplates(LogLevel level, std::vector<HeavyHitter>& out) const {
+        m_publishedTemplates.read([&](const LevelTemplates& templates) { templates.levels[size_t(level)].collect(out); });
+        m_templatesWanted.store(true, std::memory_order_relaxed);
+    }
+
+    // Owner thread, for --group-by / --sum; published like the templates
+    void recordGroup(std::string_view group, bool hasNumber, double number) {
+        m_groups.add(group, hasNumber, number);
+        if (++m_groupsPending >= kPublishEvery || m_groupsWanted.load(std::memory_order_relaxed)) {
+            publishGroups();
+        }
+    }
+
+    // One reader at a time
+    void collectGroups(std::unordered_map<std::string, GroupTotals>& out) const {
+        m_publishedGroups.read([&](const std::unordered_map<std::string, GroupTotals>& groups) {
+            for (const auto& [group, totals] : groups) out[group].merge(totals);
+        });
+        m_groupsWanted.store(true, std::memory_order_relaxed);
+    }
+
+    // Owner thread (or any thread once the owner is done): makes everything
+    // recorded so far visible to collect*(), unless the reader is mid-read
+    void publish() {
+        publishTemplates();
+        publishGroups();
+    }
+
+    WindowCounts window(int64_t now, int64_t seconds) const { return m_window.count(now, seconds); }
+
+    void addHistograms(LevelHistograms& out) const {
+        for (size_t i = 0; i < kLevelCount; ++i) {
+            m_length[i].addTo(out.length[i]);
+            m_interArrivalNs[i].addTo(out.interArrivalNs[i]);
+        }
+    }
+
+private:
+    static constexpr uint32_t kPublishEvery = 4096;
+
+    struct LevelTemplates {
+        SpaceSaving levels[kLevelCount];
+    };
+
+    // A skipped publish leaves the counters as they are, so the next record retries
+    void publishTemplates() {
+        if (m_templatesPending == 0) return;
+        if (!m_publishedTemplates.publish([&](LevelTemplates& copy) { copy = m_templates; })) return;
+        m_templatesPending = 0;
+        m_templatesWanted.store(false, std::memory_order_relaxed);
+    }
+
+    void publishGroups() {
+        if (m_groupsPending == 0) return;
+        if (!m_publishedGroups.publish([&](std::unordered_map<std::string, GroupTotals>& copy) {
+                m_groups.publishTo(copy);
+            })) {
+            return;
+        }
+        m_groupsPending = 0;
+        m_groupsWanted.store(false, std::memory_order_relaxed);
+    }
+
+    // Single writer, so a plain load/store pair is enough (no locked RMW)
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    alignas(64) std::atomic<uint64_t> m_seq{0};
+    std::atomic<uint64_t> m_levels[kLevelCount] = {};
+    std::atomic<uint64_t> m_total{0};
+    std::atomic<uint64_t> m_totalLength{0};
+    std::atomic<uint64_t> m_minLength{UINT64_MAX};
+    std::atomic<uint64_t> m_maxLength{0};
+    RateWindow m_window;
+    AtomicLogHistogram m_length[kLevelCount];
+    AtomicLogHistogram m_interArrivalNs[kLevelCount];
+    uint64_t m_lastArrivalNs[kLevelCount] = {};  // owner only
+
+    // Owner only
+    LevelTemplates m_templates;
+    FieldGroups m_groups;
+    uint32_t m_templatesPending = 0;  // records since the last publish
+    uint32_t m_groupsPending = 0;
+
+    DoubleBuffer<LevelTemplates> m_publishedTemplates;
+    DoubleBuffer<std::unordered_map<std::string, GroupTotals>> m_publishedGroups;
+    alignas(64) mutable std::atomic<bool> m_templatesWanted{false};  // set by the reader
+    mutable std::atomic<bool> m_groupsWanted{false};
+};
+
+class StatsAggregator {
+public:
+    explicit StatsAggregator(size_t shards = 1)
+        : m_count(shards == 0 ? 1 : shards), m_shards(new Padded[m_count]) {}
+
+    size_t shardCount() const { return m_count; }
+    StatsShard& shard(size_t index) { return m_shards[index].shard; }
+
+    StatsSnapshot snapshot() const {
+        StatsSnapshot out;
+        for (size_t i = 0; i < m_count; ++i) out.merge(m_shards[i].shard.snapshot());
+        return out;
+    }
+
+    WindowCounts window(int64_t now, int64_t seconds) const {
+        WindowCounts out;
+        for (size_t i = 0; i < m_count; ++i) out.merge(m_shards[i].shard.window(now, seconds));
+        return out;
+    }
+
+    // The k most frequent templates of a level over all shards
+    std::vector<HeavyHitter> topTemplates(LogLevel level, size_t k) const {
+        std::vector<HeavyHitter> all;
+        for (size_t i = 0; i < m_count; ++i) m_shards[i].shard.collectTemplates(level, all);
+        return topHitters(std::move(all), k);
+    }
+
+    std::unordered_map<std::string, GroupTotals> groups() const {
+        std::unordered_map<std::string, GroupTotals> out;
+        for (size_t i = 0; i < m_count; ++i) m_shards[i].shard.collectGroups(out);
+        return out;
+    }
+
+    // Large (two histograms per level); callers keep one around rather than
+    // putting it on the stack
+    void histograms(LevelHistograms& out) const {
+        out = LevelHistograms();
+        for (size_t i = 0; i < m_count; ++i) m_shards[i].shard.addHistograms(out);
+    }
+
+private:
+    // Keeps neighbouring shards' counters off each other's cache lines
+    struct alignas(64) Padded {
+        StatsShard shard;
+    };
+
+    size_t m_count;
+    std::unique_ptr<Padded[]> m_shards;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+// Heavy-hitter message templates: messages are normalized (numbers, hex and
+// quoted tokens masked) and counted with the Space-Saving algorithm, which
+// keeps kCapacity counters and reports every template whose frequency is
+// above total / kCapacity, with a known overestimate ("error") per counter.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline constexpr size_t kMaxTemplateLength = 120;
+
+namespace templates {
+
+inline bool isDigit(char c) { return unsigned(c - '0') <= 9; }
+
+inline bool isHex(char c) { return isDigit(c) || unsigned((c | 0x20) - 'a') <= 5; }
+
+inline bool isWordChar(char c) {
+    return isDigit(c) || unsigned((c | 0x20) - 'a') <= 25 || c == '_';
+}
+
+}
+
+// Writes the template of message into out (up to kMaxTemplateLength bytes)
+// and returns its length:
+//   "user 42 got 0x7ffd12 for 'abc'"  ->  "user <n> got <hex> for <str>"
+// A word is masked as a whole when it is a number (digits, optionally with
+// '.', '-' or ':' inside, e.g. 3.14, 2025-08-08, 12:30) or hex (0x... or at
+// least 8 hex digits with a digit among them, e.g. a hash or an id).
+inline size_t normalizeTemplate(std::string_view message, char* out) {
+    using namespace templates;
+
+    size_t length = 0;
+    auto put = [&](const char* text, size_t size) {
+        size = std::min(size, kMaxTemplateLength - length);
+        std::memcpy(out + length, text, size);
+        length += size;
+    };
+
+    const char* p = message.data();
+    const char* end = p + message.size();
+    while (p < end && length < kMaxTemplateLength) {
+        char c = *p;
+        if (c == '"' || c == '\'') {
+            const char* close = static_cast<const char*>(std::memchr(p + 1, c, end - p - 1));
+            if (close != nullptr) {
+                put("<str>", 5);
+                p = close + 1;
+                continue;
+            }
+        }
+        if (!isWordChar(c)) {
+            out[length++] = c;
+            ++p;
+            continue;
+        }
+
+        const char* word = p;
+        bool number = true, hex = true, anyDigit = false;
+        while (p < end && (isWordChar(*p) || ((*p == '.' || *p == '-' || *p == ':') && number && p + 1 < end &&
+                                              isDigit(p[1]) && p > word))) {
+            anyDigit |= isDigit(*p);
+            number &= isDigit(*p) || *p == '.' || *p == '-' || *p == ':';
+            hex &= isHex(*p);
+            ++p;
+        }
+        size_t size = p - word;
+        if (number && anyDigit) {
+            put("<n>", 3);
+        } else if (size > 2 && word[0] == '0' && (word[1] | 0x20) == 'x' &&
+                   std::all_of(word + 2, p, isHex)) {
+            put("<hex>", 5);
+        } else if (hex && anyDigit && size >= 8) {
+            put("<hex>", 5);
+        } else {
+            put(word, size);
+        }
+    }
+    return length;
+}
+
+// FNV-1a; templates are short, so this is cheaper than std::hash<string_view>
+// plus the string construction it would need
+inline uint64_t templateHash(const char* text, size_t size) {
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+struct HeavyHitter {
+    std::string text;
+    uint64_t hash = 0;
+    uint64_t count = 0;
+    uint64_t error = 0;  // count may exceed the true frequency by up to this
+};
+
+// Fixed-memory Space-Saving summary. With a few dozen counters a linear scan
+// over the packed hash and count arrays beats maintaining a heap and index.
+class SpaceSaving {
+public:
+    static constexpr size_t kCapacity = 64;
+
+    void add(const char* text, size_t size) {
+        uint64_t hash = templateHash(text, size);
+        for (size_t i = 0; i < m_used; ++i) {
+            if (m_hashes[i] == hash) {
+                ++m_counts[i];
+                return;
+            }
+        }
+
+        size_t slot;
+        uint64_t error = 0;
+        if (m_used < kCapacity) {
+            slot = m_used++;
+        } else {
+            // Evict the smallest counter; the newcomer inherits its count as error
+            slot = size_t(std::min_element(m_counts, m_counts + kCapacity) - m_counts);
+            error = m_counts[slot];
+        }
+        m_hashes[slot] = hash;
+        m_counts[slot] = error + 1;
+        m_errors[slot] = error;
+        m_lengths[slot] = uint8_t(size);
+        std::memcpy(m_texts[slot], text, size);
+    }
+
+    // Appends the counters (unsorted) to out
+    void collect(std::vector<HeavyHitter>& out) const {
+        for (size_t i = 0; i < m_used; ++i) {
+            HeavyHitter hitter;
+            hitter.text.assign(m_texts[i], m_lengths[i]);
+            hitter.hash = m_hashes[i];
+            hitter.count = m_counts[i];
+            hitter.error = m_errors[i];
+            out.push_back(std::move(hitter));
+        }
+    }
+
+private:
+    size_t m_used = 0;
+    uint64_t m_hashes[kCapacity];
+    uint64_t m_counts[kCapacity];
+    uint64_t m_errors[kCapacity];
+    uint8_t m_lengths[kCapacity];
+    char m_texts[kCapacity][kMaxTemplateLength];
+};
+
+// Combines summaries (e.g. from several shards) and keeps the k largest
+inline std::vector<HeavyHitter> topHitters(std::vector<HeavyHitter> all, size_t k) {
+    std::sort(all.begin(), all.end(), [](const HeavyHitter& a, const HeavyHitter& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.count > b.count;
+    });
+    std::vector<HeavyHitter> merged;
+    for (HeavyHitter& hitter : all) {
+        if (!merged.empty() && merged.back().hash == hitter.hash) {
+            merged.back().count += hitter.count;
+            merged.back().error += hitter.error;
+        } else {
+            merged.push_back(std::move(hitter));
+        }
+    }
+    size_t keep = std::min(k, merged.size());
+    std::partial_sort(merged.begin(), merged.begin() + keep, merged.end(),
+                      [](const HeavyHitter& a, const HeavyHitter& b) { return a.count > b.count; });
+    merged.resize(keep);
+    return merged;
+}
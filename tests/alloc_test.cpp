@@ -0,0 +1,69 @@
+#include "logger.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Allocation-counting hook: every operator new in the process goes through here
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static const char* kMessage = "steady state record that is well past the SSO limit";
+
+static size_t countAllocations(Logger& logger, int records) {
+    size_t before = g_allocations.load();
+    for (int i = 0; i < records; ++i) {
+        logger.log(kMessage, LogLevel::Info);
+        logger.log(std::string_view(kMessage), LogLevel::Warning);
+    }
+    return g_allocations.load() - before;
+}
+
+int main() {
+    const std::string filename = "alloc_test.txt";
+
+    {
+        Logger logger(filename, LogLevel::Info);
+        countAllocations(logger, 100);  // warm up the thread-local buffer
+        size_t allocations = countAllocations(logger, 10000);
+        std::cout << "sync: " << allocations << " allocations\n";
+        CHECK(allocations == 0);
+    }
+    std::remove(filename.c_str());
+
+    {
+        LoggerOptions options;
+        options.async.enabled = true;
+        options.async.capacity = 64;
+        Logger logger(filename, LogLevel::Info, LogOutput::File, "", 0, options);
+        countAllocations(logger, 1000);  // every queue slot and the batch buffer
+        size_t allocations = countAllocations(logger, 10000);
+        std::cout << "async: " << allocations << " allocations\n";
+        CHECK(allocations == 0);
+    }
+    std::remove(filename.c_str());
+
+    if (failures == 0) std::cout << "alloc_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
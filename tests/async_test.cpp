@@ -0,0 +1,206 @@
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+// The wall clock of the calling thread, moved ahead as after a step of the
+// system clock. Replaces the libc function for this test binary; the
+// monotonic clock is left alone.
+static thread_local time_t t_wallAheadSeconds = 0;
+
+extern "C" int clock_gettime(clockid_t clock, struct timespec* ts) {
+    int result = int(syscall(SYS_clock_gettime, clock, ts));
+    if (result == 0 && clock == CLOCK_REALTIME) ts->tv_sec += t_wallAheadSeconds;
+    return result;
+}
+
+static size_t countLines(const std::string& filename) {
+    std::ifstream in(filename);
+    std::string line;
+    size_t lines = 0;
+    while (std::getline(in, line)) ++lines;
+    return lines;
+}
+
+// Every record logged before ~Logger must reach the file
+static void testDrainOnDestruction() {
+    const std::string filename = "async_test_drain.txt";
+    std::remove(filename.c_str());
+
+    const int threads = 4;
+    const int perThread = 5000;
+    {
+        LoggerOptions options;
+        options.async.enabled = true;
+        options.async.capacity = 256;
+        options.async.overflow = OverflowPolicy::Block;
+        Logger logger(filename, LogLevel::Info, LogOutput::File, "", 0, options);
+
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t) {
+            producers.emplace_back([&logger, t]() {
+                for (int i = 0; i < perThread; ++i) {
+                    logger.log("thread " + std::to_string(t) + " record " + std::to_string(i));
+                }
+            });
+        }
+        for (auto& p : producers) p.join();
+        CHECK(logger.droppedCount() == 0);
+    }
+
+    CHECK(countLines(filename) == (size_t)threads * perThread);
+    std::remove(filename.c_str());
+}
+
+// Dropping policies never block and account for every discarded record
+static void testDropPolicies() {
+    for (OverflowPolicy policy : {OverflowPolicy::DropNewest, OverflowPolicy::DropOldest}) {
+        for (bool perThread : {false, true}) {
+            const std::string filename = "async_test_drop.txt";
+            std::remove(filename.c_str());
+
+            const int total = 20000;
+            uint64_t dropped = 0;
+            {
+                LoggerOptions options;
+                options.async.enabled = true;
+                options.async.capacity = 16;
+                options.async.overflow = policy;
+                options.async.perThread = perThread;
+                Logger logger(filename, LogLevel::Info, LogOutput::File, "", 0, options);
+                for (int i = 0; i < total; ++i) {
+                    logger.log("record " + std::to_string(i));
+                }
+                dropped = logger.droppedCount();
+            }
+
+            CHECK(countLines(filename) + dropped == (size_t)total);
+            std::remove(filename.c_str());
+        }
+    }
+}
+
+// Keeps what the writer hands over, in order
+class CollectSink : public Sink {
+public:
+    struct Entry {
+        int64_t timestampNs;
+        std::string message;
+    };
+
+    void write(const LogRecord& record) override {
+        entries.push_back({ record.timestampNs, std::string(record.message()) });
+    }
+
+    std::vector<Entry> entries;
+};
+
+// Per-thread buffers: nothing lost when threads exit, every thread's records
+// in their order and the merged output in timestamp order. The merge runs on
+// the steady clock and a record's wall clock is read just after: a thread
+// preempted between the two may stamp its record later than the next one.
+static void testPerThreadMerge() {
+    auto sink = std::make_shared<CollectSink>();
+    sink->setMode(SinkMode::Async);
+    LoggerOptions options;
+    options.async.perThread = true;
+    options.async.capacity = 64;
+    options.async.batchSize = 16;
+    Logger logger({ sink }, LogLevel::Info, options);
+
+    const int waves = 4;
+    const int threads = 6;
+    const int perThread = 2000;
+    for (int wave = 0; wave < waves; ++wave) {
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t) {
+            int id = wave * threads + t;
+            producers.emplace_back([&logger, id]() {
+                for (int i = 0; i < perThread; ++i) {
+                    logger.log(std::to_string(id) + " " + std::to_string(i));
+                }
+            });
+        }
+        for (auto& p : producers) p.join();  // exit with records still buffered
+    }
+    logger.flush();
+
+    const auto& entries = sink->entries;
+    CHECK(entries.size() == size_t(waves) * threads * perThread);
+    CHECK(logger.droppedCount() == 0);
+    std::vector<int> next(waves * threads, 0);
+    bool ordered = true;
+    bool sequential = true;
+    for (size_t k = 0; k < entries.size(); ++k) {
+        if (k > 0 && entries[k].timestampNs < entries[k - 1].timestampNs - 100000000) ordered = false;
+        size_t space = entries[k].message.find(' ');
+        int id = std::stoi(entries[k].message.substr(0, space));
+        int i = std::stoi(entries[k].message.substr(space + 1));
+        if (i != next[id]++) sequential = false;
+    }
+    CHECK(ordered);
+    CHECK(sequential);
+
+    // A thread's buffer is dropped once written out: a later thread gets a new one
+    std::thread([&logger]() { logger.log("late"); }).join();
+    logger.flush();
+    CHECK(!entries.empty() && entries.back().message == "late");
+}
+
+// A thread whose wall clock runs an hour ahead: its records are not held
+// back until the writer's clock catches up, and the output keeps the order
+// they were logged in
+static void testWallClockAhead() {
+    auto sink = std::make_shared<CollectSink>();
+    sink->setMode(SinkMode::Async);
+    LoggerOptions options;
+    options.async.perThread = true;
+    Logger logger({ sink }, LogLevel::Info, options);
+
+    auto ahead = [&logger](const char* message) {
+        std::thread([&logger, message]() {
+            t_wallAheadSeconds = 3600;
+            logger.log(message);
+        }).join();
+    };
+    ahead("ahead 1");
+    logger.log("behind");
+    ahead("ahead 2");
+    logger.flush();
+
+    const auto& entries = sink->entries;
+    CHECK(entries.size() == 3);
+    if (entries.size() != 3) return;
+    CHECK(entries[0].message == "ahead 1");
+    CHECK(entries[1].message == "behind");
+    CHECK(entries[2].message == "ahead 2");
+    CHECK(entries[0].timestampNs > entries[1].timestampNs + 3000000000000LL);
+}
+
+int main() {
+    testDrainOnDestruction();
+    testDropPolicies();
+    testPerThreadMerge();
+    testWallClockAhead();
+
+    if (failures == 0) std::cout << "async_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "logger.hpp"
+#include "memory_sink.hpp"
+#include "field_groups.hpp"
+
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static bool endsWith(const std::string& line, const std::string& suffix) {
+    return line.size() >= suffix.size() && line.compare(line.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void testTextAndJson(SinkMode mode) {
+    auto text = std::make_shared<MemorySink>(8);
+    auto json = std::make_shared<MemorySink>(8);
+    json->setFormatter(appendJsonLine);
+    text->setMode(mode);
+    json->setMode(mode);
+
+    Logger logger({ text, json }, LogLevel::Info);
+    logger.log("request done", LogLevel::Info,
+               { {"service", "auth"}, {"latency_ms", 12.5}, {"status", 200}, {"ok", true},
+                 {"path", std::string("/a b")}, {"note", "say \"hi\""} });
+    logger.log("plain", LogLevel::Warning);
+    logger.flush();
+
+    std::vector<std::string> lines = text->records();
+    CHECK(lines.size() == 2);
+    if (lines.size() == 2) {
+        CHECK(endsWith(lines[0], "[Info] request done service=auth latency_ms=12.5 status=200 ok=true "
+                                 "path=\"/a b\" note=\"say \\\"hi\\\"\"\n"));
+        CHECK(endsWith(lines[1], "[Warning] plain\n"));
+    }
+
+    // log_stats reads a JSON line as the text line of the same record
+    std::vector<std::string> textLines = lines;
+    lines = json->records();
+    CHECK(lines.size() == 2);
+    for (size_t i = 0; i < lines.size() && i < textLines.size(); ++i) {
+        std::string converted;
+        CHECK(jsonLineToText(lines[i], converted));
+        CHECK(converted + "\n" == textLines[i]);
+    }
+    std::string converted;
+    CHECK(!jsonLineToText("{\"message\":\"no time\"}", converted));
+    CHECK(!jsonLineToText("{\"time\":\"2025-08-08 12:00:00\",\"level\":\"Info\"", converted));
+    CHECK(jsonLineToText("{\"time\":\"2025-08-08 12:00:00\",\"level\":\"Info\",\"message\":\"a\\u0001\\tb\"}",
+                         converted) && converted == "2025-08-08 12:00:00 [Info] a\x01\tb");
+    if (lines.size() == 2) {
+        CHECK(lines[0].rfind("{\"time\":\"", 0) == 0);
+        CHECK(endsWith(lines[0], "\"level\":\"Info\",\"message\":\"request done\",\"service\":\"auth\","
+                                 "\"latency_ms\":12.5,\"status\":200,\"ok\":true,\"path\":\"/a b\","
+                                 "\"note\":\"say \\\"hi\\\"\"}\n"));
+        CHECK(endsWith(lines[1], "\"level\":\"Warning\",\"message\":\"plain\"}\n"));
+    }
+}
+
+static void testFindField() {
+    std::string_view value;
+    std::string_view message = "user x=1 logged in service=auth latency_ms=12.5 path=\"/a b\"";
+    CHECK(findField(message, "service", value) && value == "auth");
+    CHECK(findField(message, "latency_ms", value) && value == "12.5");
+    CHECK(findField(message, "path", value) && value == "/a b");
+    CHECK(findField(message, "x", value) && value == "1");
+    CHECK(!findField(message, "ice", value));  // only whole keys
+    CHECK(!findField(message, "missing", value));
+
+    // A "key=" inside a quoted value is not a field
+    CHECK(findField("done note=\"retry service=db\" service=auth", "service", value) && value == "auth");
+    CHECK(!findField("done note=\"retry service=db\"", "service", value));
+    CHECK(!findField("done note=\"say \\\"service=db\\\"\"", "service", value));
+    CHECK(findField("done note=\"a b\" x=1", "x", value) && value == "1");
+
+    double number = 0;
+    CHECK(parseNumber("12.5", number) && number == 12.5);
+    CHECK(!parseNumber("12ms", number));
+}
+
+static void testGroups() {
+    FieldGroups groups;
+    groups.add("auth", true, 10);
+    groups.add("auth", true, 20);
+    groups.add("billing", false, 0);
+    for (size_t i = 0; i < FieldGroups::kMaxGroups + 5; ++i) groups.add("id" + std::to_string(i), false, 0);
+
+    std::unordered_map<std::string, GroupTotals> merged;
+    groups.mergeInto(merged);
+    CHECK(merged.size() == FieldGroups::kMaxGroups + 1);
+    CHECK(merged["auth"].count == 2 && merged["auth"].summed == 2 && merged["auth"].sum == 30);
+    CHECK(merged[std::string(FieldGroups::kOtherGroup)].count == 7);
+
+    auto top = largestGroups(merged, 2);
+    CHECK(top.size() == 2 && top[0].first == std::string(FieldGroups::kOtherGroup) && top[1].first == "auth");
+}
+
+int main() {
+    testTextAndJson(SinkMode::Inline);
+    testTextAndJson(SinkMode::Async);
+    testFindField();
+    testGroups();
+
+    if (failures == 0) std::cout << "fields_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#include "logger.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static const std::string kFile = "flush_test.txt";
+
+static size_t countLines() {
+    std::ifstream in(kFile);
+    std::string line;
+    size_t lines = 0;
+    while (std::getline(in, line)) ++lines;
+    return lines;
+}
+
+static LoggerOptions explicitOnly(bool async) {
+    LoggerOptions options;
+    options.async.enabled = async;
+    options.flush.everyBytes = options.flush.bufferSize;
+    options.flush.onError = false;
+    return options;
+}
+
+// Nothing is written until the buffer fills or flush() is called
+static void testExplicitFlush(bool async) {
+    std::remove(kFile.c_str());
+    Logger logger(kFile, LogLevel::Info, LogOutput::File, "", 0, explicitOnly(async));
+    for (int i = 0; i < 10; ++i) logger.log("buffered record");
+    if (!async) CHECK(countLines() == 0);
+    logger.flush();
+    CHECK(countLines() == 10);
+}
+
+static void testFlushOnError() {
+    std::remove(kFile.c_str());
+    LoggerOptions options = explicitOnly(false);
+    options.flush.onError = true;
+    Logger logger(kFile, LogLevel::Info, LogOutput::File, "", 0, options);
+    logger.log("info record", LogLevel::Info);
+    logger.log("warning record", LogLevel::Warning);
+    CHECK(countLines() == 0);
+    logger.log("error record", LogLevel::Error);
+    CHECK(countLines() == 3);
+}
+
+static void testFlushInterval(bool async) {
+    std::remove(kFile.c_str());
+    LoggerOptions options = explicitOnly(async);
+    options.flush.interval = std::chrono::milliseconds(20);
+    Logger logger(kFile, LogLevel::Info, LogOutput::File, "", 0, options);
+    logger.log("timed record");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    CHECK(countLines() == 1);
+}
+
+// Records larger than the buffer go straight through with the buffered ones
+static void testOversizedRecord() {
+    std::remove(kFile.c_str());
+    {
+        LoggerOptions options;
+        options.flush.bufferSize = 64;
+        options.flush.everyBytes = 64;
+        Logger logger(kFile, LogLevel::Info, LogOutput::File, "", 0, options);
+        logger.log("short");
+        logger.log(std::string(500, 'x'));
+        CHECK(countLines() == 2);
+        logger.log("tail");
+    }
+    CHECK(countLines() == 3);
+}
+
+int main() {
+    testExplicitFlush(false);
+    testExplicitFlush(true);
+    testFlushOnError();
+    testFlushInterval(false);
+    testFlushInterval(true);
+    testOversizedRecord();
+    std::remove(kFile.c_str());
+
+    if (failures == 0) std::cout << "flush_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
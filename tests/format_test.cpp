@@ -0,0 +1,82 @@
+#include "logger.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static std::string format(std::string_view fmt) {
+    std::string out;
+    logfmt::formatTo(out, fmt);
+    return out;
+}
+
+template <typename... Args>
+static std::string format(std::string_view fmt, const Args&... args) {
+    std::string out;
+    logfmt::formatTo(out, fmt, args...);
+    return out;
+}
+
+static int g_evaluated = 0;
+
+static int expensive() {
+    ++g_evaluated;
+    return 42;
+}
+
+static void testFormatter() {
+    CHECK(format("x={} y={}", 1, -2) == "x=1 y=-2");
+    CHECK(format("{} {} {} {}", "str", std::string("s"), true, 'c') == "str s true c");
+    CHECK(format("{}", 2.5) == "2.5");
+    CHECK(format("{}", 18446744073709551615ull) == "18446744073709551615");
+    CHECK(format("{{}} {}", 7) == "{} 7");
+    CHECK(format("missing {} {}", 1) == "missing 1 {}");
+    CHECK(format("extra", 1, 2) == "extra");
+    CHECK(format("no args {}") == "no args {}");
+}
+
+static void testLazyMacros() {
+    const std::string filename = "format_test.txt";
+    std::remove(filename.c_str());
+    {
+        Logger logger(filename, LogLevel::Info);
+        logger.setLevel(LogLevel::Warning);
+
+        // Disabled at runtime: arguments are never evaluated
+        LOG_DEBUG(logger, "value={}", expensive());
+        LOG_INFO(logger, "value={}", expensive());
+        CHECK(g_evaluated == 0);
+
+        LOG_WARNING(logger, "value={} name={}", expensive(), "w");
+        LOG_ERROR(logger, "done");
+        CHECK(g_evaluated == 1);
+    }
+
+    std::ifstream in(filename);
+    std::string first, second, extra;
+    std::getline(in, first);
+    std::getline(in, second);
+    CHECK(first.find("[Warning] value=42 name=w") != std::string::npos);
+    CHECK(second.find("[Error] done") != std::string::npos);
+    CHECK(!std::getline(in, extra));
+    std::remove(filename.c_str());
+}
+
+int main() {
+    testFormatter();
+    testLazyMacros();
+
+    if (failures == 0) std::cout << "format_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#include "logger.hpp"
+#include "memory_sink.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static int evaluated = 0;
+
+static int expensive() {
+    ++evaluated;
+    return 42;
+}
+
+static void hotSite(Logger& logger) {
+    LOG_INFO(logger, "hot {}", expensive());
+}
+
+// Records kept, and the records reported as suppressed by the summaries
+static void countRecords(const MemorySink& sink, uint64_t& kept, uint64_t& suppressed, size_t& summaries) {
+    kept = suppressed = summaries = 0;
+    for (const std::string& line : sink.records()) {
+        size_t at = line.find("] ");
+        size_t end = line.find(" records suppressed");
+        if (end == std::string::npos) {
+            ++kept;
+            continue;
+        }
+        ++summaries;
+        suppressed += std::stoull(line.substr(at + 2, end - at - 2));
+    }
+}
+
+// A hot call site gets `burst` records at once and then `perSecond`; the
+// rest is counted and reported once per interval, arguments unevaluated
+static void testRateLimit() {
+    auto sink = std::make_shared<MemorySink>(100000);
+    LoggerOptions options;
+    options.limits.perSecond = 100;
+    options.limits.burst = 10;
+    options.limits.summaryInterval = std::chrono::milliseconds(50);
+    Logger logger({ sink }, LogLevel::Debug, options);
+
+    const int total = 20000;
+    evaluated = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < total; ++i) hotSite(logger);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(evaluated >= 10 && evaluated <= 10 + int(elapsed * 100) + 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    hotSite(logger);  // the interval has passed: reports
+    for (int i = 0; i < 10; ++i) LOG_INFO(logger, "another site {}", i);
+
+    uint64_t kept, suppressed;
+    size_t summaries;
+    countRecords(*sink, kept, suppressed, summaries);
+    CHECK(summaries == 1);
+    CHECK(kept == uint64_t(evaluated) + 10);
+    CHECK(kept + suppressed == uint64_t(total) + 1 + 10);
+    std::string summary;
+    for (const std::string& line : sink->records()) {
+        if (line.find("suppressed") != std::string::npos) summary = line;
+    }
+    CHECK(summary.find("[Info]") != std::string::npos && summary.find("limits_test.cpp:") != std::string::npos);
+}
+
+// ~1 in N per level; what was dropped is reported at the latest on destruction
+static void testSampling() {
+    auto sink = std::make_shared<MemorySink>(100000);
+    const int total = 100000;
+    {
+        LoggerOptions options;
+        options.limits.sampleEvery = { 20, 1, 1, 1 };
+        Logger logger({ sink }, LogLevel::Debug, options);
+        for (int i = 0; i < total; ++i) logger.log("debug", LogLevel::Debug);
+        for (int i = 0; i < 100; ++i) logger.logf(LogLevel::Info, "info {}", i);
+    }
+
+    uint64_t kept, suppressed;
+    size_t summaries;
+    countRecords(*sink, kept, suppressed, summaries);
+    CHECK(summaries >= 1);
+    CHECK(kept + suppressed == uint64_t(total) + 100);
+    uint64_t debugKept = kept - 100;
+    CHECK(debugKept > total / 20 * 8 / 10 && debugKept < total / 20 * 12 / 10);
+}
+
+// Loggers running the same call site at once, more of them than there are
+// slots: each has its own bucket and count and reports what it dropped when
+// destroyed. Their slots are clean for the next round.
+static void testLoggersApart() {
+    const int loggers = kLogSiteSlots + 2;
+    for (int round = 0; round < 2; ++round) {
+        std::vector<std::shared_ptr<MemorySink>> sinks;
+        {
+            LoggerOptions options;
+            options.limits.perSecond = 1;
+            options.limits.burst = 10;
+            options.limits.summaryInterval = std::chrono::hours(1);
+            std::vector<std::unique_ptr<Logger>> running;
+            for (int i = 0; i < loggers; ++i) {
+                sinks.push_back(std::make_shared<MemorySink>(1000));
+                running.emplace_back(new Logger({ sinks.back() }, LogLevel::Debug, options));
+            }
+            for (auto& logger : running) {
+                for (int i = 0; i < 100; ++i) hotSite(*logger);
+            }
+        }
+        for (auto& sink : sinks) {
+            uint64_t kept, suppressed;
+            size_t summaries;
+            countRecords(*sink, kept, suppressed, summaries);
+            CHECK(kept >= 10 && kept <= 11);
+            CHECK(kept + suppressed == 100);
+            CHECK(summaries == 1);
+            CHECK(!sink->records().empty() && sink->records().back().find("[Info]") != std::string::npos &&
+                  sink->records().back().find("limits_test.cpp:") != std::string::npos);
+        }
+    }
+}
+
+// No limits: nothing dropped, no summaries
+static void testUnlimited() {
+    auto sink = std::make_shared<MemorySink>(1000);
+    Logger logger({ sink }, LogLevel::Debug);
+    for (int i = 0; i < 500; ++i) LOG_DEBUG(logger, "record {}", i);
+    CHECK(sink->total() == 500);
+}
+
+int main() {
+    testRateLimit();
+    testSampling();
+    testLoggersApart();
+    testUnlimited();
+
+    if (failures == 0) std::cout << "limits_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "log_parser.hpp"
+
+#include <ctime>
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+// Reference conversion: the local wall clock through mktime
+static int64_t viaMktime(int year, int month, int day, int hour, int minute, int second) {
+    std::tm tm{};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+    tm.tm_isdst = -1;
+    return std::mktime(&tm);
+}
+
+int main() {
+    ParsedLine parsed;
+
+    CHECK(parseLogLine("2025-08-08 14:33:18 [Info] Hello there", parsed));
+    CHECK(parsed.level == LogLevel::Info);
+    CHECK(parsed.message == "Hello there");
+    CHECK(parsed.epochSeconds == viaMktime(2025, 8, 8, 14, 33, 18));
+
+    // Fractional seconds of any length, every level name
+    CHECK(parseLogLine("2025-08-08 14:33:18.123 [Debug] a", parsed));
+    CHECK(parsed.level == LogLevel::Debug && parsed.message == "a");
+    CHECK(parseLogLine("2025-08-08 14:33:18.123456 [Warning] b", parsed));
+    CHECK(parsed.level == LogLevel::Warning && parsed.message == "b");
+    CHECK(parsed.epochSeconds == viaMktime(2025, 8, 8, 14, 33, 18));
+    CHECK(parseLogLine("2025-08-08 14:33:18 [Error]", parsed));
+    CHECK(parsed.level == LogLevel::Error && parsed.message.empty());
+
+    // The message keeps its own brackets
+    CHECK(parseLogLine("2025-08-08 14:33:18 [Info] [x] y]", parsed));
+    CHECK(parsed.message == "[x] y]");
+
+    // Dates across months, leap days and years agree with mktime
+    const int dates[][6] = {
+        {2024, 2, 29, 0, 0, 0}, {2024, 12, 31, 23, 59, 59}, {2025, 1, 1, 0, 0, 1},
+        {2025, 3, 30, 2, 30, 0}, {2025, 10, 26, 3, 15, 0}, {1999, 7, 4, 12, 0, 0},
+    };
+    char line[64];
+    for (const auto& d : dates) {
+        std::snprintf(line, sizeof(line), "%04d-%02d-%02d %02d:%02d:%02d [Info] x", d[0], d[1], d[2], d[3], d[4], d[5]);
+        CHECK(parseLogLine(line, parsed));
+        CHECK(parsed.epochSeconds == viaMktime(d[0], d[1], d[2], d[3], d[4], d[5]));
+    }
+
+    // Not Logger records
+    CHECK(!parseLogLine("", parsed));
+    CHECK(!parseLogLine("#LGWP/1 ok", parsed));
+    CHECK(!parseLogLine("2025-08-08 14:33:18 [Trace] x", parsed));
+    CHECK(!parseLogLine("2025-08-08 14:33:18 [Info x", parsed));
+    CHECK(!parseLogLine("2025-08-08 14:33:18 Info] x", parsed));
+    CHECK(!parseLogLine("2025-13-08 14:33:18 [Info] x", parsed));
+    CHECK(!parseLogLine("2025-08-08 24:33:18 [Info] x", parsed));
+    CHECK(!parseLogLine("2025-08-08T14:33:18 [Info] x", parsed));
+    CHECK(!parseLogLine("2025-08-08 14:33:1x [Info] x", parsed));
+    CHECK(!parseLogLine("2025-08-08 14:33:18.12a [Info] x", parsed));
+
+    if (failures == 0) std::cout << "parser_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
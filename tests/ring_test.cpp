@@ -0,0 +1,115 @@
+#include "logger.hpp"
+#include "ring_sink.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static const char* kRingPath = "ring_test.ring";
+
+static std::string messageOf(const RingRecord& record) {
+    size_t at = record.text.find("] ");
+    return at == std::string::npos ? std::string() : record.text.substr(at + 2, record.text.size() - at - 3);
+}
+
+// Consecutive sequences, the newest records kept, the older ones counted
+static void checkRing(const RingContents& contents, int total) {
+    CHECK(!contents.damaged);
+    CHECK(!contents.records.empty());
+    if (contents.records.empty()) return;
+    CHECK(contents.overwritten + contents.records.size() == size_t(total));
+    bool consecutive = true;
+    for (size_t i = 0; i < contents.records.size(); ++i) {
+        if (contents.records[i].sequence != contents.overwritten + i) consecutive = false;
+        if (messageOf(contents.records[i]) != "record " + std::to_string(contents.overwritten + i)) consecutive = false;
+    }
+    CHECK(consecutive);
+}
+
+static void testWrap() {
+    std::remove(kRingPath);
+    const int total = 5000;
+    {
+        auto ring = std::make_shared<RingSink>(kRingPath, 16 * 1024);
+        CHECK(ring->isOpen());
+        Logger logger({ ring }, LogLevel::Info);
+        for (int i = 0; i < total; ++i) logger.log("record " + std::to_string(i));
+    }
+    RingContents contents;
+    std::string error;
+    CHECK(readRingFile(kRingPath, contents, error));
+    checkRing(contents, total);
+    CHECK(contents.overwritten > 0);  // 5000 records do not fit in 16 KB
+
+    // A new run continues the ring instead of wiping the evidence
+    {
+        auto ring = std::make_shared<RingSink>(kRingPath, 16 * 1024);
+        Logger logger({ ring }, LogLevel::Info);
+        for (int i = total; i < total + 10; ++i) logger.log("record " + std::to_string(i));
+    }
+    CHECK(readRingFile(kRingPath, contents, error));
+    checkRing(contents, total + 10);
+
+    // A damaged frame ends the walk; what came before it is still returned
+    std::fstream file(kRingPath, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(4096 + 8 * 1024);
+    file.write("garbage garbage garbage garbage ", 32);
+    file.close();
+    CHECK(readRingFile(kRingPath, contents, error));
+    CHECK(contents.damaged);
+    CHECK(!contents.records.empty() && contents.records.size() < 400);
+
+    std::ofstream(kRingPath) << "plain text\n";
+    CHECK(!readRingFile(kRingPath, contents, error));
+    std::remove(kRingPath);
+}
+
+// The process is killed without running a destructor or flush: every record
+// log() returned from is in the file
+static void testKilledProcess() {
+    std::remove(kRingPath);
+    const int total = 300;
+    pid_t child = fork();
+    if (child == 0) {
+        LoggerOptions options;
+        options.ring.path = kRingPath;
+        options.ring.bytes = 64 * 1024;
+        Logger* logger = new Logger("ring_test_file.txt", LogLevel::Info, LogOutput::File, "", 0, options);
+        for (int i = 0; i < total; ++i) logger->log("record " + std::to_string(i));
+        raise(SIGKILL);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+
+    RingContents contents;
+    std::string error;
+    CHECK(readRingFile(kRingPath, contents, error));
+    checkRing(contents, total);
+    CHECK(contents.overwritten == 0);
+    std::remove(kRingPath);
+    std::remove("ring_test_file.txt");
+}
+
+int main() {
+    testWrap();
+    testKilledProcess();
+
+    if (failures == 0) std::cout << "ring_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
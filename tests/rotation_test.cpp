@@ -0,0 +1,169 @@
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef LOGGER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static const std::string kDir = "rotation_test.d";
+static const std::string kFile = kDir + "/app.log";
+
+static std::vector<std::string> listDir() {
+    std::vector<std::string> names;
+    if (DIR* dir = opendir(kDir.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") names.push_back(name);
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static void resetDir() {
+    for (const std::string& name : listDir()) std::remove((kDir + "/" + name).c_str());
+    mkdir(kDir.c_str(), 0755);
+}
+
+static size_t fileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? size_t(st.st_size) : 0;
+}
+
+static size_t countLines(const std::string& path) {
+    size_t lines = 0;
+#ifdef LOGGER_HAVE_ZLIB
+    // gzread passes plain files through unchanged
+    gzFile in = gzopen(path.c_str(), "rb");
+    if (in == nullptr) return 0;
+    char buffer[4096];
+    int n;
+    while ((n = gzread(in, buffer, sizeof(buffer))) > 0) lines += std::count(buffer, buffer + n, '\n');
+    gzclose(in);
+#else
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) ++lines;
+#endif
+    return lines;
+}
+
+// How many of the newest record numbers (counting down from 2999) are all present
+static size_t countRecentRecords(const std::vector<std::string>& names) {
+    std::vector<bool> seen(3000, false);
+    for (const std::string& name : names) {
+#ifdef LOGGER_HAVE_ZLIB
+        gzFile in = gzopen((kDir + "/" + name).c_str(), "rb");
+        if (in == nullptr) continue;
+        char line[256];
+        while (gzgets(in, line, sizeof(line)) != nullptr) {
+            if (const char* number = std::strstr(line, "number ")) seen[std::atoi(number + 7)] = true;
+        }
+        gzclose(in);
+#else
+        std::ifstream in(kDir + "/" + name);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t at = line.find("number ");
+            if (at != std::string::npos) seen[std::stoi(line.substr(at + 7))] = true;
+        }
+#endif
+    }
+    size_t count = 0;
+    for (int i = 2999; i >= 0 && seen[i]; --i) ++count;
+    return count;
+}
+
+static LoggerOptions rotating(size_t maxBytes, size_t keep, bool compress, bool async) {
+    LoggerOptions options;
+    options.async.enabled = async;
+    options.rotation.maxBytes = maxBytes;
+    options.rotation.keep = keep;
+    options.rotation.compress = compress;
+    return options;
+}
+
+// Every record lands in exactly one file, none larger than maxBytes
+static void testSizeRotation(bool async) {
+    resetDir();
+    const int kRecords = 2000;
+    {
+        Logger logger(kFile, LogLevel::Info, LogOutput::File, "", 0, rotating(8192, 0, false, async));
+        for (int i = 0; i < kRecords; ++i) logger.log("rotation test record number " + std::to_string(i));
+    }
+
+    std::vector<std::string> names = listDir();
+    CHECK(names.size() > 5);
+    size_t lines = 0;
+    for (const std::string& name : names) {
+        CHECK(name == "app.log" || name.compare(0, 8, "app.log.") == 0);
+        CHECK(fileSize(kDir + "/" + name) <= 8192);
+        lines += countLines(kDir + "/" + name);
+    }
+    CHECK(lines == size_t(kRecords));
+}
+
+// Only the newest segments survive; with zlib they are gzipped
+static void testRetentionAndCompression() {
+    resetDir();
+    {
+        // Far more than ten rotations per second: the "-N" suffixes must order numerically
+        Logger logger(kFile, LogLevel::Info, LogOutput::File, "", 0, rotating(4096, 3, true, false));
+        for (int i = 0; i < 3000; ++i) logger.log("retention test record number " + std::to_string(i));
+    }
+
+    std::vector<std::string> names = listDir();
+    CHECK(names.size() == 4);  // app.log and three segments
+    CHECK(std::count(names.begin(), names.end(), "app.log") == 1);
+    size_t lines = 0;
+    for (const std::string& name : names) {
+        CHECK(name.find(".tmp") == std::string::npos);
+#ifdef LOGGER_HAVE_ZLIB
+        if (name != "app.log") CHECK(name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0);
+#endif
+        lines += countLines(kDir + "/" + name);
+    }
+    CHECK(lines > 0 && lines < 3000);
+
+    // Together the kept files hold the most recent records without gaps
+    CHECK(countRecentRecords(names) == lines);
+
+    // The newest records are the ones kept
+    std::ifstream active(kFile);
+    std::string last, line;
+    while (std::getline(active, line)) last = line;
+    CHECK(last.find("record number 2999") != std::string::npos);
+}
+
+int main() {
+    testSizeRotation(false);
+    testSizeRotation(true);
+    testRetentionAndCompression();
+    resetDir();
+    rmdir(kDir.c_str());
+
+    if (failures == 0) std::cout << "rotation_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
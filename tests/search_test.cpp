@@ -0,0 +1,169 @@
+#include "search_index.hpp"
+
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static const char* kLogPath = "search_test.log";
+static const std::string kIndexPath = std::string(kLogPath) + std::string(search::kIndexSuffix);
+
+static void testFinder() {
+    std::string text = "0123456789abcdefghijklmnopqrstuvwxyz needle at 48, Needle NEEDLE";
+    for (bool ignoreCase : { false, true }) {
+        SubstringFinder finder("needle", ignoreCase);
+        const char* hit = finder.find(text.data(), text.data() + text.size());
+        CHECK(hit == text.data() + text.find("needle"));
+    }
+    SubstringFinder folded("NEEDLE", true);
+    const char* second = folded.find(text.data() + 40, text.data() + text.size());
+    CHECK(second == text.data() + text.find("Needle"));
+    SubstringFinder exact("NEEDLE", false);
+    CHECK(exact.find(text.data(), text.data() + text.size()) == text.data() + text.size() - 6);  // at the very end
+    CHECK(exact.find(text.data(), text.data() + text.size() - 1) == nullptr);
+
+    SubstringFinder single("z", false);
+    CHECK(single.find(text.data(), text.data() + text.size()) == text.data() + text.find('z'));
+    SubstringFinder longer(text + "!", false);
+    CHECK(longer.find(text.data(), text.data() + text.size()) == nullptr);
+
+    // Every alignment against the 16-byte steps
+    for (size_t at = 0; at < 40; ++at) {
+        std::string hay(64, 'x');
+        hay.replace(at, 3, "abc");
+        SubstringFinder abc("abc", false);
+        CHECK(abc.find(hay.data(), hay.data() + hay.size()) == hay.data() + at);
+    }
+}
+
+static std::string record(int i) {
+    char line[128];
+    std::snprintf(line, sizeof(line), "2026-01-01 %02d:%02d:%02d [%s] request %d for user u%d done\n", i / 3600 % 24,
+                  i / 60 % 60, i % 60, i % 10000 == 1234 ? "Error" : "Info", i, i % 97);
+    return line;
+}
+
+static size_t findLines(const char* data, size_t size, const search::TrigramIndex& index, const std::string& needle,
+                       const search::LineFilter& filter, size_t& verifiedBlocks) {
+    SubstringFinder finder(needle, false);
+    std::vector<uint32_t> ids;
+    if (!index.blocksWith(finder.needle(), ids)) {
+        for (uint32_t id = 0; id < index.blockCount(); ++id) ids.push_back(id);
+    }
+    size_t matches = 0;
+    verifiedBlocks = 0;
+    for (uint32_t id : ids) {
+        const search::BlockInfo& block = index.block(id);
+        if (!filter.accepts(block)) continue;
+        ++verifiedBlocks;
+        matches += search::searchRange(data + block.offset, data + block.offset + block.size, finder, filter, "",
+                                       nullptr);
+    }
+    return matches + search::searchRange(data + index.covered(), data + size, finder, filter, "", nullptr);
+}
+
+static void testIndex() {
+    std::remove(kLogPath);
+    std::remove(kIndexPath.c_str());
+    {
+        std::ofstream out(kLogPath);
+        for (int i = 0; i < 20000; ++i) out << record(i);
+    }
+
+    search::MappedFile log;
+    CHECK(log.open(kLogPath));
+    CHECK(search::updateIndex(kIndexPath, log.data(), log.size(), 2));
+    search::TrigramIndex index;
+    CHECK(index.load(kIndexPath) && index.matches(log.data(), log.size()));
+    CHECK(index.blockCount() >= 3);
+    CHECK(index.covered() < log.size());  // the tail stays unindexed
+
+    size_t verified;
+    search::LineFilter all;
+    CHECK(findLines(log.data(), log.size(), index, "request 4321 ", all, verified) == 1);
+    CHECK(verified == 1);
+    CHECK(findLines(log.data(), log.size(), index, "no such text", all, verified) == 0);
+    CHECK(verified == 0);
+    CHECK(findLines(log.data(), log.size(), index, "user u5 ", all, verified) == 207);  // 20000 / 97, rounded up
+
+    search::LineFilter errors;
+    errors.levels = 1u << 3;
+    CHECK(findLines(log.data(), log.size(), index, "", errors, verified) == 2);
+    CHECK(verified <= 2);
+
+    // Runs indexing the same log at once each write their own temporary file;
+    // the index that stays is a whole one and no temporary is left behind
+    std::remove(kIndexPath.c_str());
+    std::vector<std::thread> runs;
+    std::atomic<int> succeeded{ 0 };
+    for (int i = 0; i < 4; ++i) {
+        runs.emplace_back([&] {
+            if (search::updateIndex(kIndexPath, log.data(), log.size(), 1)) ++succeeded;
+        });
+    }
+    for (std::thread& run : runs) run.join();
+    CHECK(succeeded == 4);
+    CHECK(index.load(kIndexPath) && index.matches(log.data(), log.size()));
+    CHECK(findLines(log.data(), log.size(), index, "request 4321 ", all, verified) == 1);
+    int leftovers = 0;
+    if (DIR* dir = opendir(".")) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > kIndexPath.size() && name.compare(0, kIndexPath.size(), kIndexPath) == 0) ++leftovers;
+        }
+        closedir(dir);
+    }
+    CHECK(leftovers == 0);
+
+    // Growth: only the new blocks are indexed, the old ones stay as they were
+    size_t oldBlocks = index.blockCount();
+    search::BlockInfo firstBlock = index.block(0);
+    {
+        std::ofstream out(kLogPath, std::ios::app);
+        for (int i = 20000; i < 40000; ++i) out << record(i);
+    }
+    CHECK(log.open(kLogPath));
+    CHECK(search::updateIndex(kIndexPath, log.data(), log.size(), 2));
+    CHECK(index.load(kIndexPath) && index.matches(log.data(), log.size()));
+    CHECK(index.blockCount() > oldBlocks);
+    CHECK(index.block(0).offset == firstBlock.offset && index.block(0).size == firstBlock.size);
+    CHECK(findLines(log.data(), log.size(), index, "request 39999 ", all, verified) == 1);
+    CHECK(findLines(log.data(), log.size(), index, "request 4321 ", all, verified) == 1);
+
+    // A replaced file (rotation) is indexed from scratch
+    {
+        std::ofstream out(kLogPath, std::ios::trunc);
+        for (int i = 50000; i < 60000; ++i) out << record(i);
+    }
+    CHECK(log.open(kLogPath));
+    CHECK(!index.load(kIndexPath) || !index.matches(log.data(), log.size()));
+    CHECK(search::updateIndex(kIndexPath, log.data(), log.size(), 2));
+    CHECK(index.load(kIndexPath) && index.matches(log.data(), log.size()));
+    CHECK(findLines(log.data(), log.size(), index, "request 4321 ", all, verified) == 0);
+    CHECK(findLines(log.data(), log.size(), index, "request 54321 ", all, verified) == 1);
+
+    log.reset();
+    std::remove(kLogPath);
+    std::remove(kIndexPath.c_str());
+}
+
+int main() {
+    testFinder();
+    testIndex();
+
+    if (failures == 0) std::cout << "search_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+#include "log_server.hpp"
+#include "wire_protocol.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+// receiveBuffer keeps a subscriber that never reads from hiding the stall
+// in a large kernel buffer
+static int connectTo(int port, int receiveBuffer = 0) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (receiveBuffer > 0) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void sendText(int fd, const std::string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t n = send(fd, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        done += n;
+    }
+}
+
+static std::vector<std::string> split(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (size_t end; (end = text.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.push_back(text.substr(start, end - start));
+    }
+    return lines;
+}
+
+// Reads until count lines arrived, the peer closed or nothing came for a while
+static std::vector<std::string> readLines(int fd, size_t count, int idleMs = 2000) {
+    std::string text;
+    char buffer[65536];
+    size_t lines = 0;
+    while (lines < count) {
+        pollfd pfd{ fd, POLLIN, 0 };
+        if (poll(&pfd, 1, idleMs) <= 0) break;
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        lines += std::count(buffer, buffer + n, '\n');
+        text.append(buffer, n);
+    }
+    return split(text);
+}
+
+template <typename Predicate>
+static bool waitFor(Predicate predicate) {
+    for (int i = 0; i < 300; ++i) {
+        if (predicate()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static ServerOptions serverOptions(int port, int threads) {
+    ServerOptions options;
+    options.port = port;
+    options.threads = threads;
+    options.quiet = true;
+    return options;
+}
+
+// Four SO_REUSEPORT loops: every client gets every other client's records,
+// whichever loop either of them landed on, and never its own
+static void testLoops() {
+    const int port = 19972;
+    const int clients = 12;
+    const int records = 20;
+    LogServer server(serverOptions(port, 4));
+    CHECK(server.start());
+
+    std::vector<int> fds;
+    for (int c = 0; c < clients; ++c) fds.push_back(connectTo(port));
+    CHECK(std::count(fds.begin(), fds.end(), -1) == 0);
+    CHECK(waitFor([&]() { return server.textClients().load() == clients; }));
+    std::vector<int> perLoop = server.connectionsPerLoop();
+    CHECK(perLoop.size() == 4);
+    CHECK(std::count_if(perLoop.begin(), perLoop.end(), [](int n) { return n > 0; }) >= 2);
+
+    std::vector<std::thread> senders;
+    for (int c = 0; c < clients; ++c) {
+        senders.emplace_back([&, c]() {
+            for (int i = 0; i < records; ++i) {
+                sendText(fds[c], "client " + std::to_string(c) + " record " + std::to_string(i) + "\n");
+            }
+        });
+    }
+    for (auto& sender : senders) sender.join();
+
+    for (int c = 0; c < clients; ++c) {
+        std::vector<std::string> lines = readLines(fds[c], size_t(clients - 1) * records);
+        CHECK(lines.size() == size_t(clients - 1) * records);
+        std::vector<int> next(clients, 0);
+        bool complete = true;
+        for (const std::string& line : lines) {
+            int from = -1, i = -1;
+            if (std::sscanf(line.c_str(), "client %d record %d", &from, &i) != 2 || from < 0 || from >= clients ||
+                from == c || i != next[from]++) {
+                complete = false;
+            }
+        }
+        CHECK(complete);
+    }
+
+    for (int fd : fds) close(fd);
+    server.stop();
+}
+
+// Records reach subscribers whole, however the sender's writes cut them
+static void testFraming() {
+    const int port = 19974;
+    LogServer server(serverOptions(port, 2));
+    CHECK(server.start());
+    int producer = connectTo(port);
+    int first = connectTo(port);
+    int second = connectTo(port);
+    CHECK(waitFor([&]() { return server.textClients().load() == 3; }));
+
+    auto pause = []() { std::this_thread::sleep_for(std::chrono::milliseconds(50)); };
+
+    // One record in two writes
+    sendText(producer, "split rec");
+    pause();
+    sendText(producer, "ord\n");
+    // Complete records followed by the start of the next one
+    sendText(producer, "one\ntwo\npart");
+    pause();
+    sendText(producer, "ial three\n");
+    for (int fd : { first, second }) {
+        std::vector<std::string> lines = readLines(fd, 4);
+        CHECK((lines == std::vector<std::string>{ "split record", "one", "two", "partial three" }));
+    }
+
+    // Many records in one write, more than a read buffer holds
+    const int total = 5000;
+    std::string batch;
+    for (int i = 0; i < total; ++i) batch += "batch record " + std::to_string(i) + "\n";
+    sendText(producer, batch);
+    for (int fd : { first, second }) {
+        std::vector<std::string> lines = readLines(fd, total);
+        CHECK(lines.size() == size_t(total));
+        bool whole = true;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (lines[i] != "batch record " + std::to_string(i)) whole = false;
+        }
+        CHECK(whole);
+    }
+
+    close(producer);
+    close(first);
+    close(second);
+    server.stop();
+}
+
+// A text producer's line of about a read buffer, relayed without its
+// newline, still reaches a binary subscriber as valid frames, and so does
+// the line after it
+static void testLongLineToBinary() {
+    const int port = 19975;
+    LogServer server(serverOptions(port, 1));
+    CHECK(server.start());
+    int producer = connectTo(port);
+    int subscriber = connectTo(port);
+    sendText(subscriber, std::string(wire::kHelloBinary));
+    std::vector<std::string> accepted = readLines(subscriber, 1);
+    CHECK(accepted.size() == 1 && accepted[0] + "\n" == wire::kHelloAccept);
+    CHECK(waitFor([&]() { return server.textClients().load() == 1 && server.binaryClients().load() == 1; }));
+
+    const size_t length = (1 << 20) + 1000;
+    sendText(producer, std::string(length, 'x') + "\nnext line\n");
+
+    std::string in;
+    char buffer[65536];
+    size_t received = 0;
+    bool valid = true;
+    bool next = false;
+    while (valid && !next) {
+        pollfd pfd{ subscriber, POLLIN, 0 };
+        if (poll(&pfd, 1, 3000) <= 0) break;
+        ssize_t n = recv(subscriber, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        in.append(buffer, n);
+        size_t at = 0;
+        for (size_t size; (size = wire::completeFrame(in.data() + at, in.size() - at)) != 0; at += size) {
+            if (size == SIZE_MAX) {
+                valid = false;
+                break;
+            }
+            wire::Record frame = wire::decodeFrame(in.data() + at);
+            if (frame.message == "next line") next = true;
+            else received += frame.message.size();
+        }
+        in.erase(0, at);
+    }
+    CHECK(valid);
+    CHECK(next);
+    CHECK(received == length);
+
+    close(producer);
+    close(subscriber);
+    server.stop();
+}
+
+static std::string record(int i) {
+    std::string text = "record " + std::to_string(i) + " ";
+    text.resize(99, 'x');
+    return text + "\n";
+}
+
+// Records i, i + 1, ... in order
+static bool consecutive(const std::vector<std::string>& lines, int first = 0) {
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (lines[i] + "\n" != record(first + int(i))) return false;
+    }
+    return true;
+}
+
+// "dropped N records" of the last stats report line for a client
+static uint64_t reportedDrops(const std::string& report, uint64_t id) {
+    std::string prefix = "client " + std::to_string(id) + ": ";
+    size_t at = report.rfind(prefix);
+    if (at == std::string::npos) return UINT64_MAX;
+    at = report.find("dropped ", at);
+    return at == std::string::npos ? UINT64_MAX : std::stoull(report.substr(at + 8));
+}
+
+// A subscriber that never reads, with a 64 KB queue: 8 MB of records cannot
+// hide in socket buffers, so each policy has to act
+static void testStall(StallPolicy policy) {
+    const int port = 19973;
+    const int total = 80000;  // 100 bytes each
+    ServerOptions options = serverOptions(port, 1);
+    options.maxQueueBytes = 64 * 1024;
+    options.stallPolicy = policy;
+    options.statsInterval = policy == StallPolicy::Drop ? 1 : 0;
+
+    // The stats report goes to std::cout from the loop thread
+    std::ostringstream report;
+    std::streambuf* stdoutBuffer = std::cout.rdbuf(report.rdbuf());
+    LogServer server(options);
+    CHECK(server.start());
+
+    int producer = connectTo(port);
+    int stalled = connectTo(port, 4096);
+    CHECK(waitFor([&]() { return server.textClients().load() == 2; }));
+    std::string batch;
+    for (int i = 0; i < total; ++i) {
+        batch += record(i);
+        if (batch.size() >= 64 * 1024 || i == total - 1) {
+            sendText(producer, batch);
+            batch.clear();
+        }
+    }
+
+    // Read only now; each line is one whole record
+    std::vector<std::string> lines = readLines(stalled, total);
+    SubscriberCounters counters = server.subscriberCounters();
+    switch (policy) {
+    case StallPolicy::Drop: {
+        CHECK(counters.droppedRecords > 0);
+        CHECK(lines.size() + counters.droppedRecords == size_t(total));
+        CHECK(counters.droppedBytes == counters.droppedRecords * 100);
+        CHECK(counters.spilledBytes == 0 && counters.disconnects == 0);
+        // Whole records, in order, with gaps where they were dropped
+        bool ordered = true;
+        int last = -1;
+        for (const std::string& line : lines) {
+            int i = std::atoi(line.c_str() + 7);
+            if (i <= last || line + "\n" != record(i)) ordered = false;
+            last = i;
+        }
+        CHECK(ordered);
+        // Per subscriber: the producer (connection 1) lost nothing
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        std::cout.flush();
+        CHECK(reportedDrops(report.str(), 2) == counters.droppedRecords);
+        CHECK(reportedDrops(report.str(), 1) == 0);
+        break;
+    }
+    case StallPolicy::Disconnect:
+        CHECK(lines.size() < size_t(total));
+        CHECK(consecutive(lines));
+        CHECK(counters.disconnects == 1);
+        CHECK(counters.droppedRecords > 0);
+        CHECK(waitFor([&]() { return server.textClients().load() == 1; }));
+        break;
+    case StallPolicy::Spill:
+        CHECK(lines.size() == size_t(total));
+        CHECK(consecutive(lines));
+        CHECK(counters.spilledBytes > 0);
+        CHECK(counters.droppedRecords == 0 && counters.disconnects == 0);
+        break;
+    }
+
+    close(producer);
+    close(stalled);
+    server.stop();
+    std::cout.rdbuf(stdoutBuffer);
+}
+
+int main() {
+    testLoops();
+    testFraming();
+    testLongLineToBinary();
+    testStall(StallPolicy::Drop);
+    testStall(StallPolicy::Disconnect);
+    testStall(StallPolicy::Spill);
+
+    if (failures == 0) std::cout << "server_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include "logger.hpp"
+#include "memory_sink.hpp"
+#include "stdout_sink.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static bool endsWith(const std::string& line, const std::string& suffix) {
+    return line.size() >= suffix.size() && line.compare(line.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+// Per-sink levels and formatters; a sink's formatter never sees records
+// below its level
+static void testLevelsAndFormatters(SinkMode mode) {
+    auto all = std::make_shared<MemorySink>(16);
+    auto errors = std::make_shared<MemorySink>(16);
+    int formatted = 0;
+    errors->setLevel(LogLevel::Error);
+    errors->setFormatter([&](std::string& out, const LogRecord& record) {
+        ++formatted;
+        out.append(levelName(record.level));
+        out.append(": ");
+        out.append(record.message());
+        out.push_back('\n');
+    });
+    all->setMode(mode);
+    errors->setMode(mode);
+
+    {
+        Logger logger({ all, errors }, LogLevel::Info);
+        logger.log("first", LogLevel::Debug);
+        logger.log("second", LogLevel::Info);
+        logger.log("broken", LogLevel::Error);
+        logger.flush();
+
+        std::vector<std::string> records = all->records();
+        CHECK(records.size() == 3);
+        CHECK(records.size() == 3 && endsWith(records[0], "[Debug] first\n"));
+        CHECK(records.size() == 3 && endsWith(records[2], "[Error] broken\n"));
+
+        records = errors->records();
+        CHECK(records.size() == 1);
+        CHECK(records.size() == 1 && records[0] == "Error: broken\n");
+        CHECK(formatted == 1);
+    }
+}
+
+// A logf argument that counts how often it is formatted
+struct Counted {
+    int* calls;
+};
+
+static void appendArg(std::string& out, const Counted& value) {
+    ++*value.calls;
+    out.append("counted");
+}
+
+// Nothing is formatted when no sink wants the level: neither the message
+// arguments nor the record
+static void testNoSinkAccepts() {
+    auto errors = std::make_shared<MemorySink>(4);
+    int arguments = 0;
+    int records = 0;
+    errors->setLevel(LogLevel::Error);
+    errors->setFormatter([&](std::string& out, const LogRecord& record) {
+        ++records;
+        out.append(record.message());
+    });
+    Logger logger({ errors }, LogLevel::Info);
+    for (int i = 0; i < 100; ++i) logger.logf(LogLevel::Debug, "value {}", Counted{ &arguments });
+    CHECK(arguments == 0);
+    CHECK(records == 0);
+    CHECK(errors->total() == 0);
+
+    logger.logf(LogLevel::Error, "value {}", Counted{ &arguments });
+    CHECK(arguments == 1);
+    CHECK(records == 1);
+    CHECK(errors->records().size() == 1 && errors->records()[0] == "value counted");
+}
+
+// Inline and async sinks side by side, with the ring keeping the newest
+static void testMixedModes() {
+    const std::string path = "sink_test.log";
+    auto file = std::make_shared<FileSink>(path, FlushPolicy());
+    file->setMode(SinkMode::Async);
+    file->setLevel(LogLevel::Warning);
+    auto ring = std::make_shared<MemorySink>(4);
+
+    {
+        Logger logger({ file, ring }, LogLevel::Info);
+        for (int i = 0; i < 10; ++i) {
+            logger.logf(i % 2 == 0 ? LogLevel::Info : LogLevel::Warning, "record {}", i);
+        }
+        logger.flush();
+
+        std::vector<std::string> records = ring->records();
+        CHECK(ring->total() == 10);
+        CHECK(records.size() == 4);
+        CHECK(records.size() == 4 && endsWith(records[0], "record 6\n") && endsWith(records[3], "record 9\n"));
+    }
+
+    std::string content = readFile(path);
+    size_t lines = 0;
+    for (char c : content) lines += c == '\n';
+    CHECK(lines == 5);
+    CHECK(content.find("[Info]") == std::string::npos);
+    CHECK(content.find("[Warning] record 9\n") != std::string::npos);
+    std::remove(path.c_str());
+}
+
+static void testStdoutSink() {
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    {
+        auto out = std::make_shared<StdoutSink>(fds[1]);
+        Logger logger({ out }, LogLevel::Info);
+        logger.log("to the pipe", LogLevel::Warning);
+    }
+    close(fds[1]);
+    char buffer[256];
+    ssize_t n = read(fds[0], buffer, sizeof(buffer));
+    close(fds[0]);
+    CHECK(n > 0 && endsWith(std::string(buffer, size_t(n)), "[Warning] to the pipe\n"));
+}
+
+int main() {
+    testLevelsAndFormatters(SinkMode::Inline);
+    testLevelsAndFormatters(SinkMode::Async);
+    testNoSinkAccepts();
+    testMixedModes();
+    testStdoutSink();
+
+    if (failures == 0) std::cout << "sink_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+#include "logger.hpp"
+#include "wire_protocol.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static const char* kLogPath = "socket_test.log";
+static const char* kSpoolPath = "socket_test.spool";
+
+// Listening socket on 127.0.0.1; port 0 picks a free one
+static int listenOn(int& port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 4) != 0) {
+        close(fd);
+        return -1;
+    }
+    socklen_t length = sizeof(address);
+    getsockname(fd, (sockaddr*)&address, &length);
+    port = ntohs(address.sin_port);
+    return fd;
+}
+
+static int acceptWithin(int listener, int ms) {
+    pollfd pfd{ listener, POLLIN, 0 };
+    if (poll(&pfd, 1, ms) <= 0) return -1;
+    return accept(listener, nullptr, nullptr);
+}
+
+// Reads until count lines arrived or nothing came for a while
+static std::vector<std::string> readLines(int fd, size_t count) {
+    std::vector<std::string> lines;
+    std::string pending;
+    char buffer[4096];
+    while (lines.size() < count) {
+        pollfd pfd{ fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 2000) <= 0) break;
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buffer[i] == '\n') {
+                lines.push_back(pending);
+                pending.clear();
+            } else {
+                pending.push_back(buffer[i]);
+            }
+        }
+    }
+    return lines;
+}
+
+static bool endsWith(const std::string& line, const std::string& suffix) {
+    return line.size() >= suffix.size() && line.compare(line.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+template <typename Predicate>
+static bool waitFor(Predicate predicate) {
+    for (int i = 0; i < 300; ++i) {
+        if (predicate()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return predicate();
+}
+
+static LoggerOptions quickReconnect() {
+    LoggerOptions options;
+    options.socket.connectTimeout = std::chrono::milliseconds(200);
+    options.socket.reconnectMin = std::chrono::milliseconds(10);
+    options.socket.reconnectMax = std::chrono::milliseconds(40);
+    return options;
+}
+
+// A port nobody listens on (for a moment at least)
+static int freePort() {
+    int port = 0;
+    close(listenOn(port));
+    return port;
+}
+
+static void testQueuedUntilServerStarts() {
+    int port = freePort();
+    Logger logger(kLogPath, LogLevel::Info, LogOutput::Socket, "127.0.0.1", port, quickReconnect());
+
+    for (int i = 0; i < 3; ++i) logger.logf(LogLevel::Info, "early {}", i);
+    SocketCounters counters = logger.socketCounters();
+    CHECK(!counters.connected);
+    CHECK(counters.queued == 3);
+    CHECK(counters.sent == 0);
+
+    int listener = listenOn(port);
+    CHECK(listener != -1);
+    int server = acceptWithin(listener, 3000);
+    CHECK(server != -1);
+    CHECK(waitFor([&]() { return logger.socketCounters().sent == 3; }));
+
+    std::vector<std::string> lines = readLines(server, 3);
+    CHECK(lines.size() == 3);
+    for (size_t i = 0; i < lines.size(); ++i) CHECK(endsWith(lines[i], "early " + std::to_string(i)));
+
+    // Server restart: the dead connection is noticed and nothing raises SIGPIPE
+    close(server);
+    close(listener);
+    CHECK(waitFor([&]() { return !logger.socketCounters().connected; }));
+    logger.log("after restart");
+    logger.log("second after restart");
+
+    listener = listenOn(port);
+    server = acceptWithin(listener, 3000);
+    CHECK(server != -1);
+    lines = readLines(server, 2);
+    CHECK(lines.size() == 2);
+    CHECK(lines.size() == 2 && endsWith(lines[0], "after restart") && endsWith(lines[1], "second after restart"));
+    CHECK(logger.socketCounters().reconnects >= 1);
+    CHECK(logger.socketCounters().dropped == 0);
+
+    close(server);
+    close(listener);
+}
+
+static void testQueueLimit() {
+    int port = freePort();
+    LoggerOptions options = quickReconnect();
+    options.socket.queueBytes = 200;
+    Logger logger(kLogPath, LogLevel::Info, LogOutput::Socket, "127.0.0.1", port, options);
+
+    for (int i = 0; i < 20; ++i) logger.logf(LogLevel::Info, "record number {}", i);
+    SocketCounters counters = logger.socketCounters();
+    CHECK(counters.dropped > 0);
+    CHECK(counters.queued > 0);
+    CHECK(counters.queued + counters.dropped == 20);
+}
+
+static void testSpoolSurvivesRestart() {
+    std::remove(kSpoolPath);
+    int port = freePort();
+    LoggerOptions options = quickReconnect();
+    options.socket.queueBytes = 200;
+    options.socket.spoolPath = kSpoolPath;
+
+    {
+        Logger logger(kLogPath, LogLevel::Info, LogOutput::Socket, "127.0.0.1", port, options);
+        for (int i = 0; i < 20; ++i) logger.logf(LogLevel::Info, "spooled {}", i);
+        SocketCounters counters = logger.socketCounters();
+        CHECK(counters.dropped == 0);
+        CHECK(counters.spoolBytes > 0);
+    }
+
+    // The next run replays the previous one's records first, in order
+    int listener = listenOn(port);
+    CHECK(listener != -1);
+    Logger logger(kLogPath, LogLevel::Info, LogOutput::Socket, "127.0.0.1", port, options);
+    logger.log("fresh");
+    int server = acceptWithin(listener, 3000);
+    CHECK(server != -1);
+    std::vector<std::string> lines = readLines(server, 21);
+    CHECK(lines.size() == 21);
+    for (size_t i = 0; i < lines.size() && i < 20; ++i) CHECK(endsWith(lines[i], "spooled " + std::to_string(i)));
+    CHECK(lines.size() == 21 && endsWith(lines[20], "fresh"));
+    CHECK(waitFor([&]() { return logger.socketCounters().spoolBytes == 0; }));
+
+    close(server);
+    close(listener);
+    std::remove(kSpoolPath);
+}
+
+// In binary mode a message longer than a frame can carry is cut rather than
+// sent as a frame the server rejects: the record after it still arrives
+static void testBinaryLongMessage() {
+    int port = 0;
+    int listener = listenOn(port);
+    CHECK(listener != -1);
+    bool valid = true;
+    bool after = false;
+    size_t longest = 0;
+    std::thread server([&]() {
+        int fd = acceptWithin(listener, 3000);
+        if (fd == -1) return;
+        std::string in;
+        char buffer[65536];
+        bool greeted = false;
+        while (valid && !after) {
+            pollfd pfd{ fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 3000) <= 0) break;
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) break;
+            in.append(buffer, n);
+            if (!greeted) {
+                if (in.size() < wire::kHelloBinary.size()) continue;
+                if (in.compare(0, wire::kHelloBinary.size(), wire::kHelloBinary) != 0) break;
+                in.erase(0, wire::kHelloBinary.size());
+                send(fd, wire::kHelloAccept.data(), wire::kHelloAccept.size(), MSG_NOSIGNAL);
+                greeted = true;
+            }
+            size_t at = 0;
+            for (size_t size; (size = wire::completeFrame(in.data() + at, in.size() - at)) != 0; at += size) {
+                if (size == SIZE_MAX) {
+                    valid = false;
+                    break;
+                }
+                wire::Record frame = wire::decodeFrame(in.data() + at);
+                longest = std::max(longest, frame.message.size());
+                if (frame.message == "after") after = true;
+            }
+            in.erase(0, at);
+        }
+        close(fd);
+    });
+
+    LoggerOptions options = quickReconnect();
+    options.socket.wire = WireFormat::Binary;
+    {
+        Logger logger(kLogPath, LogLevel::Info, LogOutput::Socket, "127.0.0.1", port, options);
+        CHECK(logger.usesBinaryWire());
+        logger.log(std::string(2 << 20, 'x'));
+        logger.log("after");
+        logger.flush();
+        server.join();
+    }
+    close(listener);
+    CHECK(valid);
+    CHECK(after);
+    CHECK(longest == wire::kMaxMessage);
+}
+
+int main() {
+    testQueuedUntilServerStarts();
+    testQueueLimit();
+    testSpoolSurvivesRestart();
+    testBinaryLongMessage();
+    std::remove(kLogPath);
+
+    if (failures == 0) std::cout << "socket_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
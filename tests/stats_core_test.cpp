@@ -0,0 +1,173 @@
+#include "stats_core.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+int main() {
+    const size_t kShards = 4;
+    const uint64_t kPerShard = 200000;
+
+    StatsAggregator stats(kShards);
+    CHECK(stats.snapshot().total == 0);
+    CHECK(stats.snapshot().minLength == UINT64_MAX);
+
+    // Snapshots taken during ingestion are never torn within a shard
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+    std::thread reader([&]() {
+        while (!done) {
+            StatsSnapshot snapshot = stats.snapshot();
+            uint64_t sum = 0;
+            for (uint64_t count : snapshot.levels) sum += count;
+            if (sum != snapshot.total) ++torn;
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (size_t s = 0; s < kShards; ++s) {
+        writers.emplace_back([&, s]() {
+            StatsShard& shard = stats.shard(s);
+            for (uint64_t i = 0; i < kPerShard; ++i) {
+                shard.record(LogLevel(i % kLevelCount), i % 100 + s, 1000 + i / 1000, (i + 1) * 1000);  // length 0 only in shard 0
+            }
+        });
+    }
+    for (auto& writer : writers) writer.join();
+    done = true;
+    reader.join();
+    CHECK(torn == 0);
+
+    StatsSnapshot snapshot = stats.snapshot();
+    CHECK(snapshot.total == kShards * kPerShard);
+    for (uint64_t count : snapshot.levels) CHECK(count == kShards * kPerShard / kLevelCount);
+    CHECK(snapshot.minLength == 1);
+    CHECK(snapshot.maxLength == 99 + kShards - 1);
+
+    uint64_t expectedLength = 0;
+    for (size_t s = 0; s < kShards; ++s) {
+        for (uint64_t i = 0; i < kPerShard; ++i) expectedLength += i % 100 + s;
+    }
+    CHECK(snapshot.totalLength == expectedLength);
+
+    // Templates and groups: the printer reads published copies while the
+    // owner keeps recording; they only grow, and publish() completes them
+    StatsShard owner;
+    const uint64_t kTemplates = 300000;
+    std::atomic<bool> recorded(false);
+    std::atomic<int> wrong(0);
+    std::thread printer([&]() {
+        uint64_t lastTemplate = 0, lastGroup = 0;
+        while (!recorded) {
+            std::vector<HeavyHitter> top;
+            owner.collectTemplates(LogLevel::Warning, top);
+            std::unordered_map<std::string, GroupTotals> groups;
+            owner.collectGroups(groups);
+            uint64_t count = top.empty() ? 0 : top[0].count;
+            uint64_t grouped = groups["auth"].count;
+            if (top.size() > 1 || count < lastTemplate || count > kTemplates || grouped < lastGroup ||
+                grouped > kTemplates / 2) {
+                ++wrong;
+            }
+            lastTemplate = count;
+            lastGroup = grouped;
+        }
+    });
+    for (uint64_t i = 0; i < kTemplates; ++i) {
+        owner.recordTemplate(LogLevel::Warning, "disk " + std::to_string(i) + " full");
+        owner.recordGroup(i % 2 ? "auth" : "billing", true, 1);
+    }
+    recorded = true;
+    printer.join();
+    CHECK(wrong == 0);
+    owner.publish();
+    std::vector<HeavyHitter> top;
+    owner.collectTemplates(LogLevel::Warning, top);
+    CHECK(top.size() == 1 && top[0].count == kTemplates && top[0].text == "disk <n> full");
+    std::unordered_map<std::string, GroupTotals> groups;
+    owner.collectGroups(groups);
+    CHECK(groups.size() == 2 && groups["auth"].count == kTemplates / 2 && groups["billing"].sum == kTemplates / 2);
+
+    // Totals are 64-bit: past the old int range
+    StatsShard big;
+    for (int i = 0; i < 3; ++i) big.record(LogLevel::Info, 1u << 30, 0, 0);
+    CHECK(big.snapshot().totalLength == 3ull << 30);
+
+    // Each level sees every 4th record, 4 us apart
+    static LevelHistograms histograms;
+    stats.histograms(histograms);
+    for (size_t i = 0; i < kLevelCount; ++i) {
+        CHECK(histograms.length[i].count() == kShards * kPerShard / kLevelCount);
+        CHECK(histograms.interArrivalNs[i].count() == kShards * (kPerShard / kLevelCount - 1));
+        uint64_t gap = histograms.interArrivalNs[i].quantile(0.5);
+        CHECK(gap >= 4000 - 4000 / LogHistogram::kSubBuckets && gap <= 4000 + 4000 / LogHistogram::kSubBuckets);
+    }
+
+    // 200 distinct seconds per shard, 1000 records each
+    CHECK(stats.window(1199, 200).total() == kShards * kPerShard);
+    CHECK(stats.window(1199, 100).total() == kShards * kPerShard / 2);
+    CHECK(stats.window(1099, 1).levels[size_t(LogLevel::Error)] == kShards * 1000 / kLevelCount);
+    CHECK(stats.window(5000, 60).total() == 0);
+
+    // The ring forgets seconds once they fall out of its reach
+    RateWindow window;
+    const int64_t start = 1754653998;
+    for (int64_t second = start; second < start + 3 * RateWindow::kSeconds; second += 7) {
+        window.record(second, LogLevel::Warning);
+        window.record(second, LogLevel::Debug);
+    }
+    int64_t now = start + 3 * RateWindow::kSeconds;
+    WindowCounts hour = window.count(now, RateWindow::kSeconds);
+    CHECK(hour.levels[size_t(LogLevel::Warning)] == hour.levels[size_t(LogLevel::Debug)]);
+    CHECK(hour.total() == 2 * (RateWindow::kSeconds / 7 + 1) || hour.total() == 2 * (RateWindow::kSeconds / 7));
+    CHECK(window.count(now, 10 * RateWindow::kSeconds).total() == hour.total());
+
+    // A record older than the bucket's current second is dropped, not mixed in
+    window.record(now - 1, LogLevel::Info);
+    window.record(now - 1 - RateWindow::kSeconds, LogLevel::Info);
+    CHECK(window.count(now, 1).total() == 0);
+    CHECK(window.count(now - 1, 1).total() == 1);
+
+    // Quantiles stay within one bucket of the exact value
+    LogHistogram histogram;
+    for (uint64_t v = 1; v <= 100000; ++v) histogram.record(v);
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    for (double q : quantiles) {
+        double exact = q * 99999 + 1;
+        double estimate = double(histogram.quantile(q));
+        CHECK(estimate >= exact * (1 - 1.0 / LogHistogram::kSubBuckets) &&
+              estimate <= exact * (1 + 1.0 / LogHistogram::kSubBuckets));
+    }
+    CHECK(LogHistogram().quantile(0.99) == 0);
+    const uint64_t edges[] = {0, 1, 15, 16, 17, 1000, uint64_t(1) << 40, UINT64_MAX};
+    for (uint64_t v : edges) {
+        size_t bucket = LogHistogram::bucketOf(v);
+        CHECK(bucket < LogHistogram::kBuckets);
+        CHECK(LogHistogram::lowerBound(bucket) <= v && v <= LogHistogram::upperBound(bucket));
+    }
+
+    // Merging equals recording everything into one histogram
+    LogHistogram left, right, both;
+    for (uint64_t v = 0; v < 5000; ++v) {
+        (v % 3 ? left : right).record(v * 37);
+        both.record(v * 37);
+    }
+    left.merge(right);
+    CHECK(left.count() == both.count());
+    for (double q : quantiles) CHECK(left.quantile(q) == both.quantile(q));
+
+    if (failures == 0) std::cout << "stats_core_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+#include "log_parser.hpp"
+#include "log_server.hpp"
+#include "log_store.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static const char* kStoreDir = "store_test.d";
+static const int kPort = 19971;
+static const int kRecords = 2000;
+
+// Record i is logged i seconds after midnight; only 1500..1504 are errors
+static std::string record(int i) {
+    char line[96];
+    std::snprintf(line, sizeof(line), "2026-01-01 %02d:%02d:%02d [%s] request %d done\n", i / 3600, i / 60 % 60,
+                  i % 60, i >= 1500 && i < 1505 ? "Error" : "Info", i);
+    return line;
+}
+
+static int64_t timeOf(int i) {
+    ParsedLine parsed;
+    std::string line = record(i);
+    parseLogLine(std::string_view(line).substr(0, line.size() - 1), parsed);
+    return parsed.epochSeconds;
+}
+
+static std::vector<std::string> split(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (size_t end; (end = text.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.push_back(text.substr(start, end - start));
+    }
+    return lines;
+}
+
+static std::vector<std::string> query(LogStore& store, const std::string& args, uint64_t* blocksRead = nullptr) {
+    StoreCursor cursor;
+    std::string error;
+    CHECK(parseQuery(args, cursor.query, error));
+    std::string out;
+    while (store.read(cursor, out, 4096)) {}
+    if (blocksRead) *blocksRead = cursor.blocksRead;
+    return split(out);
+}
+
+static void fill(LogStore& store) {
+    for (int i = 0; i < kRecords; i += 10) {
+        std::string batch;
+        for (int j = i; j < i + 10; ++j) batch += record(j);
+        CHECK(store.append(batch.data(), batch.size()) == uint64_t(i));
+    }
+}
+
+static void checkQueries(LogStore& store) {
+    CHECK(store.endOffset() == kRecords);
+
+    uint64_t blocksRead = 0;
+    std::vector<std::string> lines = query(store, "level=Error", &blocksRead);
+    CHECK(lines.size() == 5);
+    if (lines.size() == 5) CHECK(lines[0] + "\n" == record(1500) && lines[4] + "\n" == record(1504));
+    CHECK(blocksRead <= 2);  // the index skips blocks without errors
+
+    lines = query(store, "since=" + std::to_string(timeOf(1000)) + " until=" + std::to_string(timeOf(1009)),
+                  &blocksRead);
+    CHECK(lines.size() == 10);
+    if (lines.size() == 10) CHECK(lines[0] + "\n" == record(1000) && lines[9] + "\n" == record(1009));
+    CHECK(blocksRead <= 2);
+
+    lines = query(store, "from=1990");
+    CHECK(lines.size() == 10);
+    if (!lines.empty()) CHECK(lines[0] + "\n" == record(1990));
+
+    CHECK(query(store, "").size() == kRecords);
+    CHECK(query(store, "level=Warning since=" + std::to_string(timeOf(1490))).size() == 5);
+}
+
+static void testStore() {
+    std::filesystem::remove_all(kStoreDir);
+    {
+        LogStore store(kStoreDir, 16 * 1024, 0);
+        CHECK(store.open());
+        fill(store);
+        CHECK(store.segmentCount() > 1);
+        checkQueries(store);
+    }
+
+    // A crash mid-append and a lost index: the data files are the truth
+    std::vector<std::filesystem::path> segments;
+    for (const auto& entry : std::filesystem::directory_iterator(kStoreDir)) {
+        if (entry.path().extension() == ".log") segments.push_back(entry.path());
+    }
+    std::sort(segments.begin(), segments.end());
+    std::ofstream(segments.back(), std::ios::app) << "2026-01-01 01:00:00 [Info] torn rec";
+    std::filesystem::path index = segments.front();
+    std::filesystem::remove(index.replace_extension(".idx"));
+    {
+        LogStore store(kStoreDir, 16 * 1024, 0);
+        CHECK(store.open());
+        checkQueries(store);
+        std::string next = record(kRecords);
+        CHECK(store.append(next.data(), next.size()) == kRecords);
+    }
+
+    // Retention keeps the newest segments; queries start where they begin
+    std::filesystem::remove_all(kStoreDir);
+    {
+        LogStore store(kStoreDir, 16 * 1024, 2);
+        CHECK(store.open());
+        fill(store);
+        CHECK(store.segmentCount() == 2);
+        CHECK(store.firstOffset() > 0);
+        CHECK(query(store, "").size() == kRecords - store.firstOffset());
+    }
+
+    StoreQuery parsed;
+    std::string error;
+    CHECK(!parseQuery("level=Fatal", parsed, error));
+    CHECK(!parseQuery("from=x", parsed, error));
+    CHECK(parseQuery("last=10m follow", parsed, error) && parsed.follow && parsed.since > 0);
+    std::filesystem::remove_all(kStoreDir);
+}
+
+// A write that fails halfway (here: the file size limit, as with a full
+// disk) is cut off again; neither the file nor the index keeps any of it
+static void testFailedAppend() {
+    std::filesystem::remove_all(kStoreDir);
+    LogStore store(kStoreDir, 1 << 20, 0);
+    CHECK(store.open());
+    std::string batch;
+    for (int i = 0; i < 100; ++i) batch += record(i);
+    CHECK(store.append(batch.data(), batch.size()) == 0);
+    std::filesystem::path segment = std::string(kStoreDir) + "/00000000000000000000.log";
+    uintmax_t size = std::filesystem::file_size(segment);
+
+    rlimit saved{};
+    getrlimit(RLIMIT_FSIZE, &saved);
+    rlimit limit = saved;
+    limit.rlim_cur = size + 50;
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    CHECK(store.append(batch.data(), batch.size()) == 100);
+    setrlimit(RLIMIT_FSIZE, &saved);
+    CHECK(store.endOffset() == 100);
+    CHECK(std::filesystem::file_size(segment) == size);
+
+    std::string next = record(100);
+    CHECK(store.append(next.data(), next.size()) == 100);
+    std::vector<std::string> lines = query(store, "");
+    CHECK(lines.size() == 101);
+    if (lines.size() == 101) CHECK(lines[99] + "\n" == record(99) && lines[100] + "\n" == record(100));
+    std::filesystem::remove_all(kStoreDir);
+}
+
+// Readers see whole records in order, without gaps, while appends continue
+static void testConcurrentReads() {
+    std::filesystem::remove_all(kStoreDir);
+    LogStore store(kStoreDir, 16 * 1024, 0);
+    CHECK(store.open());
+    std::atomic<bool> done(false);
+    std::atomic<int> wrong(0);
+    std::thread reader([&]() {
+        while (!done) {
+            StoreCursor cursor;
+            std::string out;
+            while (store.read(cursor, out, 4096)) {}
+            std::vector<std::string> lines = split(out);
+            for (size_t i = 1; i < lines.size(); ++i) {
+                int before = std::atoi(lines[i - 1].c_str() + lines[i - 1].find("request ") + 8);
+                if (lines[i] + "\n" != record(before + 1)) ++wrong;
+            }
+        }
+    });
+    for (int i = 0; i < kRecords; ++i) {
+        std::string line = record(i);
+        store.append(line.data(), line.size());
+    }
+    done = true;
+    reader.join();
+    CHECK(wrong == 0);
+    std::filesystem::remove_all(kStoreDir);
+}
+
+static int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void sendText(int fd, const std::string& text) {
+    send(fd, text.data(), text.size(), MSG_NOSIGNAL);
+}
+
+// Reads until count lines arrived, the peer closed or nothing came for a while
+static std::vector<std::string> readLines(int fd, size_t count) {
+    std::string text;
+    char buffer[4096];
+    while (split(text).size() < count) {
+        pollfd pfd{ fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 2000) <= 0) break;
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        text.append(buffer, n);
+    }
+    return split(text);
+}
+
+template <typename Predicate>
+static bool waitFor(Predicate predicate) {
+    for (int i = 0; i < 200; ++i) {
+        if (predicate()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static void testServerQueries() {
+    std::filesystem::remove_all(kStoreDir);
+    ServerOptions options;
+    options.port = kPort;
+    options.threads = 2;
+    options.quiet = true;
+    options.storeDir = kStoreDir;
+    LogServer server(options);
+    CHECK(server.start());
+    if (server.store() == nullptr) return;
+
+    int producer = connectTo(kPort);
+    CHECK(producer >= 0);
+    sendText(producer, record(1499) + record(1500) + record(1501) + record(1505) + record(1506));
+    CHECK(waitFor([&]() { return server.store()->endOffset() == 5; }));
+
+    // One-shot: the matching history, an end marker and EOF
+    int oneShot = connectTo(kPort);
+    sendText(oneShot, "#LGQUERY level=Error\n");
+    std::vector<std::string> lines = readLines(oneShot, 10);
+    CHECK(lines.size() == 3);
+    if (lines.size() == 3) {
+        CHECK(lines[0] + "\n" == record(1500) && lines[1] + "\n" == record(1501));
+        CHECK(lines[2] == "#LGEND 5");
+    }
+    close(oneShot);
+
+    // Asked while no live record is in flight: another loop could still
+    // deliver one to a connection it has just accepted
+    int bad = connectTo(kPort);
+    sendText(bad, "#LGQUERY level=Fatal\n");
+    lines = readLines(bad, 1);
+    CHECK(lines.size() == 1 && lines[0].rfind("#LGERROR", 0) == 0);
+
+    // Catch-up from an offset, then the live stream without a gap
+    int follower = connectTo(kPort);
+    sendText(follower, "#LGQUERY from=3 follow\n");
+    lines = readLines(follower, 3);
+    CHECK(lines.size() == 3);
+    if (lines.size() == 3) {
+        CHECK(lines[0] + "\n" == record(1505) && lines[1] + "\n" == record(1506));
+        CHECK(lines[2] == "#LGLIVE 5");
+    }
+    sendText(producer, record(1507));
+    lines = readLines(follower, 1);
+    CHECK(lines.size() == 1 && lines[0] + "\n" == record(1507));
+
+    close(bad);
+    close(follower);
+    close(producer);
+    server.stop();
+    std::filesystem::remove_all(kStoreDir);
+}
+
+int main() {
+    testStore();
+    testFailedAppend();
+    testConcurrentReads();
+    testServerQueries();
+
+    if (failures == 0) std::cout << "store_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
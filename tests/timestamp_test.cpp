@@ -0,0 +1,58 @@
+#include "timestamp.hpp"
+
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static std::string format(std::chrono::system_clock::time_point tp, TimestampPrecision precision, bool utc) {
+    TimestampOptions options;
+    options.precision = precision;
+    options.utc = utc;
+    char buffer[kMaxTimestampLength];
+    size_t length = formatTimestamp(tp, options, buffer);
+    return std::string(buffer, length);
+}
+
+static std::string reference(std::time_t t, bool utc) {
+    std::tm tm{};
+    if (utc) gmtime_r(&t, &tm);
+    else localtime_r(&t, &tm);
+    char buffer[20];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+    return buffer;
+}
+
+int main() {
+    using namespace std::chrono;
+
+    // 2024-02-29 12:34:56.789012 UTC
+    const std::time_t base = 1709210096;
+    auto tp = system_clock::from_time_t(base) + microseconds(789012);
+
+    CHECK(format(tp, TimestampPrecision::Seconds, true) == "2024-02-29 12:34:56");
+    CHECK(format(tp, TimestampPrecision::Milliseconds, true) == "2024-02-29 12:34:56.789");
+    CHECK(format(tp, TimestampPrecision::Microseconds, true) == "2024-02-29 12:34:56.789012");
+    CHECK(format(tp, TimestampPrecision::Seconds, false) == reference(base, false));
+
+    // Cache must be refreshed when the second changes, in both directions
+    for (int step : {1, 59, 3600, -7200, 86400 * 400}) {
+        std::time_t t = base + step;
+        auto later = system_clock::from_time_t(t) + microseconds(5);
+        CHECK(format(later, TimestampPrecision::Seconds, true) == reference(t, true));
+        CHECK(format(later, TimestampPrecision::Microseconds, false) == reference(t, false) + ".000005");
+    }
+
+    if (failures == 0) std::cout << "timestamp_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+#include "top_k.hpp"
+
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+static std::string normalized(std::string_view message) {
+    char text[kMaxTemplateLength];
+    return std::string(text, normalizeTemplate(message, text));
+}
+
+int main() {
+    CHECK(normalized("user 42 got 0x7ffd12 for 'abc'") == "user <n> got <hex> for <str>");
+    CHECK(normalized("took 3.14 ms at 2025-08-08 12:30:01") == "took <n> ms at <n> <n>");
+    CHECK(normalized("id=deadbeef01 name=\"Bob Smith\"") == "id=<hex> name=<str>");
+    CHECK(normalized("deadbeef facade v2 x86_64 user-7") == "deadbeef facade v2 x86_64 user-<n>");
+    CHECK(normalized("unterminated 'quote 5") == "unterminated 'quote <n>");
+    CHECK(normalized("") == "");
+    CHECK(normalized(std::string(500, 'a')).size() == kMaxTemplateLength);
+    CHECK(normalized(std::string(500, '1') + " x") == "<n> x");
+
+    // Exact while the templates fit into the summary
+    SpaceSaving summary;
+    char text[kMaxTemplateLength];
+    for (int i = 0; i < 1000; ++i) {
+        std::string message = "request " + std::to_string(i) + (i % 10 == 0 ? " failed" : " ok");
+        summary.add(text, normalizeTemplate(message, text));
+    }
+    std::vector<HeavyHitter> all;
+    summary.collect(all);
+    std::vector<HeavyHitter> top = topHitters(all, 5);
+    CHECK(top.size() == 2);
+    CHECK(top[0].text == "request <n> ok" && top[0].count == 900 && top[0].error == 0);
+    CHECK(top[1].text == "request <n> failed" && top[1].count == 100);
+
+    // A flood of distinct templates cannot push out the heavy hitters
+    SpaceSaving noisy;
+    for (int i = 0; i < 100000; ++i) {
+        std::string message;
+        if (i % 4 == 0) message = "heavy one";
+        else if (i % 4 == 1) message = "heavy two";
+        else message = "noise " + std::string(1, char('a' + i % 26)) + std::string(1, char('a' + i / 26 % 26)) +
+                       std::string(1, char('a' + i / 676 % 26));
+        noisy.add(text, normalizeTemplate(message, text));
+    }
+    all.clear();
+    noisy.collect(all);
+    CHECK(all.size() == SpaceSaving::kCapacity);
+    top = topHitters(all, 2);
+    CHECK(top.size() == 2);
+    for (const HeavyHitter& hitter : top) {
+        CHECK(hitter.text == "heavy one" || hitter.text == "heavy two");
+        CHECK(hitter.count >= 25000 && hitter.count - hitter.error <= 25000);
+    }
+
+    // Merging shards sums counts of the same template
+    SpaceSaving left, right;
+    for (int i = 0; i < 30; ++i) left.add(text, normalizeTemplate("disk 1 full", text));
+    for (int i = 0; i < 20; ++i) right.add(text, normalizeTemplate("disk 2 full", text));
+    right.add(text, normalizeTemplate("other", text));
+    all.clear();
+    left.collect(all);
+    right.collect(all);
+    top = topHitters(all, 1);
+    CHECK(top.size() == 1 && top[0].text == "disk <n> full" && top[0].count == 50);
+
+    if (failures == 0) std::cout << "top_k_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include "wire_protocol.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+            ++failures; \
+        } \
+    } while (0)
+
+int main() {
+    wire::Record first;
+    first.timestampNs = 1754653998123456789LL;
+    first.level = 3;
+    first.sourceId = 0xA1B2C3D4u;
+    first.message = "Division by zero";
+
+    wire::Record second;
+    second.level = wire::kLevelText;
+    second.message = "";
+
+    std::string stream;
+    wire::appendFrame(stream, first);
+    wire::appendFrame(stream, second);
+    CHECK(stream.size() == wire::frameSize(first) + wire::frameSize(second));
+
+    // Every strict prefix of a frame is incomplete
+    for (size_t i = 0; i < wire::frameSize(first); ++i) {
+        CHECK(wire::completeFrame(stream.data(), i) == 0);
+    }
+
+    size_t size = wire::completeFrame(stream.data(), stream.size());
+    CHECK(size == wire::frameSize(first));
+    wire::Record decoded = wire::decodeFrame(stream.data());
+    CHECK(decoded.timestampNs == first.timestampNs);
+    CHECK(decoded.level == first.level);
+    CHECK(decoded.sourceId == first.sourceId);
+    CHECK(decoded.message == first.message);
+
+    size_t rest = wire::completeFrame(stream.data() + size, stream.size() - size);
+    CHECK(rest == wire::frameSize(second));
+    decoded = wire::decodeFrame(stream.data() + size);
+    CHECK(decoded.level == wire::kLevelText);
+    CHECK(decoded.message.empty());
+
+    // Length fields that cannot describe a frame are rejected
+    std::string bad(wire::kHeaderSize, '\0');
+    wire::putU32(&bad[0], 3);
+    CHECK(wire::completeFrame(bad.data(), bad.size()) == SIZE_MAX);
+    wire::putU32(&bad[0], uint32_t(wire::kMaxFrame + 1));
+    CHECK(wire::completeFrame(bad.data(), bad.size()) == SIZE_MAX);
+
+    if (failures == 0) std::cout << "wire_test: OK\n";
+    return failures == 0 ? 0 : 1;
+}